@@ -0,0 +1,126 @@
+#include "arena.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+_Thread_local arena_t* g_arena;
+
+// Every block is preceded by a header holding its size class.
+typedef struct block_header {
+    size_t size;  // rounded block size, header included
+    size_t pad;
+} block_header_t;
+
+/** Initializes an empty arena. No memory is taken until the first
+ * allocation.
+ * Arguments:
+ *  - arena: the arena to initialize.
+ *  - chunk_size: default number of bytes to take from malloc at a time.
+ */
+void arena_init(arena_t* arena, size_t chunk_size) {
+    memset(arena, 0, sizeof(*arena));
+    arena->chunk_size = chunk_size;
+}
+
+/** Returns a block of at least `size` bytes, aligned to ARENA_ALIGN.
+ */
+void* arena_alloc(arena_t* arena, size_t size) {
+    size_t total = sizeof(block_header_t) +
+                   ((size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1));
+    size_t size_class = total / ARENA_ALIGN;
+
+    block_header_t* block;
+    if (size_class < ARENA_NUM_CLASSES && arena->free_lists[size_class]) {
+        // reuse a freed block; its first word links to the next free one
+        block = (block_header_t*)arena->free_lists[size_class] - 1;
+        arena->free_lists[size_class] = *(void**)(block + 1);
+        return block + 1;
+    }
+
+    // find a chunk with room, keeping the order chunks were made in so a
+    // reset arena reuses them for the same sequence of allocations
+    while (arena->current != NULL &&
+           arena->current->used + total > arena->current->size) {
+        arena->current = arena->current->next;
+    }
+    if (arena->current == NULL) {
+        size_t chunk_size = total > arena->chunk_size ? total : arena->chunk_size;
+        arena_chunk_t* chunk = malloc(sizeof(arena_chunk_t) + chunk_size);
+        chunk->next = NULL;
+        chunk->size = chunk_size;
+        chunk->used = 0;
+        if (arena->last != NULL) {
+            arena->last->next = chunk;
+        } else {
+            arena->chunks = chunk;
+        }
+        arena->last = chunk;
+        arena->current = chunk;
+        arena->num_chunk_mallocs++;
+    }
+
+    block = (block_header_t*)((char*)(arena->current + 1) + arena->current->used);
+    arena->current->used += total;
+    block->size = total;
+    return block + 1;
+}
+
+/** Gives a block back to the arena. Small blocks are reused by later
+ * allocations of the same size class; larger ones are only reclaimed by
+ * arena_reset().
+ */
+void arena_release(arena_t* arena, void* ptr) {
+    if (ptr == NULL) {
+        return;
+    }
+    block_header_t* block = (block_header_t*)ptr - 1;
+    size_t size_class = block->size / ARENA_ALIGN;
+    if (size_class < ARENA_NUM_CLASSES) {
+        *(void**)ptr = arena->free_lists[size_class];
+        arena->free_lists[size_class] = ptr;
+    }
+}
+
+/** Frees every block in the arena at once. The chunks are kept, so the next
+ * game can allocate the same amount without calling malloc.
+ */
+void arena_reset(arena_t* arena) {
+    for (arena_chunk_t* chunk = arena->chunks; chunk; chunk = chunk->next) {
+        chunk->used = 0;
+    }
+    arena->current = arena->chunks;
+    memset(arena->free_lists, 0, sizeof(arena->free_lists));
+}
+
+/** Returns all of the arena's chunks to malloc.
+ */
+void arena_destroy(arena_t* arena) {
+    arena_chunk_t* chunk = arena->chunks;
+    while (chunk != NULL) {
+        arena_chunk_t* next = chunk->next;
+        free(chunk);
+        chunk = next;
+    }
+    arena_init(arena, arena->chunk_size);
+}
+
+/** Allocates memory for the current game: from g_arena if one is set,
+ * otherwise with malloc.
+ */
+void* game_alloc(size_t size) {
+    if (g_arena != NULL) {
+        return arena_alloc(g_arena, size);
+    }
+    return malloc(size);
+}
+
+/** Frees memory from game_alloc().
+ */
+void game_free(void* ptr) {
+    if (g_arena != NULL) {
+        arena_release(g_arena, ptr);
+        return;
+    }
+    free(ptr);
+}
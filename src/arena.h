@@ -0,0 +1,52 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+// Blocks are rounded up to this many bytes; freed blocks up to
+// ARENA_NUM_CLASSES * ARENA_ALIGN bytes are kept for reuse.
+#define ARENA_ALIGN 16
+#define ARENA_NUM_CLASSES 32
+
+// A chunk of memory that the arena hands out blocks from.
+typedef struct arena_chunk {
+    struct arena_chunk* next;
+    size_t size;  // bytes available after this header
+    size_t used;  // bytes handed out so far
+    size_t pad;   // keeps the data that follows 16-byte aligned
+} arena_chunk_t;
+
+/** Bump allocator that owns every allocation of one game.
+ * Fields:
+ *  - chunks: all chunks, in the order they were created
+ *  - current: the chunk blocks are currently handed out from
+ *  - last: the last chunk, where new chunks are appended
+ *  - free_lists: freed blocks by size class, reused before bumping
+ *  - chunk_size: default size of a new chunk
+ *  - num_chunk_mallocs: number of chunks ever allocated, for statistics
+ */
+typedef struct arena {
+    arena_chunk_t* chunks;
+    arena_chunk_t* current;
+    arena_chunk_t* last;
+    void* free_lists[ARENA_NUM_CLASSES];
+    size_t chunk_size;
+    size_t num_chunk_mallocs;
+} arena_t;
+
+/** The arena that game allocations come from, or NULL to use malloc/free.
+ * Only change it between games: a block must be freed the same way it was
+ * allocated.
+ */
+extern _Thread_local arena_t* g_arena;
+
+void arena_init(arena_t* arena, size_t chunk_size);
+void* arena_alloc(arena_t* arena, size_t size);
+void arena_release(arena_t* arena, void* ptr);
+void arena_reset(arena_t* arena);
+void arena_destroy(arena_t* arena);
+
+void* game_alloc(size_t size);
+void game_free(void* ptr);
+
+#endif
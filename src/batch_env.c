@@ -0,0 +1,178 @@
+#include "batch_env.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "board_cache.h"
+#include "common.h"
+#include "delta.h"
+#include "food_index.h"
+#include "game.h"
+#include "game_setup.h"
+#include "snake_body.h"
+#include "zobrist.h"
+
+// The thread's game globals, put aside while the batch runs. g_arena,
+// g_food_index, g_zobrist and g_delta each track a single game, so none of
+// the batch's games use them; the caller's game must not see the batch's
+// moves either.
+typedef struct saved_globals {
+    int game_over;
+    int score;
+    arena_t* arena;
+    food_index_t* food_index;
+    zobrist_t* zobrist;
+    delta_writer_t* delta;
+} saved_globals_t;
+
+/* Saves the thread's game globals and clears the per-game ones.
+ */
+static void enter_batch(saved_globals_t* saved) {
+    saved->game_over = g_game_over;
+    saved->score = g_score;
+    saved->arena = g_arena;
+    saved->food_index = g_food_index;
+    saved->zobrist = g_zobrist;
+    saved->delta = g_delta;
+    g_arena = NULL;
+    g_food_index = NULL;
+    g_zobrist = NULL;
+    g_delta = NULL;
+}
+
+/* Restores the thread's game globals.
+ */
+static void leave_batch(const saved_globals_t* saved) {
+    g_game_over = saved->game_over;
+    g_score = saved->score;
+    g_arena = saved->arena;
+    g_food_index = saved->food_index;
+    g_zobrist = saved->zobrist;
+    g_delta = saved->delta;
+}
+
+/* Throws away game `game` and replaces it with a fresh one cloned from the
+   cached board, then places food as initialize_game() would. Must run
+   between enter_batch() and leave_batch().
+*/
+static void reset_game(batch_env_t* env, size_t game) {
+    snake_t* snake_p = &env->snakes[game];
+    snake_body_clear(&snake_p->snake_pos);
+
+    const board_proto_t* proto = env->proto;
+    int* cells = batch_env_cells(env, game);
+    memcpy(cells, proto->cells,
+           cell_count(env->width, env->height) * sizeof(int));
+    int init_pos = proto->snake_start;
+    snake_body_push_head(&snake_p->snake_pos, RIGHT, init_pos);
+    snake_p->snake_dir = RIGHT;
+    place_start_food(cells, env->width, env->height, proto->free_cells);
+    env->scores[game] = 0;
+}
+
+/** Initializes a batch of `num_games` games that all start from the same
+ * board.
+ *
+ * Returns the status of initializing the board. On failure, nothing is left
+ * allocated.
+ *
+ * Arguments:
+ *  - env: the batch to initialize.
+ *  - num_games: number of independent games in the batch.
+ *  - board_rep: a string representing the initial board. May be NULL for
+ *    default board. It is copied, not modified.
+ *  - growing: 0 if snakes do not grow on eating, 1 if they do.
+ */
+enum board_init_status batch_env_init(batch_env_t* env, size_t num_games,
+                                      char* board_rep, int growing) {
+    memset(env, 0, sizeof(*env));
+    env->num_games = num_games;
+    env->growing = growing;
+    if (board_rep != NULL) {
+        env->board_rep = strdup(board_rep);
+    }
+    // every game uses the same board, so the cache only ever holds one
+    board_cache_init(&env->cache, 0);
+
+    enum board_init_status status =
+        board_cache_lookup(&env->cache, env->board_rep, &env->proto);
+    if (status != INIT_SUCCESS) {
+        board_cache_free(&env->cache);
+        free(env->board_rep);
+        return status;
+    }
+    env->width = env->proto->width;
+    env->height = env->proto->height;
+
+    env->cells = malloc(num_games * cell_count(env->width, env->height) *
+                        sizeof(int));
+    env->snakes = calloc(num_games, sizeof(snake_t));
+    env->scores = calloc(num_games, sizeof(int));
+    env->done = calloc(num_games, sizeof(int));
+    saved_globals_t saved;
+    enter_batch(&saved);
+    for (size_t i = 0; i < num_games; i++) {
+        reset_game(env, i);
+    }
+    leave_batch(&saved);
+    return INIT_SUCCESS;
+}
+
+/** Advances every game in the batch by a single step. Games that end during
+ * this step are flagged in env->done and immediately reset.
+ * Arguments:
+ *  - env: the batch to step.
+ *  - actions: one input per game.
+ *  - rewards: if not NULL, receives the score gained by each game this step.
+ */
+void batch_env_step(batch_env_t* env, enum input_key* actions, int* rewards) {
+    saved_globals_t saved;
+    enter_batch(&saved);
+
+    size_t board_size = cell_count(env->width, env->height);
+    int* cells = env->cells;
+    for (size_t i = 0; i < env->num_games; i++, cells += board_size) {
+        g_game_over = 0;
+        g_score = env->scores[i];
+        update(cells, env->width, env->height, &env->snakes[i], actions[i],
+               env->growing);
+
+        if (rewards != NULL) {
+            rewards[i] = g_score - env->scores[i];
+        }
+        env->scores[i] = g_score;
+        env->done[i] = g_game_over;
+        if (g_game_over) {
+            reset_game(env, i);
+        }
+    }
+
+    leave_batch(&saved);
+}
+
+/** Returns a pointer to the first cell of game `game`'s board.
+ */
+int* batch_env_cells(batch_env_t* env, size_t game) {
+    return env->cells + game * cell_count(env->width, env->height);
+}
+
+/** Frees all memory held by the batch.
+ */
+void batch_env_teardown(batch_env_t* env) {
+    // the bodies were allocated outside any arena
+    saved_globals_t saved;
+    enter_batch(&saved);
+    for (size_t i = 0; i < env->num_games; i++) {
+        snake_body_clear(&env->snakes[i].snake_pos);
+    }
+    leave_batch(&saved);
+    free(env->cells);
+    free(env->snakes);
+    free(env->scores);
+    free(env->done);
+    free(env->board_rep);
+    board_cache_free(&env->cache);
+    memset(env, 0, sizeof(*env));
+}
@@ -0,0 +1,45 @@
+#ifndef BATCH_ENV_H
+#define BATCH_ENV_H
+
+#include <stddef.h>
+
+#include "board_cache.h"
+#include "common.h"
+#include "game_setup.h"
+
+/** A batch of independent games that are stepped together.
+ * Fields:
+ *  - num_games: number of games in the batch
+ *  - width, height: board dimensions, shared by every game
+ *  - growing: 1 if snakes grow on eating, 0 otherwise
+ *  - board_rep: private copy of the board string (NULL for default board)
+ *  - cache: holds the decoded board
+ *  - proto: the decoded board in `cache`, which every reset is cloned from.
+ *    The batch never looks up another board, so it stays valid.
+ *  - cells: one slab holding every game's board back to back
+ *  - snakes: one snake per game
+ *  - scores: current score of each game
+ *  - done: 1 if the game finished during the last step (it has since been
+ *    reset), 0 otherwise
+ */
+typedef struct batch_env {
+    size_t num_games;
+    size_t width;
+    size_t height;
+    int growing;
+    char* board_rep;
+    board_cache_t cache;
+    const board_proto_t* proto;
+    int* cells;
+    snake_t* snakes;
+    int* scores;
+    int* done;
+} batch_env_t;
+
+enum board_init_status batch_env_init(batch_env_t* env, size_t num_games,
+                                      char* board_rep, int growing);
+void batch_env_step(batch_env_t* env, enum input_key* actions, int* rewards);
+int* batch_env_cells(batch_env_t* env, size_t game);
+void batch_env_teardown(batch_env_t* env);
+
+#endif
@@ -0,0 +1,206 @@
+#include "board_cache.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "common.h"
+#include "game.h"
+#include "game_setup.h"
+#include "snake_body.h"
+
+/** Returns the 64-bit FNV-1a hash of a board string. The default board
+ * (NULL) hashes to 0.
+ */
+uint64_t board_hash(const char* board_rep) {
+    if (board_rep == NULL) {
+        return 0;
+    }
+    uint64_t hash = 14695981039346656037ull;
+    for (const unsigned char* c = (const unsigned char*)board_rep; *c; c++) {
+        hash ^= *c;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+/** Initializes an empty cache.
+ * Arguments:
+ *  - cache: the cache to initialize.
+ *  - max_bytes: memory limit for cached boards. The most recently used
+ *    board is always kept, even if it alone is over the limit.
+ */
+void board_cache_init(board_cache_t* cache, size_t max_bytes) {
+    memset(cache, 0, sizeof(*cache));
+    cache->max_bytes = max_bytes;
+}
+
+/* Frees the memory owned by one cached board.
+ */
+static void free_proto(board_proto_t* proto) {
+    free(proto->board_rep);
+    free(proto->cells);
+}
+
+/** Frees every cached board.
+ */
+void board_cache_free(board_cache_t* cache) {
+    for (size_t i = 0; i < cache->num_protos; i++) {
+        free_proto(&cache->protos[i]);
+    }
+    free(cache->protos);
+    cache->protos = NULL;
+    cache->num_protos = 0;
+    cache->bytes = 0;
+}
+
+/* Evicts least recently used boards, other than `keep`, until the cache is
+   within its memory limit.
+*/
+static void evict(board_cache_t* cache, uint64_t keep) {
+    while (cache->bytes > cache->max_bytes && cache->num_protos > 1) {
+        size_t oldest = cache->num_protos;
+        for (size_t i = 0; i < cache->num_protos; i++) {
+            if (cache->protos[i].hash != keep &&
+                (oldest == cache->num_protos ||
+                 cache->protos[i].last_used < cache->protos[oldest].last_used)) {
+                oldest = i;
+            }
+        }
+        cache->bytes -= cache->protos[oldest].bytes;
+        free_proto(&cache->protos[oldest]);
+        cache->protos[oldest] = cache->protos[--cache->num_protos];
+        cache->evictions++;
+    }
+}
+
+/* Decodes a board into a new cache entry. Returns the decoding status; on
+   failure nothing is added.
+*/
+static enum board_init_status decode_proto(board_cache_t* cache,
+                                           char* board_rep, uint64_t hash,
+                                           board_proto_t** proto_p) {
+    board_proto_t proto;
+    memset(&proto, 0, sizeof(proto));
+    proto.hash = hash;
+
+    // cached boards outlive any one game, so keep them out of the arena
+    arena_t* saved_arena = g_arena;
+    g_arena = NULL;
+
+    snake_t snake;
+    snake_body_init(&snake.snake_pos);
+    enum board_init_status status;
+    if (board_rep == NULL) {
+        status =
+            initialize_default_board(&proto.cells, &proto.width, &proto.height);
+        proto.snake_start = cell_index(2, 2, 20);
+    } else {
+        // decompression tokenizes the string in place, so work on a copy
+        proto.board_rep = strdup(board_rep);
+        char* scratch = strdup(board_rep);
+        status = decompress_board_str(&proto.cells, &proto.width,
+                                      &proto.height, &snake, scratch);
+        free(scratch);
+        if (snake.snake_pos.length > 0) {
+            proto.snake_start = snake.snake_pos.head;
+        }
+        snake_body_clear(&snake.snake_pos);
+    }
+    g_arena = saved_arena;
+    if (status != INIT_SUCCESS) {
+        free_proto(&proto);
+        return status;
+    }
+
+    proto.free_cells =
+        count_free_cells(proto.cells, proto.width, proto.height, SIZE_MAX);
+    proto.bytes = cell_count(proto.width, proto.height) * sizeof(int) +
+                  (board_rep ? strlen(board_rep) + 1 : 0);
+    cache->protos = realloc(cache->protos,
+                            (cache->num_protos + 1) * sizeof(board_proto_t));
+    cache->protos[cache->num_protos] = proto;
+    cache->bytes += proto.bytes;
+    cache->num_protos++;
+    *proto_p = &cache->protos[cache->num_protos - 1];
+    return INIT_SUCCESS;
+}
+
+/** Finds the decoded form of a board string, decoding and caching it on a
+ * miss. Invalid boards are not cached.
+ *
+ * Returns the status decompress_board_str() gives for this board.
+ *
+ * Arguments:
+ *  - cache: the cache.
+ *  - board_rep: a string representing the board, or NULL for the default
+ *    board. It is not modified.
+ *  - proto_p: on success, set to the cached board. It stays valid until the
+ *    next lookup.
+ */
+enum board_init_status board_cache_lookup(board_cache_t* cache,
+                                          char* board_rep,
+                                          const board_proto_t** proto_p) {
+    uint64_t hash = board_hash(board_rep);
+    cache->clock++;
+
+    for (size_t i = 0; i < cache->num_protos; i++) {
+        board_proto_t* proto = &cache->protos[i];
+        if (proto->hash == hash &&
+            (board_rep == NULL ? proto->board_rep == NULL
+                               : proto->board_rep != NULL &&
+                                     strcmp(proto->board_rep, board_rep) == 0)) {
+            cache->hits++;
+            proto->last_used = cache->clock;
+            *proto_p = proto;
+            return INIT_SUCCESS;
+        }
+    }
+
+    cache->misses++;
+    board_proto_t* proto;
+    enum board_init_status status =
+        decode_proto(cache, board_rep, hash, &proto);
+    if (status != INIT_SUCCESS) {
+        return status;
+    }
+    proto->last_used = cache->clock;
+    evict(cache, hash);
+
+    // eviction may have moved the new entry
+    for (size_t i = 0; i < cache->num_protos; i++) {
+        if (cache->protos[i].last_used == cache->clock) {
+            *proto_p = &cache->protos[i];
+        }
+    }
+    return INIT_SUCCESS;
+}
+
+/** Same as initialize_game(), but the board is cloned from the cache rather
+ * than decoded again. `board_rep` is not modified.
+ */
+enum board_init_status board_cache_initialize_game(
+    board_cache_t* cache, int** cells_p, size_t* width_p, size_t* height_p,
+    snake_t* snake_p, char* board_rep) {
+    snake_body_init(&snake_p->snake_pos);
+    const board_proto_t* proto;
+    enum board_init_status status = board_cache_lookup(cache, board_rep, &proto);
+    if (status != INIT_SUCCESS) {
+        *cells_p = NULL;
+        return status;
+    }
+
+    size_t num_cells = cell_count(proto->width, proto->height);
+    *cells_p = game_alloc(num_cells * sizeof(int));
+    memcpy(*cells_p, proto->cells, num_cells * sizeof(int));
+    *width_p = proto->width;
+    *height_p = proto->height;
+    int init_pos = proto->snake_start;
+    snake_body_push_head(&snake_p->snake_pos, RIGHT, init_pos);
+
+    start_counted_game(*cells_p, *width_p, *height_p, snake_p,
+                       proto->free_cells);
+    return INIT_SUCCESS;
+}
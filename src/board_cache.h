@@ -0,0 +1,65 @@
+#ifndef BOARD_CACHE_H
+#define BOARD_CACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "game_setup.h"
+
+/** A decoded board kept by the cache: the cells as decompressed (before any
+ * food is placed) plus where the snake starts.
+ * Fields:
+ *  - hash: hash of the board string
+ *  - board_rep: copy of the board string (NULL for the default board)
+ *  - cells: prototype cells, cell_count(width, height) of them
+ *  - width, height: board dimensions
+ *  - snake_start: position of the snake's only cell
+ *  - free_cells: number of cells food can go on, from count_free_cells()
+ *  - bytes: memory charged to the cache for this entry
+ *  - last_used: value of the cache's clock when the entry was last used
+ */
+typedef struct board_proto {
+    uint64_t hash;
+    char* board_rep;
+    int* cells;
+    size_t width;
+    size_t height;
+    int snake_start;
+    size_t free_cells;
+    size_t bytes;
+    unsigned long last_used;
+} board_proto_t;
+
+/** Cache of decoded boards, bounded by memory use. Least recently used
+ * boards are evicted first.
+ * Fields:
+ *  - protos: the cached boards
+ *  - num_protos: number of cached boards
+ *  - max_bytes: memory limit for all cached boards
+ *  - bytes: memory currently used by cached boards
+ *  - clock: incremented on every lookup, for LRU eviction
+ *  - hits, misses, evictions: statistics
+ */
+typedef struct board_cache {
+    board_proto_t* protos;
+    size_t num_protos;
+    size_t max_bytes;
+    size_t bytes;
+    unsigned long clock;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+} board_cache_t;
+
+uint64_t board_hash(const char* board_rep);
+void board_cache_init(board_cache_t* cache, size_t max_bytes);
+void board_cache_free(board_cache_t* cache);
+enum board_init_status board_cache_lookup(board_cache_t* cache,
+                                          char* board_rep,
+                                          const board_proto_t** proto_p);
+enum board_init_status board_cache_initialize_game(
+    board_cache_t* cache, int** cells_p, size_t* width_p, size_t* height_p,
+    snake_t* snake_p, char* board_rep);
+
+#endif
@@ -0,0 +1,162 @@
+#include "board_gen.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Scrambles a 64-bit value (the splitmix64 finalizer). */
+static uint64_t mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    return x ^ (x >> 31);
+}
+
+/* A random number for the cell at (row, col), fixed by the seed. `salt`
+   picks an independent stream for each kind of decision.
+*/
+static uint64_t cell_hash(const board_gen_t* gen, size_t row, size_t col,
+                          uint64_t salt) {
+    return mix(gen->seed ^ mix(row * 0x9e3779b97f4a7c15ull + col) ^
+               salt * 0xd6e8feb86659fd93ull);
+}
+
+/* Binary tree maze: maze cells sit at odd (row, col), and each carves a
+   passage either east or north. The top row can only carve east and the
+   last column only north, so every cell is reachable.
+*/
+static int maze_carves_east(const board_gen_t* gen, size_t row, size_t col,
+                            size_t last_col) {
+    if (col == last_col) {
+        return 0;
+    }
+    return row == 1 || (cell_hash(gen, row, col, 1) & 1);
+}
+
+static int maze_open(const board_gen_t* gen, size_t row, size_t col) {
+    size_t last_col = gen->width - 2 - (gen->width % 2 == 0);
+    size_t last_row = gen->height - 2 - (gen->height % 2 == 0);
+    if (row % 2 == 1 && col % 2 == 1) {
+        return 1;
+    }
+    if (row % 2 == 1) {
+        // the wall between two cells of a row
+        return maze_carves_east(gen, row, col - 1, last_col);
+    }
+    if (col % 2 == 1) {
+        // the wall between two cells of a column: open if the lower one
+        // carves north
+        return row + 1 <= last_row &&
+               !maze_carves_east(gen, row + 1, col, last_col);
+    }
+    return 0;
+}
+
+/* Rooms on a grid with a pitch of room_size + 1. Each wall between two
+   rooms has a one-cell door at a random place along it.
+*/
+static int rooms_open(const board_gen_t* gen, size_t row, size_t col) {
+    size_t pitch = gen->room_size + 1;
+    int on_row_wall = row % pitch == 0;
+    int on_col_wall = col % pitch == 0;
+    if (on_row_wall && on_col_wall) {
+        return 0;
+    }
+    if (on_row_wall) {
+        size_t door =
+            1 + cell_hash(gen, row / pitch, col / pitch, 2) % gen->room_size;
+        return col % pitch == door;
+    }
+    if (on_col_wall) {
+        size_t door =
+            1 + cell_hash(gen, row / pitch, col / pitch, 3) % gen->room_size;
+        return row % pitch == door;
+    }
+    return 1;
+}
+
+/** Returns the letter of the cell at (row, col) of a generated board: `W`,
+ * `E`, `G` or `S`. The parameters must be valid (see board_gen_t).
+ */
+char board_gen_cell(const board_gen_t* gen, size_t row, size_t col) {
+    if (row == 0 || col == 0 || row + 1 >= gen->height ||
+        col + 1 >= gen->width) {
+        return 'W';
+    }
+    if (row == 1 && col == 1) {
+        return 'S';
+    }
+    int open = 1;
+    switch (gen->kind) {
+        case GEN_RANDOM:
+            // keep the snake's first move clear
+            open = (row == 1 && col == 2) ||
+                   cell_hash(gen, row, col, 0) % 100 >= gen->density;
+            break;
+        case GEN_MAZE:
+            open = maze_open(gen, row, col);
+            break;
+        case GEN_ROOMS:
+            open = rooms_open(gen, row, col);
+            break;
+    }
+    if (!open) {
+        return 'W';
+    }
+    size_t edge = row;
+    edge = col < edge ? col : edge;
+    edge = gen->height - 1 - row < edge ? gen->height - 1 - row : edge;
+    edge = gen->width - 1 - col < edge ? gen->width - 1 - col : edge;
+    return edge <= gen->grass ? 'G' : 'E';
+}
+
+/** Writes a generated board to `out` as a compressed board string, one row
+ * at a time. Memory use does not depend on the board size, so boards far too
+ * big to hold (say 100k x 100k) can be streamed to a file or a pipe.
+ *
+ * Returns 0 on success and -1 if writing failed.
+ */
+int board_gen_write(const board_gen_t* gen, FILE* out) {
+    fprintf(out, "B%zux%zu", gen->height, gen->width);
+    for (size_t row = 0; row < gen->height; row++) {
+        putc('|', out);
+        char letter = board_gen_cell(gen, row, 0);
+        size_t run = 1;
+        for (size_t col = 1; col < gen->width; col++) {
+            char next = board_gen_cell(gen, row, col);
+            if (next == letter) {
+                run++;
+                continue;
+            }
+            fprintf(out, "%c%zu", letter, run);
+            letter = next;
+            run = 1;
+        }
+        fprintf(out, "%c%zu", letter, run);
+        if (ferror(out)) {
+            return -1;
+        }
+    }
+    return fflush(out) == 0 && !ferror(out) ? 0 : -1;
+}
+
+/** Returns a generated board as a compressed board string, or NULL if it
+ * could not be built. The caller frees it.
+ */
+char* board_gen_string(const board_gen_t* gen) {
+    char* buf = NULL;
+    size_t size = 0;
+    FILE* out = open_memstream(&buf, &size);
+    if (out == NULL) {
+        return NULL;
+    }
+    int status = board_gen_write(gen, out);
+    fclose(out);
+    if (status < 0) {
+        free(buf);
+        return NULL;
+    }
+    return buf;
+}
@@ -0,0 +1,43 @@
+#ifndef BOARD_GEN_H
+#define BOARD_GEN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Kinds of generated board.
+enum board_gen_kind {
+    GEN_RANDOM,  // walls scattered at random, `density` percent of cells
+    GEN_MAZE,    // a perfect maze with one-cell corridors
+    GEN_ROOMS,   // square rooms, each with a door to each neighbour
+};
+
+/** Parameters of a generated board. Every cell is a pure function of these
+ * and the cell's coordinates, so a board of any size can be written out a
+ * row at a time without holding it in memory.
+ *
+ * Every board is surrounded by walls and has the snake at (1, 1), with the
+ * cell to its right open on boards at least 5 cells wide.
+ * Fields:
+ *  - kind: the layout
+ *  - width, height: board size, each at least 3
+ *  - seed: boards with the same parameters and seed are identical
+ *  - density: GEN_RANDOM only, the percentage of cells that are walls
+ *  - room_size: GEN_ROOMS only, the inside size of a room, at least 2
+ *  - grass: width of the band of grass inside the outer wall, 0 for none
+ */
+typedef struct board_gen {
+    enum board_gen_kind kind;
+    size_t width;
+    size_t height;
+    uint64_t seed;
+    unsigned density;
+    size_t room_size;
+    size_t grass;
+} board_gen_t;
+
+char board_gen_cell(const board_gen_t* gen, size_t row, size_t col);
+int board_gen_write(const board_gen_t* gen, FILE* out);
+char* board_gen_string(const board_gen_t* gen);
+
+#endif
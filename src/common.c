@@ -3,8 +3,8 @@
 #include <stdlib.h>
 
 // Definition of global variables for game status.
-int g_game_over;
-int g_score;
+_Thread_local int g_game_over;
+_Thread_local int g_score;
 char* g_name;
 int g_name_len;
 
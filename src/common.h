@@ -4,6 +4,7 @@
 #include <stddef.h>
 
 #include "linked_list.h"
+#include "snake_body.h"
 
 
 // Bitflags enable us to store cell data in integers!
@@ -22,30 +23,194 @@
 enum input_key { INPUT_UP, INPUT_DOWN, INPUT_LEFT, INPUT_RIGHT, INPUT_NONE };
 enum direction { UP, DOWN, LEFT, RIGHT };
 
+/** Cell layout. Every access to a cells array goes through these helpers so
+ * the layout can be picked at build time:
+ *  - neither flag (`make LAYOUT=rowmajor`): row-major,
+ *    cells[row * width + col].
+ *  - CELL_LAYOUT_BLOCKED (`make LAYOUT=blocked`): the board is split into
+ *    CELL_BLOCK x CELL_BLOCK blocks stored one after another, each block
+ *    row-major. Vertical neighbours then usually share a block instead of
+ *    being `width` cells apart. Boards are padded up to whole blocks, so a
+ *    cells array holds cell_count() cells rather than width * height.
+ *  - CELL_LAYOUT_PADDED (`make LAYOUT=padded`, the default): row-major with
+ *    a ring of sentinel cells around the board, so that no step from a board
+ *    cell leaves the array, whatever the board. The ring is walls (the snake
+ *    dies at the edge) unless set_board_edges() makes the board wrap around.
+ * Only the padded layout is memory safe on a board without walls all around
+ * its edge; in the others a step off the edge leaves the board.
+ * A position (`pos`) is an index into the cells array.
+ */
+#define CELL_BLOCK_SHIFT 3
+#define CELL_BLOCK (1 << CELL_BLOCK_SHIFT)
+#define CELL_BLOCK_MASK (CELL_BLOCK - 1)
+
+#if defined(CELL_LAYOUT_BLOCKED)
+static inline size_t cell_blocks_x(size_t width) {
+    return (width + CELL_BLOCK_MASK) >> CELL_BLOCK_SHIFT;
+}
+
+static inline size_t cell_index(size_t row, size_t col, size_t width) {
+    size_t block = (row >> CELL_BLOCK_SHIFT) * cell_blocks_x(width) +
+                   (col >> CELL_BLOCK_SHIFT);
+    return (block << (2 * CELL_BLOCK_SHIFT)) |
+           ((row & CELL_BLOCK_MASK) << CELL_BLOCK_SHIFT) |
+           (col & CELL_BLOCK_MASK);
+}
+
+static inline size_t cell_row(size_t pos, size_t width) {
+    size_t block = pos >> (2 * CELL_BLOCK_SHIFT);
+    return (block / cell_blocks_x(width)) * CELL_BLOCK +
+           ((pos >> CELL_BLOCK_SHIFT) & CELL_BLOCK_MASK);
+}
+
+static inline size_t cell_col(size_t pos, size_t width) {
+    size_t block = pos >> (2 * CELL_BLOCK_SHIFT);
+    return (block % cell_blocks_x(width)) * CELL_BLOCK +
+           (pos & CELL_BLOCK_MASK);
+}
+
+static inline size_t cell_count(size_t width, size_t height) {
+    size_t blocks_y = (height + CELL_BLOCK_MASK) >> CELL_BLOCK_SHIFT;
+    return cell_blocks_x(width) * blocks_y * CELL_BLOCK * CELL_BLOCK;
+}
+
+static inline size_t cell_step(size_t pos, enum direction dir, size_t width) {
+    // moves that stay inside the block are a fixed offset
+    switch (dir) {
+        case UP:
+            if ((pos >> CELL_BLOCK_SHIFT) & CELL_BLOCK_MASK) {
+                return pos - CELL_BLOCK;
+            }
+            break;
+        case DOWN:
+            if (((pos >> CELL_BLOCK_SHIFT) & CELL_BLOCK_MASK) !=
+                CELL_BLOCK_MASK) {
+                return pos + CELL_BLOCK;
+            }
+            break;
+        case LEFT:
+            if (pos & CELL_BLOCK_MASK) {
+                return pos - 1;
+            }
+            break;
+        case RIGHT:
+            if ((pos & CELL_BLOCK_MASK) != CELL_BLOCK_MASK) {
+                return pos + 1;
+            }
+            break;
+    }
+    size_t row = cell_row(pos, width);
+    size_t col = cell_col(pos, width);
+    switch (dir) {
+        case UP:
+            return cell_index(row - 1, col, width);
+        case DOWN:
+            return cell_index(row + 1, col, width);
+        case LEFT:
+            return cell_index(row, col - 1, width);
+        case RIGHT:
+        default:
+            return cell_index(row, col + 1, width);
+    }
+}
+#elif defined(CELL_LAYOUT_PADDED)
+// Row and column -1 are the ring, and index arithmetic wraps, so
+// cell_index(-1, col, width) works too.
+static inline size_t cell_index(size_t row, size_t col, size_t width) {
+    return (row + 1) * (width + 2) + col + 1;
+}
+
+static inline size_t cell_row(size_t pos, size_t width) {
+    return pos / (width + 2) - 1;
+}
+
+static inline size_t cell_col(size_t pos, size_t width) {
+    return pos % (width + 2) - 1;
+}
+
+static inline size_t cell_count(size_t width, size_t height) {
+    return (width + 2) * (height + 2);
+}
+
+static inline size_t cell_step(size_t pos, enum direction dir, size_t width) {
+    const ptrdiff_t offsets[] = {-(ptrdiff_t)width - 2, (ptrdiff_t)width + 2,
+                                 -1, 1};
+    return pos + offsets[dir];
+}
+#else
+static inline size_t cell_index(size_t row, size_t col, size_t width) {
+    return row * width + col;
+}
+
+static inline size_t cell_row(size_t pos, size_t width) { return pos / width; }
+
+static inline size_t cell_col(size_t pos, size_t width) { return pos % width; }
+
+static inline size_t cell_count(size_t width, size_t height) {
+    return width * height;
+}
+
+static inline size_t cell_step(size_t pos, enum direction dir, size_t width) {
+    switch (dir) {
+        case UP:
+            return pos - width;
+        case DOWN:
+            return pos + width;
+        case LEFT:
+            return pos - 1;
+        case RIGHT:
+        default:
+            return pos + 1;
+    }
+}
+#endif
+
+/** Ring cells of a wrapping board (padded layout only) hold the offset to
+ * the board cell on the far side, shifted up by CELL_JUMP_SHIFT. Board cells
+ * and wall ring cells have nothing in those bits.
+ */
+#define CELL_JUMP_SHIFT 5
+
+/** Returns the position one step from `pos` in direction `dir`. On a
+ * wrapping board a step into the ring continues from the far side; that is
+ * a load and an add, with no branch, and other layouts compile it away.
+ */
+static inline size_t cell_neighbour(const int* cells, size_t pos,
+                                    enum direction dir, size_t width) {
+    size_t next = cell_step(pos, dir, width);
+#ifdef CELL_LAYOUT_PADDED
+    next += (ptrdiff_t)(cells[next] >> CELL_JUMP_SHIFT);
+#endif
+    return next;
+}
+
 /** Global variables for game status.
  *
  * `g_` prefix used by convention to emphasize that these are global.
  *
+ * The game state globals (these two, g_arena, g_food_index, g_zobrist and
+ * g_delta) are per thread, so each thread can run games of its own; see
+ * game_sched.h.
  *
  * Variables:
  *  - g_game_over: 1 if game is over, 0 otherwise
  *  - g_score: current game score. Starts at 0. 1 point for every food eaten.
  */
-extern int g_game_over;  // 1 if game is over, 0 otherwise
-extern int g_score;      // game score: 1 point for every food eaten
+extern _Thread_local int g_game_over;  // 1 if game is over, 0 otherwise
+extern _Thread_local int g_score;  // game score: 1 point for every food eaten
 extern int g_name_len;
 extern char* g_name;
 
 /** Snake struct. This struct is not needed until part 3!
  * Fields:
  *  - snake_dir: direction head is moving in
- * -snake_pos: tile snake head currently occupies
+ * -snake_pos: tiles the snake occupies, as a packed body (see snake_body.h)
  * -snake_len: length of snake
  */
 
 typedef struct snake {
     enum direction snake_dir;
-    node_t* snake_pos;
+    snake_body_t snake_pos;
     int snake_len;
 } snake_t;
 
@@ -0,0 +1,256 @@
+#include "delta.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+// Stream format. Numbers are LEB128 varints; signed ones are zigzagged.
+//
+//   header:  "SNKD" version(1 byte) width height score game_over(1 byte)
+//   board:   (run_length flags) pairs, covering width * height cells in
+//            row-major order
+//   ticks:   one record per update(), until end of stream:
+//              num_changes
+//              num_changes x (index_gap flags), by increasing row-major
+//              index; each gap is from the previous index (or from 0)
+//              status: zigzag(score change) << 1 | game_over
+//
+// A typical tick (tail leaves one cell, head enters another) takes 6-8
+// bytes however big the board is.
+#define DELTA_MAGIC "SNKD"
+#define DELTA_VERSION 1
+
+_Thread_local delta_writer_t* g_delta;
+
+/* Writes an unsigned varint.
+ */
+static void put_varint(delta_writer_t* writer, uint64_t value) {
+    unsigned char buf[10];
+    size_t len = 0;
+    do {
+        buf[len] = (unsigned char)(value & 0x7f);
+        value >>= 7;
+        buf[len] |= value ? 0x80 : 0;
+        len++;
+    } while (value);
+    fwrite(buf, 1, len, writer->out);
+    writer->bytes += len;
+}
+
+/* Reads an unsigned varint. Returns 1 on success, 0 at a clean end of
+   stream and -1 if the stream ends partway through.
+*/
+static int get_varint(FILE* in, uint64_t* value_p) {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64; shift += 7) {
+        int c = getc(in);
+        if (c == EOF) {
+            return shift == 0 ? 0 : -1;
+        }
+        value |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *value_p = value;
+            return 1;
+        }
+    }
+    return -1;
+}
+
+static uint64_t zigzag(int64_t value) {
+    return ((uint64_t)value << 1) ^ (uint64_t)(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+    return (int64_t)(value >> 1) ^ -(int64_t)(value & 1);
+}
+
+/** Starts a delta stream: writes the header and the board as it is now.
+ * Set g_delta to the writer to record the game's ticks.
+ * Arguments:
+ *  - writer: the writer to initialize.
+ *  - out: a file or pipe opened for writing. It is not closed by the writer.
+ *  - cells: the board.
+ *  - width, height: board dimensions.
+ */
+void delta_writer_open(delta_writer_t* writer, FILE* out, int* cells,
+                       size_t width, size_t height) {
+    memset(writer, 0, sizeof(*writer));
+    writer->out = out;
+    writer->width = width;
+    writer->height = height;
+    writer->score = g_score;
+    writer->game_over = g_game_over;
+
+    fwrite(DELTA_MAGIC, 1, 4, out);
+    putc(DELTA_VERSION, out);
+    writer->bytes = 5;
+    put_varint(writer, width);
+    put_varint(writer, height);
+    put_varint(writer, (uint64_t)g_score);
+    put_varint(writer, (uint64_t)g_game_over);
+
+    size_t num_cells = width * height;
+    size_t run_start = 0;
+    for (size_t i = 1; i <= num_cells; i++) {
+        int start = cells[cell_index(run_start / width, run_start % width,
+                                     width)];
+        if (i == num_cells ||
+            cells[cell_index(i / width, i % width, width)] != start) {
+            put_varint(writer, i - run_start);
+            put_varint(writer, (uint64_t)start);
+            run_start = i;
+        }
+    }
+}
+
+/** Makes room for more touched cells. Called by delta_touch().
+ */
+void delta_grow(delta_writer_t* writer) {
+    writer->cap_touched = writer->cap_touched ? writer->cap_touched * 2 : 8;
+    writer->touched = realloc(writer->touched,
+                              writer->cap_touched * sizeof(delta_touch_t));
+}
+
+/** Writes the record for the tick that just ran: every touched cell whose
+ * value actually changed, plus the score and game-over changes.
+ */
+void delta_end_tick(delta_writer_t* writer, int* cells, int score,
+                    int game_over) {
+    // turn touched cells into row-major indices, dropping any that changed
+    // back, and sort them; a tick touches only a handful
+    size_t num = 0;
+    for (size_t i = 0; i < writer->num_touched; i++) {
+        size_t pos = writer->touched[i].pos;
+        if (cells[pos] == writer->touched[i].old) {
+            continue;
+        }
+        delta_touch_t change = {
+            cell_row(pos, writer->width) * writer->width +
+                cell_col(pos, writer->width),
+            cells[pos]};
+        size_t j = num++;
+        while (j > 0 && writer->touched[j - 1].pos > change.pos) {
+            writer->touched[j] = writer->touched[j - 1];
+            j--;
+        }
+        writer->touched[j] = change;
+    }
+
+    put_varint(writer, num);
+    size_t prev = 0;
+    for (size_t i = 0; i < num; i++) {
+        put_varint(writer, writer->touched[i].pos - prev);
+        put_varint(writer, (uint64_t)writer->touched[i].old);
+        prev = writer->touched[i].pos;
+    }
+    put_varint(writer,
+               zigzag((int64_t)score - writer->score) << 1 | (game_over != 0));
+
+    writer->num_touched = 0;
+    writer->score = score;
+    writer->game_over = game_over;
+    writer->ticks++;
+}
+
+/** Frees the writer's memory and flushes its stream.
+ */
+void delta_writer_close(delta_writer_t* writer) {
+    fflush(writer->out);
+    free(writer->touched);
+    memset(writer, 0, sizeof(*writer));
+}
+
+/** Reads a stream's header and starting board.
+ *
+ * Returns 0 on success and -1 if the stream isn't a valid delta stream.
+ */
+int delta_reader_open(delta_reader_t* reader, FILE* in) {
+    memset(reader, 0, sizeof(*reader));
+    reader->in = in;
+
+    char magic[5];
+    uint64_t width, height, score, game_over;
+    if (fread(magic, 1, 5, in) != 5 || memcmp(magic, DELTA_MAGIC, 4) != 0 ||
+        magic[4] != DELTA_VERSION || get_varint(in, &width) != 1 ||
+        get_varint(in, &height) != 1 || get_varint(in, &score) != 1 ||
+        get_varint(in, &game_over) != 1 || width == 0 || height == 0 ||
+        width > SIZE_MAX / sizeof(int) / height) {
+        return -1;
+    }
+    reader->width = width;
+    reader->height = height;
+    reader->score = (int)score;
+    reader->game_over = (int)game_over;
+
+    size_t num_cells = reader->width * reader->height;
+    reader->cells = malloc(num_cells * sizeof(int));
+    size_t filled = 0;
+    while (filled < num_cells) {
+        uint64_t run, flags;
+        if (get_varint(in, &run) != 1 || get_varint(in, &flags) != 1 ||
+            run == 0 || run > num_cells - filled) {
+            delta_reader_close(reader);
+            return -1;
+        }
+        for (uint64_t i = 0; i < run; i++) {
+            reader->cells[filled++] = (int)flags;
+        }
+    }
+    return 0;
+}
+
+/** Applies the next tick to the reader's board.
+ *
+ * Returns 1 if a tick was applied, 0 at the end of the stream and -1 if the
+ * stream is corrupt or cut off partway through a tick.
+ */
+int delta_reader_next(delta_reader_t* reader) {
+    uint64_t num;
+    int status = get_varint(reader->in, &num);
+    if (status != 1) {
+        return status;
+    }
+    size_t num_cells = reader->width * reader->height;
+    if (num > num_cells) {
+        return -1;
+    }
+    if (num > reader->cap_changed) {
+        reader->cap_changed = num;
+        reader->changed =
+            realloc(reader->changed, reader->cap_changed * sizeof(size_t));
+    }
+
+    uint64_t index = 0;
+    for (uint64_t i = 0; i < num; i++) {
+        uint64_t gap, flags;
+        if (get_varint(reader->in, &gap) != 1 ||
+            get_varint(reader->in, &flags) != 1 || gap >= num_cells - index) {
+            return -1;
+        }
+        index += gap;
+        reader->cells[index] = (int)flags;
+        reader->changed[i] = index;
+    }
+    reader->num_changed = num;
+
+    uint64_t tick_status;
+    if (get_varint(reader->in, &tick_status) != 1) {
+        return -1;
+    }
+    reader->score += (int)unzigzag(tick_status >> 1);
+    reader->game_over = (int)(tick_status & 1);
+    reader->ticks++;
+    return 1;
+}
+
+/** Frees the reader's memory. The stream is not closed.
+ */
+void delta_reader_close(delta_reader_t* reader) {
+    free(reader->cells);
+    free(reader->changed);
+    memset(reader, 0, sizeof(*reader));
+}
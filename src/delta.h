@@ -0,0 +1,95 @@
+#ifndef DELTA_H
+#define DELTA_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// A cell about to change during the current tick, with its value before.
+typedef struct delta_touch {
+    size_t pos;
+    int old;
+} delta_touch_t;
+
+/** Writes a game as a stream of per-tick deltas. See delta.c for the
+ * format.
+ * Fields:
+ *  - out: where the stream goes
+ *  - width, height: board dimensions
+ *  - touched: cells changed so far this tick, each listed once
+ *  - num_touched, cap_touched: length and capacity of `touched`
+ *  - score, game_over: values as of the last record written
+ *  - ticks: number of tick records written
+ *  - bytes: number of bytes written, header included
+ */
+typedef struct delta_writer {
+    FILE* out;
+    size_t width;
+    size_t height;
+    delta_touch_t* touched;
+    size_t num_touched;
+    size_t cap_touched;
+    int score;
+    int game_over;
+    uint64_t ticks;
+    size_t bytes;
+} delta_writer_t;
+
+/** Rebuilds a game from a delta stream.
+ * Fields:
+ *  - in: the stream
+ *  - width, height: board dimensions
+ *  - cells: the board as of the last tick read, one int per cell in
+ *    row-major order (cells[row * width + col]) whatever the game's layout
+ *  - score, game_over: as of the last tick read
+ *  - ticks: number of ticks read
+ *  - changed: row-major indices of the cells changed by the last tick
+ *  - num_changed, cap_changed: length and capacity of `changed`
+ */
+typedef struct delta_reader {
+    FILE* in;
+    size_t width;
+    size_t height;
+    int* cells;
+    int score;
+    int game_over;
+    uint64_t ticks;
+    size_t* changed;
+    size_t num_changed;
+    size_t cap_changed;
+} delta_reader_t;
+
+/** The writer that update() and place_food() record changes into, or NULL
+ * (the default) to record nothing.
+ */
+extern _Thread_local delta_writer_t* g_delta;
+
+void delta_writer_open(delta_writer_t* writer, FILE* out, int* cells,
+                       size_t width, size_t height);
+void delta_grow(delta_writer_t* writer);
+void delta_end_tick(delta_writer_t* writer, int* cells, int score,
+                    int game_over);
+void delta_writer_close(delta_writer_t* writer);
+int delta_reader_open(delta_reader_t* reader, FILE* in);
+int delta_reader_next(delta_reader_t* reader);
+void delta_reader_close(delta_reader_t* reader);
+
+/** Notes that cells[pos] is about to change this tick. Must be called
+ * before the cell is written.
+ */
+static inline void delta_touch(delta_writer_t* writer, int* cells,
+                               size_t pos) {
+    for (size_t i = 0; i < writer->num_touched; i++) {
+        if (writer->touched[i].pos == pos) {
+            return;
+        }
+    }
+    if (writer->num_touched == writer->cap_touched) {
+        delta_grow(writer);
+    }
+    writer->touched[writer->num_touched].pos = pos;
+    writer->touched[writer->num_touched].old = cells[pos];
+    writer->num_touched++;
+}
+
+#endif
@@ -0,0 +1,212 @@
+#include "event_loop.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <errno.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/signalfd.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define MAX_EVENTS 16  // events handled per wake-up
+
+/** Initializes an empty event loop.
+ *
+ * Returns 0 on success and -1 on failure.
+ */
+int event_loop_init(event_loop_t* loop) {
+    memset(loop, 0, sizeof(*loop));
+    loop->epfd = epoll_create1(EPOLL_CLOEXEC);
+    return loop->epfd < 0 ? -1 : 0;
+}
+
+/** Closes the loop, along with any timers and signal fds it created, and
+ * unblocks the signals it took over. Any of them still pending are then
+ * delivered as usual.
+ */
+void event_loop_close(event_loop_t* loop) {
+    for (size_t fd = 0; fd < loop->num_handlers; fd++) {
+        if (loop->handlers[fd].owned) {
+            close((int)fd);
+        }
+    }
+    if (loop->masked) {
+        sigprocmask(SIG_SETMASK, &loop->old_mask, NULL);
+    }
+    free(loop->handlers);
+    close(loop->epfd);
+    memset(loop, 0, sizeof(*loop));
+    loop->epfd = -1;
+}
+
+/** Registers a file descriptor: `cb` is called with `data` whenever one of
+ * `events` (e.g. EPOLLIN) is ready. Events are level-triggered, so a handler
+ * that leaves data unread is called again on the next wake-up.
+ *
+ * Returns 0 on success and -1 on failure.
+ */
+int event_loop_add(event_loop_t* loop, int fd, uint32_t events, event_cb cb,
+                   void* data) {
+    if ((size_t)fd >= loop->num_handlers) {
+        size_t num = loop->num_handlers ? loop->num_handlers : 16;
+        while (num <= (size_t)fd) {
+            num *= 2;
+        }
+        loop->handlers =
+            realloc(loop->handlers, num * sizeof(event_handler_t));
+        memset(&loop->handlers[loop->num_handlers], 0,
+               (num - loop->num_handlers) * sizeof(event_handler_t));
+        loop->num_handlers = num;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+    if (epoll_ctl(loop->epfd, EPOLL_CTL_ADD, fd, &event) < 0) {
+        return -1;
+    }
+    loop->handlers[fd].cb = cb;
+    loop->handlers[fd].data = data;
+    loop->handlers[fd].owned = 0;
+    return 0;
+}
+
+/** Unregisters a file descriptor. Timers and signal fds made by the loop are
+ * closed; other descriptors are left open.
+ *
+ * Returns 0 on success and -1 on failure.
+ */
+int event_loop_remove(event_loop_t* loop, int fd) {
+    if ((size_t)fd >= loop->num_handlers || loop->handlers[fd].cb == NULL) {
+        return -1;
+    }
+    if (loop->handlers[fd].owned) {
+        close(fd);  // closing also removes it from the epoll set
+        memset(&loop->handlers[fd], 0, sizeof(event_handler_t));
+        return 0;
+    }
+    loop->handlers[fd].cb = NULL;
+    return epoll_ctl(loop->epfd, EPOLL_CTL_DEL, fd, NULL);
+}
+
+/** Registers a timer that fires every `interval_ms` milliseconds, starting
+ * one interval from now. Handlers should call
+ * event_loop_timer_expirations() to acknowledge it.
+ *
+ * Returns the timer's file descriptor, or -1 on failure.
+ */
+int event_loop_add_timer(event_loop_t* loop, long interval_ms, event_cb cb,
+                         void* data) {
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    struct itimerspec spec;
+    spec.it_interval.tv_sec = interval_ms / 1000;
+    spec.it_interval.tv_nsec = (interval_ms % 1000) * 1000000;
+    spec.it_value = spec.it_interval;
+    if (timerfd_settime(fd, 0, &spec, NULL) < 0 ||
+        event_loop_add(loop, fd, EPOLLIN, cb, data) < 0) {
+        close(fd);
+        return -1;
+    }
+    loop->handlers[fd].owned = 1;
+    return fd;
+}
+
+/** Blocks the given signals and delivers them through the loop instead,
+ * until event_loop_close(). Handlers should call event_loop_next_signal() to
+ * take each one.
+ *
+ * Returns the signal file descriptor, or -1 on failure, in which case the
+ * signal mask is left as it was.
+ */
+int event_loop_add_signals(event_loop_t* loop, const int* signals,
+                           size_t num_signals, event_cb cb, void* data) {
+    sigset_t mask;
+    sigset_t before;
+    sigemptyset(&mask);
+    for (size_t i = 0; i < num_signals; i++) {
+        sigaddset(&mask, signals[i]);
+    }
+    if (sigprocmask(SIG_BLOCK, &mask, &before) < 0) {
+        return -1;
+    }
+    int fd = signalfd(-1, &mask, SFD_NONBLOCK | SFD_CLOEXEC);
+    if (fd < 0 || event_loop_add(loop, fd, EPOLLIN, cb, data) < 0) {
+        if (fd >= 0) {
+            close(fd);
+        }
+        sigprocmask(SIG_SETMASK, &before, NULL);
+        return -1;
+    }
+    if (!loop->masked) {
+        loop->old_mask = before;
+        loop->masked = 1;
+    }
+    loop->handlers[fd].owned = 1;
+    return fd;
+}
+
+/** Returns how many times a timer has fired since it was last read (0 if
+ * none), and rearms its readiness.
+ */
+uint64_t event_loop_timer_expirations(int fd) {
+    uint64_t expirations;
+    if (read(fd, &expirations, sizeof(expirations)) !=
+        (ssize_t)sizeof(expirations)) {
+        return 0;
+    }
+    return expirations;
+}
+
+/** Returns the next pending signal on a signal file descriptor, or 0 if
+ * there is none.
+ */
+int event_loop_next_signal(int fd) {
+    struct signalfd_siginfo info;
+    if (read(fd, &info, sizeof(info)) != (ssize_t)sizeof(info)) {
+        return 0;
+    }
+    return (int)info.ssi_signo;
+}
+
+/** Waits for and dispatches events until event_loop_stop() is called. The
+ * process sleeps in the kernel between events.
+ *
+ * Returns 0 once stopped, or -1 if waiting fails.
+ */
+int event_loop_run(event_loop_t* loop) {
+    struct epoll_event events[MAX_EVENTS];
+    loop->running = 1;
+    while (loop->running) {
+        int num = epoll_wait(loop->epfd, events, MAX_EVENTS, -1);
+        if (num < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        for (int i = 0; i < num && loop->running; i++) {
+            int fd = events[i].data.fd;
+            // an earlier handler may have removed this fd
+            if ((size_t)fd < loop->num_handlers && loop->handlers[fd].cb) {
+                loop->handlers[fd].cb(fd, events[i].events,
+                                      loop->handlers[fd].data);
+            }
+        }
+    }
+    return 0;
+}
+
+/** Makes event_loop_run() return once the current handler finishes.
+ */
+void event_loop_stop(event_loop_t* loop) { loop->running = 0; }
+
+#endif
@@ -0,0 +1,53 @@
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Called when a registered file descriptor is ready. `events` is the set of
+// epoll events that fired.
+typedef void (*event_cb)(int fd, uint32_t events, void* data);
+
+// What to call for one registered file descriptor. `owned` is set for the
+// timers and signal fds the loop created, which it closes itself.
+typedef struct event_handler {
+    event_cb cb;
+    void* data;
+    int owned;
+} event_handler_t;
+
+/** An epoll-based event loop.
+ * Fields:
+ *  - epfd: the epoll instance
+ *  - handlers: handler for each registered fd, indexed by fd
+ *  - num_handlers: length of `handlers`
+ *  - running: 1 while event_loop_run() should keep going
+ *  - old_mask: the signal mask before event_loop_add_signals() first
+ *    changed it, put back by event_loop_close()
+ *  - masked: 1 once `old_mask` has been saved
+ */
+typedef struct event_loop {
+    int epfd;
+    event_handler_t* handlers;
+    size_t num_handlers;
+    int running;
+    sigset_t old_mask;
+    int masked;
+} event_loop_t;
+
+int event_loop_init(event_loop_t* loop);
+void event_loop_close(event_loop_t* loop);
+int event_loop_add(event_loop_t* loop, int fd, uint32_t events, event_cb cb,
+                   void* data);
+int event_loop_remove(event_loop_t* loop, int fd);
+int event_loop_add_timer(event_loop_t* loop, long interval_ms, event_cb cb,
+                         void* data);
+int event_loop_add_signals(event_loop_t* loop, const int* signals,
+                           size_t num_signals, event_cb cb, void* data);
+uint64_t event_loop_timer_expirations(int fd);
+int event_loop_next_signal(int fd);
+int event_loop_run(event_loop_t* loop);
+void event_loop_stop(event_loop_t* loop);
+
+#endif
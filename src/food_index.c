@@ -0,0 +1,186 @@
+#include "food_index.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "common.h"
+
+int g_food_count = 1;
+_Thread_local food_index_t* g_food_index;
+
+// the index games on this thread use when the caller hasn't set one
+static _Thread_local food_index_t g_own_index;
+
+/** Picks the index the next game on this thread keeps up to date: its own
+ * index when more than one food item is kept and the caller hasn't set
+ * g_food_index, since finding food among several items is then worth an
+ * index (see food_index_nearest()), and none once back to one item. The
+ * chosen index still has to be initialized for the board. Called by
+ * initialize_game(), multi_init() and set_food_count().
+ */
+void food_index_select(void) {
+    if (g_food_index == &g_own_index && g_own_index.buckets != NULL) {
+        food_index_free(&g_own_index);  // left by a game never torn down
+    }
+    if (g_food_index == NULL && g_food_count > 1) {
+        g_food_index = &g_own_index;
+    } else if (g_food_index == &g_own_index && g_food_count <= 1) {
+        g_food_index = NULL;
+    }
+}
+
+/** Initializes an empty index for a board of the given size.
+ */
+void food_index_init(food_index_t* index, size_t width, size_t height) {
+    index->width = width;
+    index->height = height;
+    index->buckets_x = (width + FOOD_BUCKET - 1) >> FOOD_BUCKET_SHIFT;
+    index->buckets_y = (height + FOOD_BUCKET - 1) >> FOOD_BUCKET_SHIFT;
+    index->buckets =
+        calloc(index->buckets_x * index->buckets_y, sizeof(food_bucket_t));
+    index->count = 0;
+}
+
+/** Frees the index's buckets.
+ */
+void food_index_free(food_index_t* index) {
+    for (size_t i = 0; i < index->buckets_x * index->buckets_y; i++) {
+        free(index->buckets[i].positions);
+    }
+    free(index->buckets);
+    memset(index, 0, sizeof(*index));
+}
+
+/* Returns the bucket holding cell (row, col).
+ */
+static food_bucket_t* bucket_at(food_index_t* index, size_t row, size_t col) {
+    return &index->buckets[(row >> FOOD_BUCKET_SHIFT) * index->buckets_x +
+                           (col >> FOOD_BUCKET_SHIFT)];
+}
+
+/** Records food at cell position `pos`.
+ */
+void food_index_add(food_index_t* index, size_t pos) {
+    food_bucket_t* bucket = bucket_at(index, cell_row(pos, index->width),
+                                      cell_col(pos, index->width));
+    if (bucket->len == bucket->cap) {
+        bucket->cap = bucket->cap ? bucket->cap * 2 : 4;
+        bucket->positions =
+            realloc(bucket->positions, bucket->cap * sizeof(size_t));
+    }
+    bucket->positions[bucket->len++] = pos;
+    index->count++;
+}
+
+/** Forgets the food at cell position `pos`, if any.
+ */
+void food_index_remove(food_index_t* index, size_t pos) {
+    food_bucket_t* bucket = bucket_at(index, cell_row(pos, index->width),
+                                      cell_col(pos, index->width));
+    for (size_t i = 0; i < bucket->len; i++) {
+        if (bucket->positions[i] == pos) {
+            bucket->positions[i] = bucket->positions[--bucket->len];
+            index->count--;
+            return;
+        }
+    }
+}
+
+/** Returns the number of food items in the rectangle from (row0, col0) to
+ * (row1, col1), inclusive. Buckets entirely inside the rectangle are counted
+ * without looking at their items.
+ */
+size_t food_index_count_in(food_index_t* index, size_t row0, size_t col0,
+                           size_t row1, size_t col1) {
+    if (row1 >= index->height) {
+        row1 = index->height - 1;
+    }
+    if (col1 >= index->width) {
+        col1 = index->width - 1;
+    }
+    if (row0 > row1 || col0 > col1) {
+        return 0;
+    }
+
+    size_t total = 0;
+    for (size_t by = row0 >> FOOD_BUCKET_SHIFT; by <= row1 >> FOOD_BUCKET_SHIFT;
+         by++) {
+        for (size_t bx = col0 >> FOOD_BUCKET_SHIFT;
+             bx <= col1 >> FOOD_BUCKET_SHIFT; bx++) {
+            food_bucket_t* bucket = &index->buckets[by * index->buckets_x + bx];
+            size_t top = by << FOOD_BUCKET_SHIFT;
+            size_t left = bx << FOOD_BUCKET_SHIFT;
+            if (top >= row0 && top + FOOD_BUCKET - 1 <= row1 && left >= col0 &&
+                left + FOOD_BUCKET - 1 <= col1) {
+                total += bucket->len;
+                continue;
+            }
+            for (size_t i = 0; i < bucket->len; i++) {
+                size_t row = cell_row(bucket->positions[i], index->width);
+                size_t col = cell_col(bucket->positions[i], index->width);
+                total += row >= row0 && row <= row1 && col >= col0 && col <= col1;
+            }
+        }
+    }
+    return total;
+}
+
+/* Manhattan distance between two cells.
+ */
+static size_t distance(size_t row_a, size_t col_a, size_t row_b, size_t col_b) {
+    size_t dr = row_a > row_b ? row_a - row_b : row_b - row_a;
+    size_t dc = col_a > col_b ? col_a - col_b : col_b - col_a;
+    return dr + dc;
+}
+
+/** Finds the food closest (by Manhattan distance) to cell position `pos`.
+ * Searches rings of buckets outward from `pos` and stops as soon as no
+ * unsearched bucket can hold anything closer.
+ *
+ * Returns 1 and sets *nearest_p if there is any food, 0 otherwise.
+ */
+int food_index_nearest(food_index_t* index, size_t pos, size_t* nearest_p) {
+    if (index->count == 0) {
+        return 0;
+    }
+    size_t row = cell_row(pos, index->width);
+    size_t col = cell_col(pos, index->width);
+    long by = row >> FOOD_BUCKET_SHIFT;
+    long bx = col >> FOOD_BUCKET_SHIFT;
+    long max_ring = (long)(index->buckets_x > index->buckets_y
+                               ? index->buckets_x
+                               : index->buckets_y);
+
+    size_t best = (size_t)-1;
+    for (long ring = 0; ring <= max_ring; ring++) {
+        for (long y = by - ring; y <= by + ring; y++) {
+            if (y < 0 || y >= (long)index->buckets_y) {
+                continue;
+            }
+            // inner rows of the ring only have their two end buckets
+            long step = (y == by - ring || y == by + ring) ? 1 : 2 * ring;
+            for (long x = bx - ring; x <= bx + ring; x += step) {
+                if (x < 0 || x >= (long)index->buckets_x) {
+                    continue;
+                }
+                food_bucket_t* bucket =
+                    &index->buckets[y * index->buckets_x + x];
+                for (size_t i = 0; i < bucket->len; i++) {
+                    size_t d = distance(
+                        row, col, cell_row(bucket->positions[i], index->width),
+                        cell_col(bucket->positions[i], index->width));
+                    if (d < best) {
+                        best = d;
+                        *nearest_p = bucket->positions[i];
+                    }
+                }
+            }
+        }
+        // every cell in ring + 1 is more than ring buckets away
+        if (best <= (size_t)ring * FOOD_BUCKET) {
+            break;
+        }
+    }
+    return 1;
+}
@@ -0,0 +1,54 @@
+#ifndef FOOD_INDEX_H
+#define FOOD_INDEX_H
+
+#include <stddef.h>
+
+// Food is bucketed into FOOD_BUCKET x FOOD_BUCKET squares of cells.
+#define FOOD_BUCKET_SHIFT 4
+#define FOOD_BUCKET (1 << FOOD_BUCKET_SHIFT)
+
+// The food items in one bucket.
+typedef struct food_bucket {
+    size_t* positions;
+    size_t len;
+    size_t cap;
+} food_bucket_t;
+
+/** Spatial index of the food on a board, kept up to date by place_food()
+ * and update() while g_food_index points at it.
+ * Fields:
+ *  - width, height: board dimensions
+ *  - buckets_x, buckets_y: number of buckets across and down
+ *  - buckets: buckets_x * buckets_y buckets, row-major
+ *  - count: total number of food items
+ */
+typedef struct food_index {
+    size_t width;
+    size_t height;
+    size_t buckets_x;
+    size_t buckets_y;
+    food_bucket_t* buckets;
+    size_t count;
+} food_index_t;
+
+/** Global food settings.
+ *  - g_food_count: number of food items kept on the board. Defaults to 1.
+ *  - g_food_index: index that games keep up to date, or NULL for none.
+ *    initialize_game() (re)initializes it for the new board and teardown()
+ *    frees its contents. With more than one food item, initialize_game()
+ *    and multi_init() set up an index of their own if none is set (see
+ *    food_index_select()).
+ */
+extern int g_food_count;
+extern _Thread_local food_index_t* g_food_index;
+
+void food_index_select(void);
+void food_index_init(food_index_t* index, size_t width, size_t height);
+void food_index_free(food_index_t* index);
+void food_index_add(food_index_t* index, size_t pos);
+void food_index_remove(food_index_t* index, size_t pos);
+size_t food_index_count_in(food_index_t* index, size_t row0, size_t col0,
+                           size_t row1, size_t col1);
+int food_index_nearest(food_index_t* index, size_t pos, size_t* nearest_p);
+
+#endif
@@ -5,9 +5,42 @@
 
 #include "common.h"
 
+// Signature shared by update() and its specialized variants.
+typedef void (*update_fn)(int* cells, size_t width, size_t height,
+                          snake_t* snake_p, enum input_key input, int growing);
+
+/** How update()'s rules reach a board that isn't a dense cells array (see
+ * tiled_board.c), so every kind of board plays by the same rules. `board`
+ * is the accessor's own state; positions are whatever it uses for cells.
+ * Fields:
+ *  - get, set: read and write a cell's flags; set() also tells whatever
+ *    hooks the board keeps (Zobrist hash and so on) about the change
+ *  - step: the position one step from `pos` in direction `dir`
+ *  - place_food: places one food item
+ *  - food_eaten: called after the food at `pos` is eaten, or NULL
+ *  - end_tick: called at the end of every tick, or NULL
+ */
+typedef struct cell_access {
+    int (*get)(void* board, size_t pos);
+    void (*set)(void* board, size_t pos, int value);
+    size_t (*step)(void* board, size_t pos, enum direction dir);
+    void (*place_food)(void* board);
+    void (*food_eaten)(void* board, size_t pos);
+    void (*end_tick)(void* board, snake_t* snake_p, enum direction dir,
+                     int score, int game_over);
+} cell_access_t;
+
 void read_name(char* write_into);
+update_fn select_update(int* cells, size_t width, size_t height, int growing);
 void update(int* cells, size_t width, size_t height, snake_t* snake_p,
             enum input_key input, int growing);
+size_t pack_inputs(const enum input_key* inputs, size_t num_inputs,
+                   enum direction start_dir, unsigned char* packed);
+size_t update_batch(int* cells, size_t width, size_t height, snake_t* snake_p,
+                    const unsigned char* packed, size_t num_steps,
+                    int growing);
+void update_on(const cell_access_t* access, void* board, snake_t* snake_p,
+               enum input_key input, int growing);
 void place_food(int* cells, size_t width, size_t height);
 void teardown(int* cells, snake_t* snake_p);
 
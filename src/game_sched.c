@@ -0,0 +1,291 @@
+#include "game_sched.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "arena.h"
+#include "board_cache.h"
+#include "common.h"
+#include "delta.h"
+#include "food_index.h"
+#include "game.h"
+#include "game_setup.h"
+#include "zobrist.h"
+
+// Stackless coroutines: a coroutine is a function that switches on
+// task->resume to jump back to where it last yielded. Locals don't survive
+// a yield, so everything a task needs across ticks lives in the task.
+#define TASK_BEGIN(task) switch ((task)->resume) { case 0:
+// Suspends the task for `ms` milliseconds past its last deadline.
+#define TASK_SLEEP(task, ms)         \
+    do {                             \
+        (task)->resume = __LINE__;   \
+        (task)->deadline += (ms);    \
+        return 0;                    \
+        case __LINE__:;              \
+    } while (0)
+#define TASK_END(task) \
+    }                  \
+    return 1
+
+// The globals a game reads and writes during a tick. Each task has its own
+// score and game over flag; the others track a single game (or, for
+// g_arena, would be reset by a task's teardown()), so tasks run without
+// them.
+typedef struct saved_globals {
+    int game_over;
+    int score;
+    arena_t* arena;
+    food_index_t* food_index;
+    zobrist_t* zobrist;
+    delta_writer_t* delta;
+} saved_globals_t;
+
+/* Saves the thread's game globals and switches them to the task's game.
+ */
+static void enter_task(game_task_t* task, saved_globals_t* saved) {
+    saved->game_over = g_game_over;
+    saved->score = g_score;
+    saved->arena = g_arena;
+    saved->food_index = g_food_index;
+    saved->zobrist = g_zobrist;
+    saved->delta = g_delta;
+    g_game_over = task->game_over;
+    g_score = task->score;
+    g_arena = NULL;
+    g_food_index = NULL;
+    g_zobrist = NULL;
+    g_delta = NULL;
+}
+
+/* Stores the task's game state back and restores the thread's globals.
+ */
+static void leave_task(game_task_t* task, const saved_globals_t* saved) {
+    task->game_over = g_game_over;
+    task->score = g_score;
+    g_game_over = saved->game_over;
+    g_score = saved->score;
+    g_arena = saved->arena;
+    g_food_index = saved->food_index;
+    g_zobrist = saved->zobrist;
+    g_delta = saved->delta;
+}
+
+/* A game's life: sleep until the next tick, apply the latest key, update,
+   publish; until the game ends or is cancelled. Returns 1 once the task is
+   finished and 0 when it is waiting for its next tick.
+*/
+static int task_body(game_task_t* task) {
+    TASK_BEGIN(task);
+    while (!task->game_over) {
+        TASK_SLEEP(task, task->interval_ms);
+        if (task->cancelled) {
+            break;
+        }
+        saved_globals_t saved;
+        enter_task(task, &saved);
+        task->step(task->cells, task->width, task->height, &task->snake,
+                   task->next_input, task->growing);
+        leave_task(task, &saved);
+        task->next_input = INPUT_NONE;
+        if (task->publish != NULL) {
+            task->publish(task, task->data);
+        }
+    }
+    TASK_END(task);
+}
+
+/* Frees a task and its game.
+ */
+static void free_task(game_task_t* task) {
+    saved_globals_t saved;
+    enter_task(task, &saved);
+    teardown(task->cells, &task->snake);
+    leave_task(task, &saved);
+    free(task);
+}
+
+/* Puts a task in the wheel slot of its deadline.
+ */
+static void wheel_insert(game_sched_t* sched, game_task_t* task) {
+    game_task_t** slot = &sched->wheel[task->deadline % SCHED_WHEEL_SLOTS];
+    task->next = *slot;
+    *slot = task;
+}
+
+/** Initializes an empty scheduler whose clock reads `now_ms`.
+ */
+void game_sched_init(game_sched_t* sched, uint64_t now_ms) {
+    memset(sched, 0, sizeof(*sched));
+    sched->now = now_ms;
+    board_cache_init(&sched->cache, 0);
+}
+
+/** Frees every task still in the scheduler, without publishing, and the
+ * scheduler's boards.
+ */
+void game_sched_free(game_sched_t* sched) {
+    for (size_t i = 0; i < SCHED_WHEEL_SLOTS; i++) {
+        game_task_t* task = sched->wheel[i];
+        while (task != NULL) {
+            game_task_t* next = task->next;
+            free_task(task);
+            task = next;
+        }
+        sched->wheel[i] = NULL;
+    }
+    sched->num_tasks = 0;
+    board_cache_free(&sched->cache);
+}
+
+/** Starts a new game whose first tick is `interval_ms` from now.
+ *
+ * Returns the task, or NULL if the board did not decode (its status is
+ * written to *status_p if that isn't NULL) or there was no memory.
+ *
+ * Arguments:
+ *  - sched: the scheduler to run the game on.
+ *  - board_rep: the board string, or NULL for the default board. Boards are
+ *    decoded once per scheduler and cloned for each game.
+ *  - growing: 1 if the snake grows on eating, 0 otherwise.
+ *  - interval_ms: time between ticks, at least 1.
+ *  - publish, data: called after each tick, for example to send the board
+ *    to the player. May be NULL.
+ */
+game_task_t* game_sched_spawn(game_sched_t* sched, char* board_rep,
+                              int growing, unsigned interval_ms,
+                              game_task_cb publish, void* data,
+                              enum board_init_status* status_p) {
+    game_task_t* task = calloc(1, sizeof(game_task_t));
+    if (task == NULL) {
+        return NULL;
+    }
+    saved_globals_t saved;
+    enter_task(task, &saved);
+    enum board_init_status status = board_cache_initialize_game(
+        &sched->cache, &task->cells, &task->width, &task->height, &task->snake,
+        board_rep);
+    leave_task(task, &saved);
+    if (status_p != NULL) {
+        *status_p = status;
+    }
+    if (status != INIT_SUCCESS) {
+        free(task);
+        return NULL;
+    }
+    task->step =
+        select_update(task->cells, task->width, task->height, growing);
+    task->growing = growing;
+    task->interval_ms = interval_ms > 0 ? interval_ms : 1;
+    task->next_input = INPUT_NONE;
+    task->publish = publish;
+    task->data = data;
+    task->deadline = sched->now;
+    // runs up to the first sleep
+    task_body(task);
+    wheel_insert(sched, task);
+    sched->num_tasks++;
+    return task;
+}
+
+/** Records a key for the task's next tick. Only the latest key since the
+ * last tick is kept, as in the single-game loop.
+ */
+void game_task_input(game_task_t* task, enum input_key input) {
+    if (input != INPUT_NONE) {
+        task->next_input = input;
+    }
+}
+
+/** Ends a game, for example because its player left. The task is freed at
+ * its next deadline without ticking or publishing again, so it must not be
+ * used after this.
+ */
+void game_task_cancel(game_task_t* task) {
+    task->cancelled = 1;
+}
+
+/** Advances the scheduler's clock to `now_ms` and ticks every task that is
+ * due, each once: ticks a task missed while the scheduler wasn't advanced
+ * collapse into one, and the task keeps its cadence afterwards.
+ *
+ * Returns the number of ticks run.
+ */
+size_t game_sched_advance(game_sched_t* sched, uint64_t now_ms) {
+    if (now_ms <= sched->now) {
+        return 0;
+    }
+    // each slot holds every deadline that falls on it, so one turn of the
+    // wheel is enough however far the clock moved
+    uint64_t from = sched->now + 1;
+    if (now_ms - sched->now > SCHED_WHEEL_SLOTS) {
+        from = now_ms - SCHED_WHEEL_SLOTS + 1;
+    }
+    sched->now = now_ms;
+
+    size_t ticks = 0;
+    for (uint64_t t = from; t <= now_ms; t++) {
+        game_task_t** slot = &sched->wheel[t % SCHED_WHEEL_SLOTS];
+        game_task_t* task = *slot;
+        *slot = NULL;
+        while (task != NULL) {
+            game_task_t* next = task->next;
+            if (task->deadline > now_ms) {
+                // due on a later turn of the wheel
+                task->next = *slot;
+                *slot = task;
+            } else if (task_body(task)) {
+                ticks += !task->cancelled;
+                free_task(task);
+                sched->num_tasks--;
+            } else {
+                ticks++;
+                if (task->deadline <= now_ms) {
+                    uint64_t behind = now_ms - task->deadline;
+                    task->deadline +=
+                        (behind / task->interval_ms + 1) * task->interval_ms;
+                }
+                wheel_insert(sched, task);
+            }
+            task = next;
+        }
+    }
+    return ticks;
+}
+
+/** Returns the number of milliseconds until the next task is due, to sleep
+ * or poll for, or -1 if there are no tasks.
+ */
+long game_sched_timeout(const game_sched_t* sched) {
+    if (sched->num_tasks == 0) {
+        return -1;
+    }
+    // walk the next turn of the wheel in time order; a task due in that
+    // turn is in the slot of its deadline, so the first one found is the
+    // earliest. Otherwise every task is further off and the nearest wins.
+    uint64_t next = UINT64_MAX;
+    for (uint64_t d = 1; d <= SCHED_WHEEL_SLOTS; d++) {
+        for (game_task_t* task =
+                 sched->wheel[(sched->now + d) % SCHED_WHEEL_SLOTS];
+             task != NULL; task = task->next) {
+            if (task->deadline <= sched->now + d) {
+                return (long)d;
+            }
+            if (task->deadline < next) {
+                next = task->deadline;
+            }
+        }
+    }
+    return (long)(next - sched->now);
+}
+
+/** Returns the monotonic clock in milliseconds, for game_sched_advance().
+ */
+uint64_t game_sched_clock(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
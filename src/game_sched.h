@@ -0,0 +1,86 @@
+#ifndef GAME_SCHED_H
+#define GAME_SCHED_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "board_cache.h"
+#include "common.h"
+#include "game.h"
+#include "game_setup.h"
+
+// Timer wheel size, one slot per millisecond. Deadlines further away than
+// one turn of the wheel wait in their slot for the extra turns.
+#define SCHED_WHEEL_SLOTS 1024
+
+typedef struct game_task game_task_t;
+
+// Called after each of a task's ticks. On the last one task->game_over is
+// set, and the task is freed once this returns.
+typedef void (*game_task_cb)(game_task_t* task, void* data);
+
+/** One game, run as a stackless coroutine by a game_sched_t. Between ticks
+ * a game is just this struct, its board and its snake, so a thread can hold
+ * many thousands of them.
+ * Fields:
+ *  - resume: where the coroutine continues when resumed, 0 at the start
+ *  - deadline: scheduler time (ms) of the next tick
+ *  - next: next task in the same timer wheel slot
+ *  - cells, width, height, snake: the game
+ *  - growing: 1 if the snake grows on eating, 0 otherwise
+ *  - step: the update function, from select_update()
+ *  - score, game_over: the game's values of g_score and g_game_over
+ *  - interval_ms: time between ticks
+ *  - next_input: latest key since the last tick
+ *  - cancelled: set by game_task_cancel()
+ *  - publish, data: called after each tick
+ */
+struct game_task {
+    int resume;
+    uint64_t deadline;
+    game_task_t* next;
+    int* cells;
+    size_t width;
+    size_t height;
+    snake_t snake;
+    int growing;
+    update_fn step;
+    int score;
+    int game_over;
+    unsigned interval_ms;
+    enum input_key next_input;
+    int cancelled;
+    game_task_cb publish;
+    void* data;
+};
+
+/** Runs many games on one thread, each ticking at its own interval. The
+ * tasks waiting for their next tick sit in a timer wheel, and
+ * game_sched_advance() resumes the ones that are due. A scheduler and its
+ * tasks belong to one thread; for more cores, run one scheduler per thread.
+ * Fields:
+ *  - now: scheduler time (ms) of the last advance
+ *  - wheel: tasks by deadline modulo SCHED_WHEEL_SLOTS
+ *  - num_tasks: number of live tasks
+ *  - cache: the boards that tasks are started from
+ */
+typedef struct game_sched {
+    uint64_t now;
+    game_task_t* wheel[SCHED_WHEEL_SLOTS];
+    size_t num_tasks;
+    board_cache_t cache;
+} game_sched_t;
+
+void game_sched_init(game_sched_t* sched, uint64_t now_ms);
+void game_sched_free(game_sched_t* sched);
+game_task_t* game_sched_spawn(game_sched_t* sched, char* board_rep,
+                              int growing, unsigned interval_ms,
+                              game_task_cb publish, void* data,
+                              enum board_init_status* status_p);
+void game_task_input(game_task_t* task, enum input_key input);
+void game_task_cancel(game_task_t* task);
+size_t game_sched_advance(game_sched_t* sched, uint64_t now_ms);
+long game_sched_timeout(const game_sched_t* sched);
+uint64_t game_sched_clock(void);
+
+#endif
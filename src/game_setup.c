@@ -1,12 +1,16 @@
 #include "game_setup.h"
 
+#include <limits.h>
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 #include "common.h"
+#include "food_index.h"
 #include "game.h"
+#include "parallel_decode.h"
 
 // Some handy macros for decompression
 #define E_CAP_HEX 0x45
@@ -39,42 +43,83 @@ enum board_init_status initialize_default_board(int** cells_p, size_t* width_p,
                                                 size_t* height_p) {
     *width_p = 20;
     *height_p = 10;
-    int* cells = malloc(20 * 10 * sizeof(int));
+    int* cells = game_alloc(cell_count(20, 10) * sizeof(int));
     *cells_p = cells;
-    for (int i = 0; i < 20 * 10; i++) {
-        cells[i] = PLAIN_CELL;
+    // padding cells outside the board (blocked layout only) count as walls
+    for (size_t i = 0; i < cell_count(20, 10); i++) {
+        cells[i] = FLAG_WALL;
+    }
+    for (int row = 0; row < 10; row++) {
+        for (int col = 0; col < 20; col++) {
+            cells[cell_index(row, col, 20)] = PLAIN_CELL;
+        }
     }
 
     // Set edge cells!
     // Top and bottom edges:
     for (int i = 0; i < 20; ++i) {
-        cells[i] = FLAG_WALL;
-        cells[i + (20 * (10 - 1))] = FLAG_WALL;
+        cells[cell_index(0, i, 20)] = FLAG_WALL;
+        cells[cell_index(10 - 1, i, 20)] = FLAG_WALL;
     }
     // Left and right edges:
     for (int i = 0; i < 10; ++i) {
-        cells[i * 20] = FLAG_WALL;
-        cells[i * 20 + 20 - 1] = FLAG_WALL;
+        cells[cell_index(i, 0, 20)] = FLAG_WALL;
+        cells[cell_index(i, 20 - 1, 20)] = FLAG_WALL;
     }
 
     // Set grass cells!
     // Top and bottom edges:
     for (int i = 1; i < 19; ++i) {
-        cells[i + 20] = FLAG_GRASS;
-        cells[i + (20 * (9 - 1))] = FLAG_GRASS;
+        cells[cell_index(1, i, 20)] = FLAG_GRASS;
+        cells[cell_index(9 - 1, i, 20)] = FLAG_GRASS;
     }
     // Left and right edges:
     for (int i = 1; i < 9; ++i) {
-        cells[i * 20 + 1] = FLAG_GRASS;
-        cells[i * 20 + 19 - 1] = FLAG_GRASS;
+        cells[cell_index(i, 1, 20)] = FLAG_GRASS;
+        cells[cell_index(i, 19 - 1, 20)] = FLAG_GRASS;
     }
 
     // Add snake
-    cells[20 * 2 + 2] = FLAG_SNAKE;
+    cells[cell_index(2, 2, 20)] = FLAG_SNAKE;
 
     return INIT_SUCCESS;
 }
 
+/** Sets what happens at the edges of a decoded board: the ring of sentinel
+ * cells around it becomes walls (EDGE_OPEN, which is how every board starts)
+ * or jumps to the opposite edge (EDGE_WRAP). Border walls on the board
+ * itself are unaffected, so wrapping only shows on boards without them.
+ *
+ * Returns 0 on success, or -1 if the cell layout has no ring (only
+ * `make LAYOUT=padded` does) or, for EDGE_WRAP, the board is too big for
+ * the jumps to fit in a cell.
+ */
+int set_board_edges(int* cells, size_t width, size_t height,
+                    enum edge_mode mode) {
+#ifdef CELL_LAYOUT_PADDED
+    // the longest jump is from the top ring to the bottom row
+    size_t longest = height * (width + 2);
+    if (mode == EDGE_WRAP && longest > (size_t)INT_MAX >> CELL_JUMP_SHIFT) {
+        return -1;
+    }
+    int down = mode == EDGE_WRAP ? (int)longest << CELL_JUMP_SHIFT : FLAG_WALL;
+    int across = mode == EDGE_WRAP ? (int)width << CELL_JUMP_SHIFT : FLAG_WALL;
+    for (size_t col = 0; col < width; col++) {
+        cells[cell_index((size_t)-1, col, width)] = down;
+        cells[cell_index(height, col, width)] =
+            mode == EDGE_WRAP ? -down : FLAG_WALL;
+    }
+    for (size_t row = 0; row < height; row++) {
+        cells[cell_index(row, (size_t)-1, width)] = across;
+        cells[cell_index(row, width, width)] =
+            mode == EDGE_WRAP ? -across : FLAG_WALL;
+    }
+    return 0;
+#else
+    return mode == EDGE_OPEN ? 0 : -1;
+#endif
+}
+
 /** Initialize variables relevant to the game board.
  * Arguments:
  *  - cells_p: a pointer to a memory location where a pointer to the first
@@ -85,7 +130,8 @@ enum board_init_status initialize_default_board(int** cells_p, size_t* width_p,
  *              height should be stored.
  *  - snake_p: a pointer to your snake struct (not used until part 3!)
  *  - board_rep: a string representing the initial board. May be NULL for
- * default board.
+ * default board. Strings of PARALLEL_DECODE_MIN_LEN bytes or more are
+ * decoded by parallel_decompress_board_str().
  */
 enum board_init_status initialize_game(int** cells_p, size_t* width_p,
                                        size_t* height_p, snake_t* snake_p,
@@ -96,26 +142,121 @@ enum board_init_status initialize_game(int** cells_p, size_t* width_p,
         status = initialize_default_board(cells_p, width_p, height_p);
 
         // initialize snake data
-        int init_pos = 42;
-        snake_p->snake_pos = NULL;
-        insert_first(&(snake_p->snake_pos), &init_pos, sizeof(int));
+        int init_pos = cell_index(2, 2, 20);
+        snake_body_init(&snake_p->snake_pos);
+        snake_body_push_head(&snake_p->snake_pos, RIGHT, init_pos);
     } else {
         //create user-inputted board w/ custom snake position
-        snake_p->snake_pos = NULL;
-        status = decompress_board_str(cells_p, width_p, height_p, snake_p,
-                                      board_rep);
+        snake_body_init(&snake_p->snake_pos);
+        if (strlen(board_rep) >= PARALLEL_DECODE_MIN_LEN) {
+            status = parallel_decompress_board_str(
+                cells_p, width_p, height_p, snake_p, board_rep, 0);
+        } else {
+            status = decompress_board_str(cells_p, width_p, height_p,
+                                          snake_p, board_rep);
+        }
     }
     //continue setup if custom board is valid
     if (status == INIT_SUCCESS) {
-        place_food(*cells_p, *width_p, *height_p);
-        g_game_over = 0;
-        g_score = 0;
-        snake_p->snake_dir = RIGHT;
+        food_index_select();
+        start_game(*cells_p, *width_p, *height_p, snake_p);
     }
 
     return status;
 }
 
+/** Returns the number of cells of a board that food can be placed on, or
+ * `limit` if there are at least that many: counting stops there, so asking
+ * whether a board has room for a few food items is cheap.
+ */
+size_t count_free_cells(const int* cells, size_t width, size_t height,
+                        size_t limit) {
+    size_t free_cells = 0;
+    for (size_t row = 0; row < height && free_cells < limit; row++) {
+        for (size_t col = 0; col < width && free_cells < limit; col++) {
+            int cell = cells[cell_index(row, col, width)];
+            free_cells += cell == PLAIN_CELL || cell == FLAG_GRASS;
+        }
+    }
+    return free_cells;
+}
+
+/** Places the g_food_count food items a game starts with, but never more
+ * than `free_cells` (from count_free_cells()): placing food on a full board
+ * would never finish.
+ */
+void place_start_food(int* cells, size_t width, size_t height,
+                      size_t free_cells) {
+    for (int i = 0; i < g_food_count && (size_t)i < free_cells; i++) {
+        place_food(cells, width, height);
+    }
+}
+
+/** start_game() for a board whose free cells have already been counted
+ * (see count_free_cells()), such as a clone of a cached board.
+ */
+void start_counted_game(int* cells, size_t width, size_t height,
+                        snake_t* snake_p, size_t free_cells) {
+    if (g_food_index != NULL) {
+        food_index_init(g_food_index, width, height);
+    }
+
+    place_start_food(cells, width, height, free_cells);
+
+    g_game_over = 0;
+    g_score = 0;
+    snake_p->snake_dir = RIGHT;
+}
+
+/** Gets a freshly decoded board ready to play: sets up g_food_index (if
+ * any), places g_food_count food items and resets the game status. Only
+ * as many free cells as there is food are looked for, so with one food
+ * item this usually looks at a handful of cells.
+ * Arguments:
+ *  - cells: a pointer to the first integer in an array of integers
+ *           representing each board cell.
+ *  - width: the width of the board.
+ *  - height: the height of the board.
+ *  - snake_p: a pointer to your snake struct.
+ */
+void start_game(int* cells, size_t width, size_t height, snake_t* snake_p) {
+    size_t food = g_food_count > 0 ? (size_t)g_food_count : 0;
+    start_counted_game(cells, width, height, snake_p,
+                       count_free_cells(cells, width, height, food));
+}
+
+/** Makes a game that has just started keep `count` food items instead:
+ * sets g_food_count, tops up the food already on the board (never past the
+ * free cells) and switches g_food_index on or off to match, indexing the
+ * food placed so far (see food_index_select()).
+ */
+void set_food_count(int* cells, size_t width, size_t height, int count) {
+    g_food_count = count;
+    food_index_select();
+    if (g_food_index != NULL) {
+        food_index_init(g_food_index, width, height);
+    }
+    size_t have = 0;
+    for (size_t row = 0; row < height; row++) {
+        for (size_t col = 0; col < width; col++) {
+            size_t pos = cell_index(row, col, width);
+            if (cells[pos] & FLAG_FOOD) {
+                have++;
+                if (g_food_index != NULL) {
+                    food_index_add(g_food_index, pos);
+                }
+            }
+        }
+    }
+    size_t want = count > 0 ? (size_t)count : 0;
+    if (have < want) {
+        size_t free_cells = count_free_cells(cells, width, height, want - have);
+        for (size_t i = 0; i < want - have && i < free_cells; i++) {
+            place_food(cells, width, height);
+        }
+    }
+}
+
 /* Takes in a char * representing a string, a pointer to a char* (which is
    empty) and a delimiter. Uses strtok to parse string and store resulting
    tokens in tokens. Returns the number of tokens-1, which represents the number
@@ -164,7 +305,7 @@ int check_row_char(char c) {
 /* Calculates cells_pos number based on current row and column number
  */
 int cells_pos(int row_num, int col_num, int width) {
-    return ((row_num * width) + col_num);
+    return cell_index(row_num, col_num, width);
 }
 
 /*Returns 1 if inputted char c represents a digit; otherwise, returns 0
@@ -187,53 +328,60 @@ int is_a_let(char c) {
     }
     return 0;
 }
-/* Takes in cells pointer and fills a range of cells with given flag
+/* Takes in cells pointer and fills a run of cells in one row with given flag
     Arguments:
         -cells_p: pointer to the pointer representing cells array
-        -start_pos: the first cell needing to be filled
+        -row_num: the row of the run
+        -col_num: the column of the first cell needing to be filled
+        -width: the width of the board
         -num_cells: the number of cells to fill
         -flag: the flag to set each cell to
 
 */
-void fill_cells(int** cells_p, int start_pos, int num_cells, int flag) {
+void fill_cells(int** cells_p, int row_num, int col_num, int width,
+                int num_cells, int flag) {
     int* cells = *cells_p;
     for (int i = 0; i < num_cells; i++) {
-        cells[start_pos + i] = flag;
+        cells[cells_pos(row_num, col_num + i, width)] = flag;
     }
 }
 
-/** Takes in a string `compressed` and initializes values pointed to by
- * cells_p, width_p, and height_p accordingly. Arguments:
- *      - cells_p: a pointer to the pointer representing the cells array
- *                 that we would like to initialize.
- *      - width_p: a pointer to the width variable we'd like to initialize.
- *      - height_p: a pointer to the height variable we'd like to initialize.
- *      - snake_p: a pointer to your snake struct (not used until part 3!)
- *      - compressed: a string that contains the representation of the board.
- * Note: We assume that the string will be of the following form:
- * B24x80|E5W2E73|E5W2S1E72... To read it, we scan the string row-by-row
- * (delineated by the `|` character), and read out a letter (E, S or W) a number
- * of times dictated by the number that follows the letter.
- */
-enum board_init_status decompress_board_str(int** cells_p, size_t* width_p,
-                                            size_t* height_p, snake_t* snake_p,
-                                            char* compressed) {
-    // stores rows after parsing
-    char* rows[2048];
-    // stores dimension data after parsing
-    char* dimensions[3];
+/* Body of decompress_board_str(), with `rows` big enough to hold every token
+   of `compressed`.
+*/
+static enum board_init_status decompress_rows(int** cells_p, size_t* width_p,
+                                              size_t* height_p,
+                                              snake_t* snake_p,
+                                              char* compressed, char** rows) {
+    // stores dimension data after parsing; missing dimensions read as 0
+    char* dimensions[3] = {NULL, NULL, NULL};
     // parsing rows
     char* delim1 = "|";
     // for parsing dimensions
     char* delim2 = "Bx";
     size_t num_rows = parse(compressed, rows, delim1);
-    // parse to store dimensions
-    parse(rows[0], dimensions, delim2);
-    *height_p = atoi(dimensions[0]);
-    *width_p = atoi(dimensions[1]);
+    // parse to store dimensions; tokens after the first three are ignored
+    char* token = rows[0] != NULL ? strtok(rows[0], delim2) : NULL;
+    for (int i = 0; i < 3 && token != NULL; i++) {
+        dimensions[i] = token;
+        token = strtok(NULL, delim2);
+    }
+    *height_p = dimensions[0] ? atoi(dimensions[0]) : 0;
+    *width_p = dimensions[1] ? atoi(dimensions[1]) : 0;
 
-    int* cells = malloc(*height_p * *width_p * sizeof(int));
+    // a board whose rows don't match its height, or with a negative width,
+    // fails below; don't size its cells array from garbage dimensions
+    size_t num_cells_total = num_rows == *height_p && (int)*width_p >= 0
+                                 ? cell_count(*width_p, *height_p)
+                                 : 0;
+    int* cells = game_alloc(num_cells_total * sizeof(int));
     *cells_p = cells;
+    // padding cells outside the board (blocked layout only) count as walls
+    if (num_cells_total != *width_p * *height_p) {
+        for (size_t i = 0; i < num_cells_total; i++) {
+            cells[i] = FLAG_WALL;
+        }
+    }
     int curr_flag = -1;
     int check_snake = 0;
 
@@ -246,10 +394,11 @@ enum board_init_status decompress_board_str(int** cells_p, size_t* width_p,
     // iterate through each row string stored in rows
     for (int i = 1; i < (int)num_rows + 1; i++) {
         char* row = rows[i];
+        int row_len = (int)strlen(row);
         int col_index = 0;
 
         // iterate through each char in a row
-        for (int j = 0; j < (int)strlen(row); j++) {
+        for (int j = 0; j < row_len; j++) {
             char* c = row + j;
 
             if (is_a_let(*c) == 1) {
@@ -262,13 +411,17 @@ enum board_init_status decompress_board_str(int** cells_p, size_t* width_p,
             }
             // increase index to keep numbers together
             else if (is_a_num(*c) == 1) {
-                if (j + 1 < (int)strlen(row)) {
+                if (j + 1 < row_len) {
                     char* next = row + j + 1;
-                    while (j < (int)strlen(row) && is_a_num(*next) == 1) {
+                    while (j < row_len && is_a_num(*next) == 1) {
                         j++;
                         next++;
                     }
                 }
+                // a run with no cell type
+                if (curr_flag == -1) {
+                    return INIT_ERR_BAD_CHAR;
+                }
                 // num cells to mark with current flag
                 int num_cells = atoi(c);
                 int start_pos = cells_pos(row_index, col_index, *width_p);
@@ -280,11 +433,19 @@ enum board_init_status decompress_board_str(int** cells_p, size_t* width_p,
                         return INIT_ERR_WRONG_SNAKE_NUM;
                     }
                     // initialize snake data
-                    snake_p->snake_pos = NULL;
-                    node_t** head = &(snake_p->snake_pos);
-                    insert_first(head, &start_pos, sizeof(int));
+                    snake_body_init(&snake_p->snake_pos);
+                    snake_body_push_head(&snake_p->snake_pos, RIGHT, start_pos);
+                }
+                // a run past either end of the row (a huge count wraps
+                // negative) is caught by the width check below; don't write
+                // outside the row before getting there
+                int room = (int)*width_p - col_index;
+                int first = col_index < 0 ? -col_index : 0;
+                int count = num_cells < room ? num_cells : room;
+                if (count > first) {
+                    fill_cells(cells_p, row_index, col_index + first, *width_p,
+                               count - first, curr_flag);
                 }
-                fill_cells(cells_p, start_pos, num_cells, curr_flag);
                 col_index += num_cells;
             }
         }
@@ -300,3 +461,32 @@ enum board_init_status decompress_board_str(int** cells_p, size_t* width_p,
     }
     return INIT_SUCCESS;
 }
+
+/** Takes in a string `compressed` and initializes values pointed to by
+ * cells_p, width_p, and height_p accordingly. Arguments:
+ *      - cells_p: a pointer to the pointer representing the cells array
+ *                 that we would like to initialize.
+ *      - width_p: a pointer to the width variable we'd like to initialize.
+ *      - height_p: a pointer to the height variable we'd like to initialize.
+ *      - snake_p: a pointer to your snake struct (not used until part 3!)
+ *      - compressed: a string that contains the representation of the board.
+ * Note: We assume that the string will be of the following form:
+ * B24x80|E5W2E73|E5W2S1E72... To read it, we scan the string row-by-row
+ * (delineated by the `|` character), and read out a letter (E, S or W) a number
+ * of times dictated by the number that follows the letter.
+ */
+enum board_init_status decompress_board_str(int** cells_p, size_t* width_p,
+                                            size_t* height_p, snake_t* snake_p,
+                                            char* compressed) {
+    // one slot per `|`-separated token, plus the header and a spare for the
+    // end, so boards of any height fit
+    size_t max_tokens = 2;
+    for (char* p = compressed; *p != '\0'; p++) {
+        max_tokens += *p == '|';
+    }
+    char** rows = calloc(max_tokens, sizeof(char*));
+    enum board_init_status status = decompress_rows(
+        cells_p, width_p, height_p, snake_p, compressed, rows);
+    free(rows);
+    return status;
+}
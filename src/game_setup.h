@@ -22,13 +22,31 @@ enum board_init_status {
     INIT_UNIMPLEMENTED  // only used in stencil, no need to handle this
 };
 
+// What happens at the edge of a board with no border walls (padded layout
+// only; other layouts need border walls).
+enum edge_mode {
+    EDGE_OPEN,  // the snake dies running off the board
+    EDGE_WRAP,  // the snake comes back on at the opposite edge
+};
+
 enum board_init_status initialize_game(int** cells_p, size_t* width_p,
                                        size_t* height_p, snake_t* snake_p,
                                        char* board_rep);
 
+void start_game(int* cells, size_t width, size_t height, snake_t* snake_p);
+void start_counted_game(int* cells, size_t width, size_t height,
+                        snake_t* snake_p, size_t free_cells);
+void set_food_count(int* cells, size_t width, size_t height, int count);
+size_t count_free_cells(const int* cells, size_t width, size_t height,
+                        size_t limit);
+void place_start_food(int* cells, size_t width, size_t height,
+                      size_t free_cells);
 enum board_init_status decompress_board_str(int** cells_p, size_t* width_p,
                                             size_t* height_p, snake_t* snake_p,
                                             char* compressed);
+int check_row_char(char c);
+int set_board_edges(int* cells, size_t width, size_t height,
+                    enum edge_mode mode);
 enum board_init_status initialize_default_board(int** cells_p, size_t* width_p,
                                                 size_t* height_p);
 
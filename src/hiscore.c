@@ -0,0 +1,626 @@
+#define _GNU_SOURCE  // mremap()
+
+#include "hiscore.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#define HISCORE_MAGIC 0x33524f435345534eull  // "NSESCOR3"
+#define MAX_RECORDS UINT32_MAX  // leaderboards hold 32-bit record indices
+
+// One appended game. `committed` is written last, so a record torn by a
+// crash is never read. It is written while holding its board's lock, which
+// is kept until the record is also filed in the overall leaderboard: if the
+// writer dies before that, whoever takes over the lock rebuilds both
+// leaderboards (see lock_board()).
+typedef struct hiscore_record {
+    uint64_t board_key;
+    int64_t time;
+    int32_t score;
+    uint32_t committed;
+    char name[HISCORE_NAME_LEN];
+} hiscore_record_t;
+
+// The best HISCORE_TOP_K records for one board (or all boards), sorted by
+// score, best first. Writers hold `lock` (the pid of the holder); readers
+// retry while `version` is odd or changes under them.
+typedef struct hiscore_board {
+    uint64_t key;  // board key; HISCORE_ALL (never a board's key) marks an
+                   // unused slot, and the overall leaderboard
+    uint32_t lock;
+    uint32_t version;
+    uint32_t count;
+    uint32_t top[HISCORE_TOP_K];
+} hiscore_board_t;
+
+// Followed in the file by the record slots, then the board slots. Every
+// record can start a new leaderboard, so there are at least as many board
+// slots as record slots and the table never fills up; unused slots are
+// never written, so the sparse file doesn't store them.
+//
+// Every call holds the file's flock() shared. When the records run out,
+// the file is grown under the exclusive lock: record slots double, and the
+// board table, which moves past them and doubles too, is rebuilt from the
+// records. `growing` is set meanwhile, so a grower that dies part way is
+// finished by the next caller (see settle()).
+typedef struct hiscore_header {
+    uint64_t magic;
+    uint64_t capacity;     // number of record slots in the file
+    uint64_t num_boards;   // board slots: a power of two, at least capacity
+    uint64_t next_record;  // next free slot, claimed with a fetch-add
+    uint64_t growing;      // set while the file is being grown
+    hiscore_board_t overall;
+} hiscore_header_t;
+
+/* Returns the first record slot in the file.
+ */
+static hiscore_record_t* records(hiscore_header_t* header) {
+    return (hiscore_record_t*)(header + 1);
+}
+
+/* Returns the first board slot in the file.
+ */
+static hiscore_board_t* boards(hiscore_header_t* header) {
+    return (hiscore_board_t*)&records(header)[header->capacity];
+}
+
+/* Returns the size of a file with `capacity` record slots and `num_boards`
+   board slots.
+*/
+static size_t file_size(uint64_t capacity, uint64_t num_boards) {
+    return sizeof(hiscore_header_t) + capacity * sizeof(hiscore_record_t) +
+           num_boards * sizeof(hiscore_board_t);
+}
+
+/** Opens (creating if needed) a high-score file.
+ *
+ * Returns 0 on success and -1 on failure.
+ *
+ * Arguments:
+ *  - store: filled in with the open file.
+ *  - path: the file.
+ *  - capacity: number of records a new file starts with; it grows as games
+ *    are added. Ignored if the file already exists. The file is sparse, so
+ *    unused slots take no disk space.
+ */
+int hiscore_open(hiscore_t* store, const char* path, size_t capacity) {
+    store->fd = open(path, O_RDWR | O_CREAT, 0644);
+    if (store->fd < 0) {
+        return -1;
+    }
+
+    flock(store->fd, LOCK_EX);
+    hiscore_header_t header;
+    ssize_t got = pread(store->fd, &header, sizeof(header), 0);
+    if (got == 0) {
+        memset(&header, 0, sizeof(header));
+        header.magic = HISCORE_MAGIC;
+        header.capacity = capacity > 0 ? capacity : 1;
+        header.num_boards = 1;
+        while (header.num_boards < header.capacity) {
+            header.num_boards *= 2;
+        }
+        if (ftruncate(store->fd,
+                      file_size(header.capacity, header.num_boards)) ||
+            pwrite(store->fd, &header, sizeof(header), 0) !=
+                (ssize_t)sizeof(header)) {
+            got = -1;
+        } else {
+            got = sizeof(header);
+        }
+    }
+    flock(store->fd, LOCK_UN);
+    if (got != (ssize_t)sizeof(header) || header.magic != HISCORE_MAGIC) {
+        close(store->fd);
+        return -1;
+    }
+
+    store->map_size = file_size(header.capacity, header.num_boards);
+    store->header = mmap(NULL, store->map_size, PROT_READ | PROT_WRITE,
+                         MAP_SHARED, store->fd, 0);
+    if (store->header == MAP_FAILED) {
+        close(store->fd);
+        return -1;
+    }
+    return 0;
+}
+
+/** Unmaps and closes a high-score file.
+ */
+void hiscore_close(hiscore_t* store) {
+    munmap(store->header, store->map_size);
+    close(store->fd);
+    store->header = NULL;
+}
+
+/** Returns the key a board's scores are filed under: a hash of its size and
+ * starting cells, ignoring food. It is never HISCORE_ALL.
+ */
+uint64_t hiscore_board_key(int* cells, size_t width, size_t height) {
+    uint64_t hash = 14695981039346656037ull;
+    hash = (hash ^ width) * 1099511628211ull;
+    hash = (hash ^ height) * 1099511628211ull;
+    for (size_t row = 0; row < height; row++) {
+        for (size_t col = 0; col < width; col++) {
+            int cell = cells[cell_index(row, col, width)] & ~FLAG_FOOD;
+            hash = (hash ^ (uint64_t)cell) * 1099511628211ull;
+        }
+    }
+    return hash == HISCORE_ALL ? 1 : hash;
+}
+
+/* Returns the leaderboard for `board_key`, claiming a free slot for it if
+   `create` is set. Returns NULL if there is none, or (which the table's
+   size rules out) no room for one.
+*/
+static hiscore_board_t* find_board(hiscore_header_t* header,
+                                   uint64_t board_key, int create) {
+    if (board_key == HISCORE_ALL) {
+        return &header->overall;
+    }
+    hiscore_board_t* table = boards(header);
+    uint64_t mask = header->num_boards - 1;
+    for (uint64_t i = 0; i < header->num_boards; i++) {
+        hiscore_board_t* board = &table[(board_key + i) & mask];
+        uint64_t key = __atomic_load_n(&board->key, __ATOMIC_ACQUIRE);
+        if (key == board_key) {
+            return board;
+        }
+        if (key == HISCORE_ALL) {
+            if (!create) {
+                return NULL;
+            }
+            if (__atomic_compare_exchange_n(&board->key, &key, board_key, 0,
+                                            __ATOMIC_ACQ_REL,
+                                            __ATOMIC_ACQUIRE) ||
+                key == board_key) {
+                return board;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Returns 1 if record `a` ranks above record `b`: a higher score, or the
+   same score appended earlier.
+*/
+static int ranks_above(hiscore_record_t* recs, uint32_t a, uint32_t b) {
+    return recs[a].score > recs[b].score ||
+           (recs[a].score == recs[b].score && a < b);
+}
+
+/* Inserts record `index` into a leaderboard, if it makes the top K. Ties
+   keep the earlier record first, in whatever order records are filed, so
+   a rebuilt board comes out the same. The caller holds the board's lock.
+*/
+static void insert_top(hiscore_header_t* header, hiscore_board_t* board,
+                       uint32_t index) {
+    hiscore_record_t* recs = records(header);
+    uint32_t pos = board->count;
+    while (pos > 0 && ranks_above(recs, index, board->top[pos - 1])) {
+        pos--;
+    }
+    if (pos >= HISCORE_TOP_K) {
+        return;
+    }
+    uint32_t kept =
+        board->count < HISCORE_TOP_K ? board->count : HISCORE_TOP_K - 1;
+    memmove(&board->top[pos + 1], &board->top[pos],
+            (kept - pos) * sizeof(uint32_t));
+    board->top[pos] = index;
+    board->count = kept + 1;
+}
+
+/* Rebuilds a leaderboard from the committed records, after a writer died
+   while holding its lock. Records are only committed under the lock, so
+   none can appear while this runs. The caller holds the lock.
+*/
+static void rebuild_board(hiscore_header_t* header, hiscore_board_t* board) {
+    hiscore_record_t* recs = records(header);
+    uint64_t end = __atomic_load_n(&header->next_record, __ATOMIC_ACQUIRE);
+    if (end > header->capacity) {
+        end = header->capacity;
+    }
+    board->count = 0;
+    for (uint64_t i = 0; i < end; i++) {
+        if (__atomic_load_n(&recs[i].committed, __ATOMIC_ACQUIRE) &&
+            (board->key == HISCORE_ALL || recs[i].board_key == board->key)) {
+            insert_top(header, board, (uint32_t)i);
+        }
+    }
+}
+
+/* Waits before a lock or a read is retried: a pause instruction for the
+   first few tries, then sched_yield(), so that a holder which was
+   preempted gets to run and finish.
+*/
+static void backoff(unsigned spins) {
+    if (spins < 64) {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        __asm__ __volatile__("yield");
+#endif
+    } else {
+        sched_yield();
+    }
+}
+
+/* Publishes a leaderboard's changes and releases its lock.
+ */
+static void unlock_board(hiscore_board_t* board) {
+    __atomic_add_fetch(&board->version, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&board->lock, 0, __ATOMIC_RELEASE);
+}
+
+/* Takes a leaderboard's lock and marks it as being written. If the holder
+   has died, the lock is taken over and the board rebuilt, since it may have
+   been left half-updated. So is the overall leaderboard, which the holder
+   may not have filed its record in yet.
+*/
+static void lock_board(hiscore_header_t* header, hiscore_board_t* board) {
+    uint32_t self = (uint32_t)getpid();
+    for (unsigned spins = 1;; spins++) {
+        uint32_t owner = 0;
+        if (__atomic_compare_exchange_n(&board->lock, &owner, self, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+        if (spins % 1024 == 0 && kill((pid_t)owner, 0) && errno == ESRCH &&
+            __atomic_compare_exchange_n(&board->lock, &owner, self, 0,
+                                        __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            if (__atomic_load_n(&board->version, __ATOMIC_RELAXED) % 2 == 0) {
+                __atomic_add_fetch(&board->version, 1, __ATOMIC_RELAXED);
+            }
+            __atomic_thread_fence(__ATOMIC_RELEASE);
+            rebuild_board(header, board);
+            if (board != &header->overall) {
+                lock_board(header, &header->overall);
+                rebuild_board(header, &header->overall);
+                unlock_board(&header->overall);
+            }
+            return;
+        }
+        backoff(spins);
+    }
+    __atomic_add_fetch(&board->version, 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/* Copies a leaderboard's entries into `top` without taking its lock,
+   retrying while a writer is changing it. Returns the number of entries.
+*/
+static uint32_t read_board(hiscore_header_t* header, hiscore_board_t* board,
+                           uint32_t* top) {
+    for (unsigned spins = 1;; spins++) {
+        uint32_t version = __atomic_load_n(&board->version, __ATOMIC_ACQUIRE);
+        if (version % 2 == 0) {
+            uint32_t count = __atomic_load_n(&board->count, __ATOMIC_RELAXED);
+            memcpy(top, board->top, HISCORE_TOP_K * sizeof(uint32_t));
+            __atomic_thread_fence(__ATOMIC_ACQUIRE);
+            if (__atomic_load_n(&board->version, __ATOMIC_RELAXED) == version) {
+                return count;
+            }
+        } else if (spins % 1024 == 0) {
+            // the writer may have died; taking the lock repairs the board
+            lock_board(header, board);
+            unlock_board(board);
+        }
+        backoff(spins);
+    }
+}
+
+/* Empties the board table and refiles every committed record, after the
+   table moved or a grower died part way. The caller holds the file's
+   exclusive lock, so nobody else is using the table.
+*/
+static void rebuild_all(hiscore_t* store) {
+    hiscore_header_t* header = store->header;
+    memset(&header->overall, 0, sizeof(header->overall));
+    // punching a hole zeroes the table without storing the zeroes
+    size_t table_size = header->num_boards * sizeof(hiscore_board_t);
+    off_t table_start = (off_t)((char*)boards(header) - (char*)header);
+    if (fallocate(store->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  table_start, (off_t)table_size) < 0) {
+        memset(boards(header), 0, table_size);
+    }
+
+    hiscore_record_t* recs = records(header);
+    uint64_t end = header->next_record;
+    if (end > header->capacity) {
+        end = header->capacity;
+    }
+    for (uint64_t i = 0; i < end; i++) {
+        if (!recs[i].committed) {
+            continue;
+        }
+        hiscore_board_t* board = find_board(header, recs[i].board_key, 1);
+        if (board != NULL) {
+            insert_top(header, board, (uint32_t)i);
+        }
+        insert_top(header, &header->overall, (uint32_t)i);
+    }
+}
+
+/* Maps the file's first `size` bytes, if that isn't what is mapped already.
+   Returns 0 on success and -1 on failure.
+*/
+static int map_file(hiscore_t* store, size_t size) {
+    if (size == store->map_size) {
+        return 0;
+    }
+    void* map = mremap(store->header, store->map_size, size, MREMAP_MAYMOVE);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    store->header = map;
+    store->map_size = size;
+    return 0;
+}
+
+/* Maps all of the file as its header describes it, finishing a growth
+   that was left part way. The caller holds the file's exclusive lock.
+   Returns 0 on success and -1 on failure.
+*/
+static int settle(hiscore_t* store) {
+    hiscore_header_t* header = store->header;
+    if (map_file(store, file_size(header->capacity, header->num_boards)) < 0) {
+        return -1;
+    }
+    if (store->header->growing) {
+        rebuild_all(store);
+        __atomic_store_n(&store->header->growing, 0, __ATOMIC_RELEASE);
+    }
+    return 0;
+}
+
+/* Takes the file's shared lock, which every call holds, remapping the file
+   if another process grew it. Returns 0 on success and -1 (without the
+   lock) on failure.
+*/
+static int enter(hiscore_t* store) {
+    flock(store->fd, LOCK_SH);
+    for (;;) {
+        hiscore_header_t* header = store->header;
+        if (map_file(store, file_size(header->capacity, header->num_boards)) <
+            0) {
+            break;
+        }
+        if (!store->header->growing) {
+            return 0;
+        }
+        // a grower died part way; changing locks isn't atomic, so check
+        // again once back to the shared lock
+        flock(store->fd, LOCK_EX);
+        if (settle(store) < 0) {
+            break;
+        }
+        flock(store->fd, LOCK_SH);
+    }
+    flock(store->fd, LOCK_UN);
+    return -1;
+}
+
+/* Releases the file's shared lock.
+ */
+static void leave(hiscore_t* store) {
+    flock(store->fd, LOCK_UN);
+}
+
+/* Doubles the record and board slots. The table moves past the new
+   records and is rebuilt there. Each step leaves a layout that settle()
+   can rebuild if the process dies: first the bigger table where the old
+   one was, then both in their new places. The caller holds the exclusive
+   lock. Returns 0 on success and -1 on failure.
+*/
+static int double_file(hiscore_t* store) {
+    uint64_t capacity = store->header->capacity;
+    uint64_t num_boards = store->header->num_boards;
+    size_t size = file_size(2 * capacity, 2 * num_boards);
+    if (2 * capacity > MAX_RECORDS || ftruncate(store->fd, (off_t)size) ||
+        map_file(store, size) < 0) {
+        return -1;
+    }
+    hiscore_header_t* header = store->header;
+    __atomic_store_n(&header->growing, 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&header->num_boards, 2 * num_boards, __ATOMIC_RELEASE);
+    // the old table becomes record slots, which must read as uncommitted
+    size_t table_size = num_boards * sizeof(hiscore_board_t);
+    off_t table_start = (off_t)((char*)boards(header) - (char*)header);
+    if (fallocate(store->fd, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                  table_start, (off_t)table_size) < 0) {
+        memset(boards(header), 0, table_size);
+    }
+    __atomic_store_n(&header->capacity, 2 * capacity, __ATOMIC_RELEASE);
+    rebuild_all(store);
+    __atomic_store_n(&header->growing, 0, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* Grows the file until it has record slot `index`, under the exclusive
+   lock, then goes back to the shared lock. Returns 0 on success and -1 on
+   failure (and maybe without the lock).
+*/
+static int grow(hiscore_t* store, uint64_t index) {
+    flock(store->fd, LOCK_EX);
+    int result = settle(store);
+    while (result == 0 && store->header->capacity <= index) {
+        result = double_file(store);
+    }
+    return enter(store) < 0 ? -1 : result;
+}
+
+/* Returns 1 if record `index` would make the overall top K. Reads the
+   leaderboard without its lock: its K-th entry only ever improves, so a
+   stale copy can't turn away a record that makes it.
+*/
+static int makes_overall(hiscore_header_t* header, uint32_t index) {
+    uint32_t top[HISCORE_TOP_K];
+    uint32_t count = read_board(header, &header->overall, top);
+    return count < HISCORE_TOP_K ||
+           ranks_above(records(header), index, top[HISCORE_TOP_K - 1]);
+}
+
+/** Appends a finished game and files it in the per-board and overall
+ * leaderboards. Safe to call from several processes at once: each append
+ * claims its own slot and locks its board's leaderboard, and the overall
+ * one only if the game makes its top K, which is rare once it has filled.
+ * A writer that dies part way leaves either no trace or a record that the
+ * next writer or reader to take over its lock files (see lock_board()).
+ * When the file is full, the first writer to notice grows it.
+ *
+ * Returns 0 on success and -1 if the file can't grow or board_key is
+ * HISCORE_ALL.
+ *
+ * Arguments:
+ *  - store: an open high-score file.
+ *  - board_key: the board played, from hiscore_board_key().
+ *  - name: the player's name; longer names are cut short.
+ *  - score: the final score.
+ */
+int hiscore_add(hiscore_t* store, uint64_t board_key, const char* name,
+                int score) {
+    if (board_key == HISCORE_ALL || enter(store) < 0) {
+        return -1;
+    }
+    uint64_t index =
+        __atomic_fetch_add(&store->header->next_record, 1, __ATOMIC_RELAXED);
+    if (index >= MAX_RECORDS ||
+        (index >= store->header->capacity && grow(store, index) < 0)) {
+        leave(store);
+        return -1;
+    }
+    hiscore_header_t* header = store->header;
+    hiscore_board_t* board = find_board(header, board_key, 1);
+    if (board == NULL) {
+        leave(store);
+        return -1;
+    }
+
+    hiscore_record_t* record = &records(header)[index];
+    record->board_key = board_key;
+    record->time = (int64_t)time(NULL);
+    record->score = score;
+    strncpy(record->name, name, HISCORE_NAME_LEN - 1);
+    record->name[HISCORE_NAME_LEN - 1] = '\0';
+
+    // the board's lock is held until the record is filed overall too; the
+    // overall lock is only ever taken after a board's, never before
+    lock_board(header, board);
+    __atomic_store_n(&record->committed, 1, __ATOMIC_RELEASE);
+    insert_top(header, board, (uint32_t)index);
+    if (makes_overall(header, (uint32_t)index)) {
+        lock_board(header, &header->overall);
+        insert_top(header, &header->overall, (uint32_t)index);
+        unlock_board(&header->overall);
+    }
+    unlock_board(board);
+    leave(store);
+    return 0;
+}
+
+/** Copies out the best scores, best first, in O(k).
+ *
+ * Returns the number of entries written, at most `k` and HISCORE_TOP_K.
+ *
+ * Arguments:
+ *  - store: an open high-score file.
+ *  - board_key: the board, from hiscore_board_key(), or HISCORE_ALL for the
+ *    best scores on any board.
+ *  - out: space for `k` entries.
+ *  - k: number of entries wanted.
+ */
+size_t hiscore_top(hiscore_t* store, uint64_t board_key, hiscore_entry_t* out,
+                   size_t k) {
+    if (enter(store) < 0) {
+        return 0;
+    }
+    hiscore_header_t* header = store->header;
+    hiscore_board_t* board = find_board(header, board_key, 0);
+    uint32_t top[HISCORE_TOP_K];
+    uint32_t count = board == NULL ? 0 : read_board(header, board, top);
+    if (count > k) {
+        count = (uint32_t)k;
+    }
+    hiscore_record_t* recs = records(header);
+    for (uint32_t i = 0; i < count; i++) {
+        out[i].board_key = recs[top[i]].board_key;
+        out[i].time = recs[top[i]].time;
+        out[i].score = recs[top[i]].score;
+        memcpy(out[i].name, recs[top[i]].name, HISCORE_NAME_LEN);
+    }
+    leave(store);
+    return count;
+}
+
+/** Returns the number of records appended so far.
+ */
+size_t hiscore_count(hiscore_t* store) {
+    if (enter(store) < 0) {
+        return 0;
+    }
+    uint64_t count =
+        __atomic_load_n(&store->header->next_record, __ATOMIC_RELAXED);
+    if (count > store->header->capacity) {
+        count = store->header->capacity;
+    }
+    leave(store);
+    return count;
+}
+
+/* Returns 1 if a leaderboard lists exactly the best of its board's
+   committed records. Takes the board's lock, repairing it first if a
+   writer died holding it.
+*/
+static int board_ok(hiscore_header_t* header, hiscore_board_t* board) {
+    hiscore_board_t expected;
+    memset(&expected, 0, sizeof(expected));
+    lock_board(header, board);
+    expected.key = board->key;
+    rebuild_board(header, &expected);
+    int ok = board->count == expected.count &&
+             memcmp(board->top, expected.top,
+                    expected.count * sizeof(uint32_t)) == 0;
+    unlock_board(board);
+    return ok;
+}
+
+/** Checks that every leaderboard lists exactly the best scores of the
+ * records behind it, as after a clean run. Safe while others append, but
+ * slow: every leaderboard is rebuilt from the records.
+ *
+ * Returns 0 if the file is consistent and -1 if it isn't.
+ */
+int hiscore_check(hiscore_t* store) {
+    if (enter(store) < 0) {
+        return -1;
+    }
+    // the overall board last: taking over a dead writer's board lock also
+    // files its record overall
+    hiscore_header_t* header = store->header;
+    hiscore_board_t* table = boards(header);
+    int result = 0;
+    for (uint64_t i = 0; i < header->num_boards && result == 0; i++) {
+        if (__atomic_load_n(&table[i].key, __ATOMIC_ACQUIRE) != HISCORE_ALL &&
+            !board_ok(header, &table[i])) {
+            result = -1;
+        }
+    }
+    if (result == 0 && !board_ok(header, &header->overall)) {
+        result = -1;
+    }
+    leave(store);
+    return result;
+}
@@ -0,0 +1,45 @@
+#ifndef HISCORE_H
+#define HISCORE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define HISCORE_TOP_K 16         // entries kept per leaderboard
+#define HISCORE_NAME_LEN 48      // bytes of player name kept, incl. NUL
+#define HISCORE_CAPACITY (1 << 10)  // records a new file starts with
+#define HISCORE_ALL ((uint64_t)0)   // board key meaning "every board"
+
+/** One finished game, as returned by hiscore_top().
+ */
+typedef struct hiscore_entry {
+    uint64_t board_key;
+    int64_t time;
+    int score;
+    char name[HISCORE_NAME_LEN];
+} hiscore_entry_t;
+
+struct hiscore_header;
+
+/** An open high-score file.
+ * Fields:
+ *  - fd: the file
+ *  - header: the mapped file, starting with its header
+ *  - map_size: bytes mapped
+ */
+typedef struct hiscore {
+    int fd;
+    struct hiscore_header* header;
+    size_t map_size;
+} hiscore_t;
+
+int hiscore_open(hiscore_t* store, const char* path, size_t capacity);
+void hiscore_close(hiscore_t* store);
+uint64_t hiscore_board_key(int* cells, size_t width, size_t height);
+int hiscore_add(hiscore_t* store, uint64_t board_key, const char* name,
+                int score);
+size_t hiscore_top(hiscore_t* store, uint64_t board_key, hiscore_entry_t* out,
+                   size_t k);
+size_t hiscore_count(hiscore_t* store);
+int hiscore_check(hiscore_t* store);
+
+#endif
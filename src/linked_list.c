@@ -1,10 +1,12 @@
 #include "linked_list.h"
 
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
+#include "arena.h"
 
 /**
  * find and return the length of the list
@@ -63,8 +65,9 @@ void insert_first(node_t** head_list, void* to_add, size_t size) {
     if (!to_add) {
         return;
     }
-    node_t* new_element = (node_t*)malloc(sizeof(node_t));
-    void* new_data = malloc(size);
+    // the payload is stored right after the node, in the same allocation
+    node_t* new_element = (node_t*)game_alloc(sizeof(node_t) + size);
+    void* new_data = new_element + 1;
     memcpy(new_data, to_add, size);
     new_element->data = new_data;
 
@@ -93,8 +96,9 @@ void insert_last(node_t** head_list, void* to_add, size_t size) {
     if (!to_add) {
         return;
     }
-    node_t* new_element = (node_t*)malloc(sizeof(node_t));
-    void* new_data = malloc(size);
+    // the payload is stored right after the node, in the same allocation
+    node_t* new_element = (node_t*)game_alloc(sizeof(node_t) + size);
+    void* new_data = new_element + 1;
     memcpy(new_data, to_add, size);
     new_element->data = new_data;
 
@@ -164,8 +168,7 @@ int remove_element(node_t** head_list, void* to_remove, size_t size) {
             } else {
                 curr->prev->next = curr->next;
             }
-            free(curr->data);
-            free(curr);
+            game_free(curr);
             return 1;
         }
         curr = curr->next;
@@ -228,8 +231,7 @@ void remove_first(node_t** head_list) {
     if (*head_list) {
         (*head_list)->prev = NULL;
     }
-    free(curr->data);
-    free(curr);
+    game_free(curr);
 }
 
 /** 
@@ -246,8 +248,7 @@ void remove_last(node_t** head_list) {
     }
     node_t* curr = *head_list;
     if (!((*head_list)->next)) {
-        free(curr->data);
-        free(curr);
+        game_free(curr);
         *head_list = NULL;
         return;
     }
@@ -257,6 +258,471 @@ void remove_last(node_t** head_list) {
     }
     curr->prev->next = NULL;
 
-    free(curr->data);
-    free(curr);
+    game_free(curr);
+}
+
+/* Returns slot `slot` of an unrolled list node.
+ */
+static void* ulist_slot(ulist_t* list, ulist_node_t* node, int slot) {
+    return (char*)(node + 1) + (size_t)slot * list->elem_size;
+}
+
+/* Allocates an empty node whose free slots start at `start`.
+ */
+static ulist_node_t* ulist_new_node(ulist_t* list, int start) {
+    ulist_node_t* node = (ulist_node_t*)game_alloc(
+        sizeof(ulist_node_t) + ULIST_NODE_CAP * list->elem_size);
+    node->next = NULL;
+    node->prev = NULL;
+    node->start = start;
+    node->count = 0;
+    return node;
+}
+
+/* Unlinks and frees a node that has no payloads left.
+ */
+static void ulist_drop_node(ulist_t* list, ulist_node_t* node) {
+    if (node->prev) {
+        node->prev->next = node->next;
+    } else {
+        list->head = node->next;
+    }
+    if (node->next) {
+        node->next->prev = node->prev;
+    } else {
+        list->tail = node->prev;
+    }
+    game_free(node);
+}
+
+/* Hashes a payload's bytes (FNV-1a, then a splitmix64 finalizer so that
+   the low bits used for the table position are well mixed).
+*/
+static uint64_t ulist_hash(const void* data, size_t size) {
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++) {
+        hash ^= ((const unsigned char*)data)[i];
+        hash *= 1099511628211ull;
+    }
+    hash ^= hash >> 30;
+    hash *= 0xbf58476d1ce4e5b9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94d049bb133111ebull;
+    return hash ^ (hash >> 31);
+}
+
+/* Adds the payload in `slot` of `node` to the index. The table must have a
+   free entry.
+*/
+static void ulist_index_put(ulist_t* list, ulist_node_t* node, int slot) {
+    uint64_t hash = ulist_hash(ulist_slot(list, node, slot), list->elem_size);
+    size_t mask = list->index_cap - 1;
+    size_t i = hash & mask;
+    while (list->index[i].node) {
+        i = (i + 1) & mask;
+    }
+    list->index[i].node = node;
+    list->index[i].slot = slot;
+    list->index[i].hash = hash;
+}
+
+/* Rebuilds the index with room for `cap` entries, from the list's contents.
+ */
+static void ulist_index_rebuild(ulist_t* list, size_t cap) {
+    game_free(list->index);
+    list->index_cap = cap;
+    list->index = (ulist_entry_t*)game_alloc(cap * sizeof(ulist_entry_t));
+    memset(list->index, 0, cap * sizeof(ulist_entry_t));
+    for (ulist_node_t* curr = list->head; curr; curr = curr->next) {
+        for (int i = 0; i < curr->count; i++) {
+            ulist_index_put(list, curr, curr->start + i);
+        }
+    }
+}
+
+/* Adds a just-inserted payload to the index, growing the table to stay at
+   most half full.
+*/
+static void ulist_index_add(ulist_t* list, ulist_node_t* node, int slot) {
+    if ((size_t)list->count * 2 > list->index_cap) {
+        ulist_index_rebuild(list, list->index_cap * 2);  // includes the new one
+        return;
+    }
+    ulist_index_put(list, node, slot);
+}
+
+/* Returns the index entry for a payload equal to `value`, or NULL.
+ */
+static ulist_entry_t* ulist_index_find(ulist_t* list, void* value) {
+    uint64_t hash = ulist_hash(value, list->elem_size);
+    size_t mask = list->index_cap - 1;
+    for (size_t i = hash & mask; list->index[i].node; i = (i + 1) & mask) {
+        ulist_entry_t* entry = &list->index[i];
+        if (entry->hash == hash &&
+            !memcmp(ulist_slot(list, entry->node, entry->slot), value,
+                    list->elem_size)) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Returns the index entry for the payload stored in `slot` of `node`.
+ */
+static ulist_entry_t* ulist_index_at(ulist_t* list, ulist_node_t* node,
+                                     int slot) {
+    uint64_t hash = ulist_hash(ulist_slot(list, node, slot), list->elem_size);
+    size_t mask = list->index_cap - 1;
+    size_t i = hash & mask;
+    while (list->index[i].node != node || list->index[i].slot != slot) {
+        i = (i + 1) & mask;
+    }
+    return &list->index[i];
+}
+
+/* Removes an entry from the index, shifting later entries of its probe run
+   back so that no tombstones are needed.
+*/
+static void ulist_index_delete(ulist_t* list, ulist_entry_t* entry) {
+    size_t mask = list->index_cap - 1;
+    size_t hole = (size_t)(entry - list->index);
+    for (size_t i = (hole + 1) & mask; list->index[i].node;
+         i = (i + 1) & mask) {
+        // move the entry into the hole unless its home lies between them
+        size_t home = list->index[i].hash & mask;
+        if (((i - home) & mask) >= ((i - hole) & mask)) {
+            list->index[hole] = list->index[i];
+            hole = i;
+        }
+    }
+    list->index[hole].node = NULL;
+}
+
+/* Records in the index that the payload in `from` moved to `to`, both in
+   `node`. The payload must already be at `to`.
+*/
+static void ulist_index_move(ulist_t* list, ulist_node_t* node, int from,
+                             int to) {
+    uint64_t hash = ulist_hash(ulist_slot(list, node, to), list->elem_size);
+    size_t mask = list->index_cap - 1;
+    size_t i = hash & mask;
+    while (list->index[i].node != node || list->index[i].slot != from) {
+        i = (i + 1) & mask;
+    }
+    list->index[i].slot = to;
+}
+
+/**
+ * makes an empty unrolled list
+ *
+ * given a pointer to the list
+ */
+void ulist_init(ulist_t* list) { memset(list, 0, sizeof(*list)); }
+
+/**
+ * returns the number of elements in the unrolled list, in O(1)
+ */
+int ulist_length(ulist_t* list) { return list->count; }
+
+/**
+ * returns the first element of the unrolled list, or NULL if it is empty
+ */
+void* ulist_get_first(ulist_t* list) {
+    if (!list->head) {
+        return NULL;
+    }
+    return ulist_slot(list, list->head, list->head->start);
+}
+
+/**
+ * returns the last element of the unrolled list, or NULL if it is empty, in
+ * O(1)
+ */
+void* ulist_get_last(ulist_t* list) {
+    if (!list->tail) {
+        return NULL;
+    }
+    return ulist_slot(list, list->tail,
+                      list->tail->start + list->tail->count - 1);
+}
+
+/**
+ * inserts element at the beginning of the unrolled list
+ *
+ * given a pointer to the list, a void pointer representing the value to be
+ * added, and the size of the data pointed to (the same for every element)
+ *
+ * returns nothing
+ */
+void ulist_insert_first(ulist_t* list, void* to_add, size_t size) {
+    if (!to_add) {
+        return;
+    }
+    list->elem_size = size;
+    if (!list->head || list->head->start == 0) {
+        // fill new nodes from the back, so later inserts here find room
+        ulist_node_t* node = ulist_new_node(list, ULIST_NODE_CAP);
+        node->next = list->head;
+        if (list->head) {
+            list->head->prev = node;
+        } else {
+            list->tail = node;
+        }
+        list->head = node;
+    }
+    list->head->start--;
+    list->head->count++;
+    memcpy(ulist_slot(list, list->head, list->head->start), to_add, size);
+    list->count++;
+    if (list->index) {
+        ulist_index_add(list, list->head, list->head->start);
+    }
+}
+
+/**
+ * inserts element at the end of the unrolled list, in O(1)
+ *
+ * given a pointer to the list, a void pointer representing the value to be
+ * added, and the size of the data pointed to (the same for every element)
+ *
+ * returns nothing
+ */
+void ulist_insert_last(ulist_t* list, void* to_add, size_t size) {
+    if (!to_add) {
+        return;
+    }
+    list->elem_size = size;
+    if (!list->tail ||
+        list->tail->start + list->tail->count == ULIST_NODE_CAP) {
+        ulist_node_t* node = ulist_new_node(list, 0);
+        node->prev = list->tail;
+        if (list->tail) {
+            list->tail->next = node;
+        } else {
+            list->head = node;
+        }
+        list->tail = node;
+    }
+    memcpy(ulist_slot(list, list->tail, list->tail->start + list->tail->count),
+           to_add, size);
+    list->tail->count++;
+    list->count++;
+    if (list->index) {
+        ulist_index_add(list, list->tail,
+                        list->tail->start + list->tail->count - 1);
+    }
+}
+
+/**
+ * gets the element at `index` from the unrolled list, skipping whole nodes
+ * at a time
+ *
+ * returns NULL if the index is out of bounds (negative or past the end)
+ */
+void* ulist_get(ulist_t* list, int index) {
+    if (index < 0 || index >= list->count) {
+        return NULL;
+    }
+    ulist_node_t* curr = list->head;
+    while (index >= curr->count) {
+        index -= curr->count;
+        curr = curr->next;
+    }
+    return ulist_slot(list, curr, curr->start + index);
+}
+
+/**
+ * removes an element equal (by memcmp of `size` bytes) to `to_remove` from
+ * the unrolled list: the first one, or with a hash index, any one in O(1)
+ * expected time
+ *
+ * returns 1 on success and 0 if no element matched
+ */
+int ulist_remove_element(ulist_t* list, void* to_remove, size_t size) {
+    if (list->index) {
+        ulist_entry_t* entry = ulist_index_find(list, to_remove);
+        if (!entry) {
+            return 0;
+        }
+        ulist_node_t* node = entry->node;
+        int slot = entry->slot;
+        ulist_index_delete(list, entry);
+
+        // close the gap from whichever side of the node has fewer payloads
+        if (slot - node->start < node->count / 2) {
+            for (int i = slot; i > node->start; i--) {
+                memcpy(ulist_slot(list, node, i), ulist_slot(list, node, i - 1),
+                       list->elem_size);
+                ulist_index_move(list, node, i - 1, i);
+            }
+            node->start++;
+        } else {
+            for (int i = slot; i < node->start + node->count - 1; i++) {
+                memcpy(ulist_slot(list, node, i), ulist_slot(list, node, i + 1),
+                       list->elem_size);
+                ulist_index_move(list, node, i + 1, i);
+            }
+        }
+        node->count--;
+        list->count--;
+        if (node->count == 0) {
+            ulist_drop_node(list, node);
+        }
+        return 1;
+    }
+
+    for (ulist_node_t* curr = list->head; curr; curr = curr->next) {
+        for (int i = 0; i < curr->count; i++) {
+            void* slot = ulist_slot(list, curr, curr->start + i);
+            if (memcmp(slot, to_remove, size)) {
+                continue;
+            }
+            // close the gap within the node
+            memmove(slot, (char*)slot + list->elem_size,
+                    (size_t)(curr->count - i - 1) * list->elem_size);
+            curr->count--;
+            list->count--;
+            if (curr->count == 0) {
+                ulist_drop_node(list, curr);
+            }
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * reverses the unrolled list in place
+ *
+ * returns nothing
+ */
+void ulist_reverse(ulist_t* list) {
+    unsigned char tmp[64];
+    ulist_node_t* curr = list->head;
+    while (curr) {
+        // reverse the node's payloads, then its links
+        for (int i = 0, j = curr->count - 1; i < j; i++, j--) {
+            void* a = ulist_slot(list, curr, curr->start + i);
+            void* b = ulist_slot(list, curr, curr->start + j);
+            for (size_t done = 0; done < list->elem_size; done += sizeof(tmp)) {
+                size_t len = list->elem_size - done < sizeof(tmp)
+                                 ? list->elem_size - done
+                                 : sizeof(tmp);
+                memcpy(tmp, (char*)a + done, len);
+                memcpy((char*)a + done, (char*)b + done, len);
+                memcpy((char*)b + done, tmp, len);
+            }
+        }
+        ulist_node_t* next = curr->next;
+        curr->next = curr->prev;
+        curr->prev = next;
+        curr = next;
+    }
+    ulist_node_t* head = list->head;
+    list->head = list->tail;
+    list->tail = head;
+    if (list->index) {
+        ulist_index_rebuild(list, list->index_cap);
+    }
+}
+
+/**
+ * removes the first element of the unrolled list if it exists
+ *
+ * returns nothing
+ */
+void ulist_remove_first(ulist_t* list) {
+    if (!list->head) {
+        return;
+    }
+    if (list->index) {
+        ulist_index_delete(list,
+                           ulist_index_at(list, list->head, list->head->start));
+    }
+    list->head->start++;
+    list->head->count--;
+    list->count--;
+    if (list->head->count == 0) {
+        ulist_drop_node(list, list->head);
+    }
+}
+
+/**
+ * removes the last element of the unrolled list if it exists, in O(1)
+ *
+ * returns nothing
+ */
+void ulist_remove_last(ulist_t* list) {
+    if (!list->tail) {
+        return;
+    }
+    if (list->index) {
+        ulist_index_delete(
+            list, ulist_index_at(list, list->tail,
+                                 list->tail->start + list->tail->count - 1));
+    }
+    list->tail->count--;
+    list->count--;
+    if (list->tail->count == 0) {
+        ulist_drop_node(list, list->tail);
+    }
+}
+
+/**
+ * removes every element of the unrolled list and drops its hash index, if
+ * any
+ *
+ * returns nothing
+ */
+void ulist_clear(ulist_t* list) {
+    ulist_node_t* curr = list->head;
+    while (curr) {
+        ulist_node_t* next = curr->next;
+        game_free(curr);
+        curr = next;
+    }
+    game_free(list->index);
+    ulist_init(list);
+}
+
+/**
+ * starts keeping a hash index of the unrolled list's payloads, built from
+ * its current contents; every later insert and remove keeps it up to date.
+ * The list's element size must be known, so call this after the first
+ * insert or set `elem_size` first
+ *
+ * returns nothing
+ */
+void ulist_enable_index(ulist_t* list) {
+    if (list->index) {
+        return;
+    }
+    size_t cap = 16;
+    while (cap < (size_t)list->count * 2) {
+        cap *= 2;
+    }
+    ulist_index_rebuild(list, cap);
+}
+
+/**
+ * checks whether the unrolled list holds an element equal (by memcmp of
+ * `size` bytes) to `value`; O(1) expected with a hash index, O(n) without
+ *
+ * returns 1 if it does, 0 otherwise
+ */
+int ulist_contains(ulist_t* list, void* value, size_t size) {
+    if (list->count == 0) {
+        return 0;
+    }
+    if (list->index) {
+        return ulist_index_find(list, value) != NULL;
+    }
+    for (ulist_node_t* curr = list->head; curr; curr = curr->next) {
+        for (int i = 0; i < curr->count; i++) {
+            if (!memcmp(ulist_slot(list, curr, curr->start + i), value, size)) {
+                return 1;
+            }
+        }
+    }
+    return 0;
 }
@@ -2,6 +2,7 @@
 #define LINKED_LIST_H
 
 #include <stddef.h>
+#include <stdint.h>
 
 // struct for a node in a doubly linked list
 typedef struct node {
@@ -24,4 +25,65 @@ void reverse(node_t** head_list);
 void remove_first(node_t** head_list);
 void remove_last(node_t** head_list);
 
+// payloads stored per node of an unrolled list
+#define ULIST_NODE_CAP 16
+
+// A node of an unrolled list: slots [start, start + count) of the
+// ULIST_NODE_CAP payload slots that follow it in memory are in use.
+typedef struct ulist_node {
+    struct ulist_node* next;
+    struct ulist_node* prev;
+    int start;
+    int count;
+} ulist_node_t;
+
+// An entry of an unrolled list's hash index: where one payload lives, and
+// the hash of its bytes. `node` is NULL for an empty entry.
+typedef struct ulist_entry {
+    ulist_node_t* node;
+    int slot;
+    uint64_t hash;
+} ulist_entry_t;
+
+/** An unrolled doubly linked list: payloads are stored several to a node,
+ * and the list keeps its tail and length, so length, first and last access
+ * are O(1) and indexed access is O(n / ULIST_NODE_CAP).
+ *
+ * All payloads in a list have the same size, set by the first insert. A
+ * zeroed ulist_t is an empty list.
+ *
+ * A list can optionally keep a hash index from payload bytes to where they
+ * are stored (see ulist_enable_index()), making ulist_contains() and
+ * ulist_remove_element() O(1) expected instead of O(n).
+ * Fields:
+ *  - head, tail: first and last nodes, or NULL if empty
+ *  - count: number of payloads
+ *  - elem_size: size of each payload
+ *  - index: open-addressing table of index_cap entries, or NULL for none
+ *  - index_cap: size of `index`, a power of two
+ */
+typedef struct ulist {
+    ulist_node_t* head;
+    ulist_node_t* tail;
+    int count;
+    size_t elem_size;
+    ulist_entry_t* index;
+    size_t index_cap;
+} ulist_t;
+
+void ulist_init(ulist_t* list);
+int ulist_length(ulist_t* list);
+void* ulist_get_first(ulist_t* list);
+void* ulist_get_last(ulist_t* list);
+void ulist_insert_first(ulist_t* list, void* to_add, size_t size);
+void ulist_insert_last(ulist_t* list, void* to_add, size_t size);
+void* ulist_get(ulist_t* list, int index);
+int ulist_remove_element(ulist_t* list, void* to_remove, size_t size);
+void ulist_reverse(ulist_t* list);
+void ulist_remove_first(ulist_t* list);
+void ulist_remove_last(ulist_t* list);
+void ulist_clear(ulist_t* list);
+void ulist_enable_index(ulist_t* list);
+int ulist_contains(ulist_t* list, void* value, size_t size);
+
 #endif
@@ -0,0 +1,415 @@
+#include "multi_snake.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "common.h"
+#include "delta.h"
+#include "food_index.h"
+#include "game.h"
+#include "game_setup.h"
+#include "snake_body.h"
+
+/* Writes a cell, recording the change in g_delta if set.
+ */
+static inline void put_cell(multi_game_t* game, size_t pos, int value) {
+    if (g_delta != NULL) {
+        delta_touch(g_delta, game->cells, pos);
+    }
+    game->cells[pos] = value;
+}
+
+/* Returns the current tick's entry for cell `pos` in the move table,
+   starting a fresh one if there is none. Entries from earlier ticks count as
+   empty, so the table never needs clearing.
+*/
+static multi_cell_t* cell_entry(multi_game_t* game, size_t pos) {
+    size_t i = (size_t)(((uint64_t)pos * 0x9e3779b97f4a7c15ull) >> 32) &
+               game->table_mask;
+    for (;; i = (i + 1) & game->table_mask) {
+        multi_cell_t* entry = &game->table[i];
+        if (entry->tick != game->tick) {
+            entry->pos = pos;
+            entry->tick = game->tick;
+            entry->head_of = -1;
+            entry->tail_of = -1;
+            entry->movers = 0;
+            entry->best_len = 0;
+            entry->num_best = 0;
+            return entry;
+        }
+        if (entry->pos == pos) {
+            return entry;
+        }
+    }
+}
+
+/* Returns 1 if a snake may be placed on `pos`: it's empty or grass. */
+static int is_open(multi_game_t* game, size_t pos) {
+    return game->cells[pos] == PLAIN_CELL || game->cells[pos] == FLAG_GRASS;
+}
+
+/** Initializes a multi-snake game. The board's own snake becomes snake 0,
+ * moving right, and food is placed as initialize_game() would.
+ *
+ * Returns the status of decoding the board. On failure, nothing is left
+ * allocated.
+ *
+ * Arguments:
+ *  - game: the game to initialize.
+ *  - board_rep: a string representing the initial board. May be NULL for
+ *    default board. It is copied, not modified.
+ *  - max_snakes: the most snakes the game can hold, dead or alive.
+ *  - growing: 0 if snakes do not grow on eating, 1 if they do.
+ */
+enum board_init_status multi_init(multi_game_t* game, char* board_rep,
+                                  size_t max_snakes, int growing) {
+    memset(game, 0, sizeof(*game));
+    snake_t first;
+    snake_body_init(&first.snake_pos);
+    enum board_init_status status;
+    if (board_rep == NULL) {
+        status =
+            initialize_default_board(&game->cells, &game->width, &game->height);
+        int init_pos = cell_index(2, 2, 20);
+        snake_body_push_head(&first.snake_pos, RIGHT, init_pos);
+    } else {
+        char* copy = strdup(board_rep);
+        status = decompress_board_str(&game->cells, &game->width,
+                                      &game->height, &first, copy);
+        free(copy);
+    }
+    if (status != INIT_SUCCESS) {
+        snake_body_clear(&first.snake_pos);
+        game_free(game->cells);
+        memset(game, 0, sizeof(*game));
+        return status;
+    }
+
+    if (max_snakes == 0) {
+        max_snakes = 1;
+    }
+    game->growing = growing;
+    game->max_snakes = max_snakes;
+    game->snakes = calloc(max_snakes, sizeof(multi_snake_t));
+    game->moves = malloc(max_snakes * sizeof(multi_move_t));
+    // each move looks up three cells; keep the table at most half full
+    size_t table_size = 16;
+    while (table_size < 6 * max_snakes) {
+        table_size *= 2;
+    }
+    game->table = calloc(table_size, sizeof(multi_cell_t));
+    game->table_mask = table_size - 1;
+
+    first.snake_dir = RIGHT;
+    game->snakes[0].snake = first;
+    game->snakes[0].alive = 1;
+    game->num_snakes = 1;
+    game->num_alive = 1;
+    food_index_select();
+    if (g_food_index != NULL) {
+        food_index_init(g_food_index, game->width, game->height);
+    }
+    size_t food = g_food_count > 0 ? (size_t)g_food_count : 0;
+    place_start_food(game->cells, game->width, game->height,
+                     count_free_cells(game->cells, game->width, game->height,
+                                      food));
+    return INIT_SUCCESS;
+}
+
+/** Adds a one-cell snake at `pos`, moving in `dir`. Ids of dead snakes are
+ * reused once every slot has been taken.
+ *
+ * Returns the new snake's id, or -1 if the cell is taken or the game is
+ * full.
+ */
+int multi_add_snake(multi_game_t* game, size_t pos, enum direction dir) {
+    if (!is_open(game, pos)) {
+        return -1;
+    }
+    size_t id = game->num_snakes;
+    if (id == game->max_snakes) {
+        for (id = 0; id < game->num_snakes && game->snakes[id].alive; id++) {
+        }
+        if (id == game->num_snakes) {
+            return -1;
+        }
+    }
+    multi_snake_t* ms = &game->snakes[id];
+    snake_body_clear(&ms->snake.snake_pos);
+    memset(ms, 0, sizeof(*ms));
+    snake_body_init(&ms->snake.snake_pos);
+    int head = (int)pos;
+    snake_body_push_head(&ms->snake.snake_pos, RIGHT, head);
+    ms->snake.snake_dir = dir;
+    ms->alive = 1;
+    put_cell(game, pos, game->cells[pos] | FLAG_SNAKE);
+    game->num_alive++;
+    if (id == game->num_snakes) {
+        game->num_snakes++;
+    }
+    return (int)id;
+}
+
+/** Adds a snake at a random open cell, facing an open neighbour.
+ *
+ * Returns the new snake's id, or -1 if no spot was found or the game is
+ * full.
+ */
+int multi_spawn(multi_game_t* game) {
+    for (int tries = 0; tries < 64; tries++) {
+        unsigned index = generate_index(game->width * game->height);
+        size_t pos = cell_index(index / game->width, index % game->width,
+                                game->width);
+        if (!is_open(game, pos)) {
+            continue;
+        }
+        for (int dir = UP; dir <= RIGHT; dir++) {
+            if (is_open(game, cell_neighbour(game->cells, pos, dir,
+                                             game->width))) {
+                return multi_add_snake(game, pos, dir);
+            }
+        }
+    }
+    return -1;
+}
+
+/* Takes a snake's tail off the board and moves it up one segment. */
+static void pop_tail(multi_game_t* game, snake_body_t* body) {
+    size_t tail = body->tail;
+    put_cell(game, tail, game->cells[tail] & ~FLAG_SNAKE);
+    size_t next = body->length > 1
+                      ? cell_neighbour(game->cells, tail,
+                                       snake_body_tail_dir(body), game->width)
+                      : tail;
+    snake_body_pop_tail(body, next);
+}
+
+/* Removes a dead snake's body from the board. */
+static void remove_snake(multi_game_t* game, multi_snake_t* ms) {
+    snake_body_t* body = &ms->snake.snake_pos;
+    while (body->length > 0) {
+        pop_tail(game, body);
+    }
+    ms->alive = 0;
+    game->num_alive--;
+}
+
+/** Kills snake `id` (for example, when its player leaves) and takes it off
+ * the board. Does nothing if it is already dead.
+ */
+void multi_remove_snake(multi_game_t* game, size_t id) {
+    if (id < game->num_snakes && game->snakes[id].alive) {
+        remove_snake(game, &game->snakes[id]);
+    }
+}
+
+/** Advances every living snake by one step, all at once.
+ *
+ * Moves are planned into a buffer first, then resolved together, so no
+ * snake sees another's move from the same tick. A snake dies if its head
+ * moves into a wall, into any snake's body (a tail that moves away this tick
+ * doesn't count), or into the same cell as another head, or swaps cells
+ * with one. When heads meet, the longest snake survives; if there is a tie,
+ * all of them die. Dead snakes are removed from the board. A head that
+ * lands on food scores for its snake, which grows if the game is growing.
+ *
+ * The work is proportional to the number of living snakes, plus the length
+ * of any that die.
+ *
+ * Arguments:
+ *  - game: the game.
+ *  - inputs: one input per snake, indexed by id. Dead snakes' are ignored.
+ */
+void multi_step(multi_game_t* game, const enum input_key* inputs) {
+    int* cells = game->cells;
+    size_t num_moves = 0;
+    game->tick++;
+
+    // plan every move, noting each head, each tail that will move away and
+    // how many heads (and how long a snake) go into each target
+    for (size_t id = 0; id < game->num_snakes; id++) {
+        multi_snake_t* ms = &game->snakes[id];
+        if (!ms->alive) {
+            continue;
+        }
+        snake_t* snake_p = &ms->snake;
+        switch (inputs[id]) {
+            case INPUT_NONE:
+                break;
+            case INPUT_RIGHT:
+                snake_p->snake_dir = RIGHT;
+                break;
+            case INPUT_LEFT:
+                snake_p->snake_dir = LEFT;
+                break;
+            case INPUT_UP:
+                snake_p->snake_dir = UP;
+                break;
+            case INPUT_DOWN:
+                snake_p->snake_dir = DOWN;
+                break;
+        }
+        size_t head = snake_p->snake_pos.head;
+        size_t tail = snake_p->snake_pos.tail;
+        multi_move_t* move = &game->moves[num_moves];
+        move->id = id;
+        move->target =
+            cell_neighbour(cells, head, snake_p->snake_dir, game->width);
+        move->eats = game->growing && (cells[move->target] & FLAG_FOOD);
+        move->dies = 0;
+
+        cell_entry(game, head)->head_of = (int32_t)num_moves;
+        if (!move->eats) {
+            cell_entry(game, tail)->tail_of = (int32_t)id;
+        }
+        multi_cell_t* target = cell_entry(game, move->target);
+        uint32_t len = (uint32_t)snake_p->snake_pos.length;
+        target->movers++;
+        if (len > target->best_len) {
+            target->best_len = len;
+            target->num_best = 1;
+        } else if (len == target->best_len) {
+            target->num_best++;
+        }
+        num_moves++;
+    }
+
+    // decide who dies, against the board as it was at the start of the tick
+    for (size_t i = 0; i < num_moves; i++) {
+        multi_move_t* move = &game->moves[i];
+        int cell = cells[move->target];
+        multi_cell_t* target = cell_entry(game, move->target);
+        uint32_t len = (uint32_t)game->snakes[move->id].snake.snake_pos.length;
+        if (cell & FLAG_WALL) {
+            move->dies = 1;
+        } else if (target->movers > 1 &&
+                   (len < target->best_len || target->num_best > 1)) {
+            move->dies = 1;  // lost a head-to-head
+        } else if (target->head_of >= 0 && (size_t)target->head_of != i &&
+                   game->moves[target->head_of].target ==
+                       game->snakes[move->id].snake.snake_pos.head) {
+            // two heads swapping cells meet head-on too
+            multi_move_t* other = &game->moves[target->head_of];
+            uint32_t other_len =
+                (uint32_t)game->snakes[other->id].snake.snake_pos.length;
+            move->dies = len <= other_len;
+        } else if ((cell & FLAG_SNAKE) && target->tail_of < 0) {
+            move->dies = 1;
+        }
+    }
+
+    // take the dead off the board, then move everyone else's tail before any
+    // head, so heads can follow tails
+    for (size_t i = 0; i < num_moves; i++) {
+        if (game->moves[i].dies) {
+            remove_snake(game, &game->snakes[game->moves[i].id]);
+        }
+    }
+    for (size_t i = 0; i < num_moves; i++) {
+        multi_move_t* move = &game->moves[i];
+        if (!move->dies && !move->eats) {
+            pop_tail(game, &game->snakes[move->id].snake.snake_pos);
+        }
+    }
+    int eaten = 0;
+    for (size_t i = 0; i < num_moves; i++) {
+        multi_move_t* move = &game->moves[i];
+        if (move->dies) {
+            continue;
+        }
+        multi_snake_t* ms = &game->snakes[move->id];
+        int head = (int)move->target;
+        int cell = cells[head] | FLAG_SNAKE;
+        if (cell & FLAG_FOOD) {
+            cell ^= FLAG_FOOD;
+            ms->score++;
+            eaten++;
+            if (g_food_index != NULL) {
+                food_index_remove(g_food_index, head);
+            }
+        }
+        put_cell(game, head, cell);
+        snake_body_push_head(&ms->snake.snake_pos, ms->snake.snake_dir, head);
+    }
+    for (int i = 0; i < eaten; i++) {
+        place_food(cells, game->width, game->height);
+    }
+}
+
+/* Returns the Manhattan distance between cell positions `a` and `b`.
+ */
+static size_t cell_distance(size_t a, size_t b, size_t width) {
+    size_t row_a = cell_row(a, width);
+    size_t row_b = cell_row(b, width);
+    size_t col_a = cell_col(a, width);
+    size_t col_b = cell_col(b, width);
+    return (row_a > row_b ? row_a - row_b : row_b - row_a) +
+           (col_a > col_b ? col_a - col_b : col_b - col_a);
+}
+
+/** Picks a move for a simple bot: food next to the head if there is any,
+ * else a safe move towards the nearest food if g_food_index knows where
+ * that is (straight on if it's one), else straight on if that is safe,
+ * else any safe turn.
+ */
+enum input_key multi_bot_input(multi_game_t* game, size_t id) {
+    static const enum input_key keys[] = {INPUT_UP, INPUT_DOWN, INPUT_LEFT,
+                                          INPUT_RIGHT};
+    snake_t* snake_p = &game->snakes[id].snake;
+    size_t head = snake_p->snake_pos.head;
+    int safe[4];
+    int num_safe = 0;
+    for (int dir = UP; dir <= RIGHT; dir++) {
+        int cell =
+            game->cells[cell_neighbour(game->cells, head, dir, game->width)];
+        if (cell & FLAG_FOOD) {
+            return keys[dir];
+        }
+        if (!(cell & (FLAG_WALL | FLAG_SNAKE))) {
+            safe[num_safe++] = dir;
+        }
+    }
+    size_t food;
+    if (num_safe > 0 && g_food_index != NULL &&
+        food_index_nearest(g_food_index, head, &food)) {
+        size_t now = cell_distance(head, food, game->width);
+        int closer = -1;
+        for (int i = 0; i < num_safe; i++) {
+            size_t next = cell_neighbour(game->cells, head, safe[i],
+                                         game->width);
+            if (cell_distance(next, food, game->width) < now &&
+                (closer < 0 || safe[i] == (int)snake_p->snake_dir)) {
+                closer = safe[i];
+            }
+        }
+        if (closer >= 0) {
+            return closer == (int)snake_p->snake_dir ? INPUT_NONE
+                                                     : keys[closer];
+        }
+    }
+    for (int i = 0; i < num_safe; i++) {
+        if (safe[i] == (int)snake_p->snake_dir) {
+            return INPUT_NONE;
+        }
+    }
+    return num_safe ? keys[safe[generate_index(num_safe)]] : INPUT_NONE;
+}
+
+/** Frees all memory held by the game, and g_food_index's contents as
+ * teardown() does.
+ */
+void multi_teardown(multi_game_t* game) {
+    if (g_food_index != NULL) {
+        food_index_free(g_food_index);
+    }
+    for (size_t i = 0; i < game->num_snakes; i++) {
+        snake_body_clear(&game->snakes[i].snake.snake_pos);
+    }
+    game_free(game->cells);
+    free(game->snakes);
+    free(game->moves);
+    free(game->table);
+    memset(game, 0, sizeof(*game));
+}
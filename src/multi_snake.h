@@ -0,0 +1,82 @@
+#ifndef MULTI_SNAKE_H
+#define MULTI_SNAKE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "game_setup.h"
+
+/** One snake in a multi-snake game.
+ * Fields:
+ *  - snake: direction and body, head first
+ *  - score: food eaten by this snake
+ *  - alive: 1 until the snake dies; dead snakes are off the board
+ */
+typedef struct multi_snake {
+    snake_t snake;
+    int score;
+    int alive;
+} multi_snake_t;
+
+/** A move planned for the current tick.
+ * Fields:
+ *  - id: the snake moving
+ *  - target: the cell its head moves into
+ *  - eats: 1 if it grows into food there, so its tail stays put
+ *  - dies: 1 once the move is known to kill it
+ */
+typedef struct multi_move {
+    uint32_t id;
+    size_t target;
+    int eats;
+    int dies;
+} multi_move_t;
+
+// Cells a tick looks up: every mover's head, tail and target.
+typedef struct multi_cell {
+    size_t pos;
+    uint64_t tick;      // the tick this entry was written in; older is empty
+    int32_t head_of;    // snake whose head is here, or -1
+    int32_t tail_of;    // snake whose tail leaves here this tick, or -1
+    uint32_t movers;    // number of heads moving here
+    uint32_t best_len;  // longest snake moving here
+    uint32_t num_best;  // number of movers that long
+} multi_cell_t;
+
+/** A board shared by several snakes that all move at once.
+ * Fields:
+ *  - cells, width, height: the board, as for a single-snake game
+ *  - growing: 1 if snakes grow on eating, 0 otherwise
+ *  - snakes: every snake added so far, dead or alive, indexed by id
+ *  - num_snakes, max_snakes: number of snakes and capacity of `snakes`
+ *  - num_alive: number of snakes still alive
+ *  - moves: the move buffer, one entry per living snake
+ *  - table, table_mask: per-tick hash of the cells the moves touch
+ *  - tick: number of ticks played
+ */
+typedef struct multi_game {
+    int* cells;
+    size_t width;
+    size_t height;
+    int growing;
+    multi_snake_t* snakes;
+    size_t num_snakes;
+    size_t max_snakes;
+    size_t num_alive;
+    multi_move_t* moves;
+    multi_cell_t* table;
+    size_t table_mask;
+    uint64_t tick;
+} multi_game_t;
+
+enum board_init_status multi_init(multi_game_t* game, char* board_rep,
+                                  size_t max_snakes, int growing);
+int multi_add_snake(multi_game_t* game, size_t pos, enum direction dir);
+int multi_spawn(multi_game_t* game);
+void multi_remove_snake(multi_game_t* game, size_t id);
+void multi_step(multi_game_t* game, const enum input_key* inputs);
+enum input_key multi_bot_input(multi_game_t* game, size_t id);
+void multi_teardown(multi_game_t* game);
+
+#endif
@@ -0,0 +1,172 @@
+#include "net_proto.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+
+/** Returns the CLOCK_MONOTONIC time in nanoseconds. It is the same clock in
+ * every process on the host, so a client can time a server's messages.
+ */
+uint64_t net_now_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1000000000ull + (uint64_t)now.tv_nsec;
+}
+
+/* Fills in a socket address for `path`. Returns -1 if the path is too long.
+ */
+static int make_address(struct sockaddr_un* addr, const char* path) {
+    memset(addr, 0, sizeof(*addr));
+    addr->sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr->sun_path)) {
+        return -1;
+    }
+    strcpy(addr->sun_path, path);
+    return 0;
+}
+
+/* Makes a socket non-blocking and close-on-exec. */
+static int make_nonblocking(int fd) {
+    if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) < 0 ||
+        fcntl(fd, F_SETFD, FD_CLOEXEC) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** Listens for clients at socket path `path`, replacing any stale socket
+ * file left there.
+ *
+ * Returns the non-blocking listening socket, or -1 on failure.
+ */
+int net_listen(const char* path) {
+    struct sockaddr_un addr;
+    if (make_address(&addr, path) < 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    unlink(path);
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+        listen(fd, SOMAXCONN) < 0) {
+        close(fd);
+        return -1;
+    }
+    return make_nonblocking(fd);
+}
+
+/** Accepts a waiting client.
+ *
+ * Returns the client's non-blocking socket, or -1 if none is waiting.
+ */
+int net_accept(int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    return fd < 0 ? -1 : make_nonblocking(fd);
+}
+
+/** Connects to a server at socket path `path`.
+ *
+ * Returns the non-blocking socket, or -1 on failure.
+ */
+int net_connect(const char* path) {
+    struct sockaddr_un addr;
+    if (make_address(&addr, path) < 0) {
+        return -1;
+    }
+    int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return make_nonblocking(fd);
+}
+
+/** Writes `value` as a varint. Returns the number of bytes written (at most
+ * 10).
+ */
+size_t net_put_varint(unsigned char* buf, uint64_t value) {
+    size_t len = 0;
+    do {
+        buf[len] = (unsigned char)(value & 0x7f);
+        value >>= 7;
+        buf[len] |= value ? 0x80 : 0;
+        len++;
+    } while (value);
+    return len;
+}
+
+/** Reads a varint at *p, advancing *p past it.
+ *
+ * Returns 0 on success and -1 if it runs past `end`.
+ */
+int net_get_varint(const unsigned char** p, const unsigned char* end,
+                   uint64_t* value_p) {
+    uint64_t value = 0;
+    for (unsigned shift = 0; shift < 64 && *p < end; shift += 7) {
+        unsigned char c = *(*p)++;
+        value |= (uint64_t)(c & 0x7f) << shift;
+        if (!(c & 0x80)) {
+            *value_p = value;
+            return 0;
+        }
+    }
+    return -1;
+}
+
+/** Writes a NET_INPUT message. Returns its length.
+ */
+size_t net_encode_input(unsigned char* buf, enum input_key key, uint32_t seq) {
+    buf[0] = NET_INPUT;
+    buf[1] = (unsigned char)key;
+    return 2 + net_put_varint(buf + 2, seq);
+}
+
+/** Writes the start of a NET_TICK message: the type byte and `tick`. The
+ * tick's delta record follows. Returns the length written, at most
+ * NET_MAX_HEADER.
+ */
+size_t net_encode_tick(unsigned char* buf, const net_tick_t* tick) {
+    size_t len = 0;
+    buf[len++] = NET_TICK;
+    len += net_put_varint(buf + len, tick->tick);
+    len += net_put_varint(buf + len, (uint64_t)(tick->id + 1));
+    len += net_put_varint(buf + len, (uint64_t)tick->alive);
+    len += net_put_varint(buf + len, (uint64_t)tick->score);
+    len += net_put_varint(buf + len, tick->ack_seq);
+    len += net_put_varint(buf + len, tick->sent_ns);
+    return len;
+}
+
+/** Reads the start of a NET_TICK message. The delta record starts
+ * *header_len_p bytes in.
+ *
+ * Returns 0 on success and -1 if the message is not a well-formed tick.
+ */
+int net_decode_tick(const unsigned char* msg, size_t len, net_tick_t* tick,
+                    size_t* header_len_p) {
+    const unsigned char* p = msg + 1;
+    const unsigned char* end = msg + len;
+    uint64_t id, alive, score, ack_seq;
+    if (len == 0 || msg[0] != NET_TICK ||
+        net_get_varint(&p, end, &tick->tick) ||
+        net_get_varint(&p, end, &id) || net_get_varint(&p, end, &alive) ||
+        net_get_varint(&p, end, &score) || net_get_varint(&p, end, &ack_seq) ||
+        net_get_varint(&p, end, &tick->sent_ns)) {
+        return -1;
+    }
+    tick->id = (int)id - 1;
+    tick->alive = (int)alive;
+    tick->score = (int)score;
+    tick->ack_seq = (uint32_t)ack_seq;
+    *header_len_p = (size_t)(p - msg);
+    return 0;
+}
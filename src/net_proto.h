@@ -0,0 +1,67 @@
+#ifndef NET_PROTO_H
+#define NET_PROTO_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/** Messages between snake-server and its clients. Each is one packet on an
+ * AF_UNIX SOCK_SEQPACKET socket, starting with a type byte; numbers are
+ * LEB128 varints.
+ *
+ *  - NET_HELLO (client): the player's name, not NUL-terminated
+ *  - NET_INPUT (client): key (an enum input_key byte), sequence number
+ *  - NET_WELCOME (server): the client's snake id + 1 (0 if none yet), the
+ *    length of the keyframe, then its first bytes. The keyframe is the board
+ *    as the header and keyframe of a delta stream (see delta.c).
+ *  - NET_KEYFRAME (server): the next bytes of the keyframe, in as many
+ *    packets as it takes, straight after the welcome
+ *  - NET_TICK (server): a net_tick_t, then the tick's delta stream record,
+ *    which is the same for every client
+ */
+enum net_message {
+    NET_HELLO = 1,
+    NET_INPUT,
+    NET_WELCOME,
+    NET_TICK,
+    NET_KEYFRAME
+};
+
+#define NET_MAX_HEADER 64           // room for the type byte and a net_tick_t
+#define NET_MAX_NAME 64             // bytes of player name the server keeps
+#define NET_MAX_PACKET (1 << 20)    // the largest packet a client reads
+#define NET_KEYFRAME_CHUNK (1 << 15)  // keyframe bytes per welcome packet
+
+/** What a tick means for one client.
+ * Fields:
+ *  - tick: tick number
+ *  - id: the client's snake, or -1 while it waits to spawn
+ *  - alive: 1 if that snake is alive
+ *  - score: the snake's score
+ *  - ack_seq: sequence number of the client's last input read before the
+ *    tick was played
+ *  - sent_ns: the server's CLOCK_MONOTONIC time when the tick started
+ */
+typedef struct net_tick {
+    uint64_t tick;
+    int id;
+    int alive;
+    int score;
+    uint32_t ack_seq;
+    uint64_t sent_ns;
+} net_tick_t;
+
+uint64_t net_now_ns(void);
+int net_listen(const char* path);
+int net_accept(int listen_fd);
+int net_connect(const char* path);
+size_t net_put_varint(unsigned char* buf, uint64_t value);
+int net_get_varint(const unsigned char** p, const unsigned char* end,
+                   uint64_t* value_p);
+size_t net_encode_input(unsigned char* buf, enum input_key key, uint32_t seq);
+size_t net_encode_tick(unsigned char* buf, const net_tick_t* tick);
+int net_decode_tick(const unsigned char* msg, size_t len, net_tick_t* tick,
+                    size_t* header_len_p);
+
+#endif
@@ -0,0 +1,434 @@
+#include "parallel_decode.h"
+
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "arena.h"
+
+// With num_threads == 0, one thread is used per this many bytes of board
+// string (up to the number of cores); smaller strings aren't worth splitting.
+#define BYTES_PER_THREAD (PARALLEL_DECODE_MIN_LEN / 2)
+#define MAX_THREADS 64
+
+// A position after every character, for "no error here".
+#define NO_ERROR SIZE_MAX
+
+// Where the `|`-separated tokens of the string start. Tokens are non-empty,
+// like the ones strtok() gives the serial decoder.
+typedef struct token_list {
+    size_t* starts;
+    size_t len;
+    size_t cap;
+} token_list_t;
+
+// Work for one thread. The scan phase fills `tokens` from the bytes
+// [lo, hi); the decode phases work on the rows [first_row, end_row).
+typedef struct chunk {
+    const char* str;
+    size_t str_len;
+    size_t lo;
+    size_t hi;
+    token_list_t tokens;
+
+    const size_t* row_starts;  // row r starts at str + row_starts[r]
+    size_t num_tokens;         // the header and the rows
+    size_t first_row;
+    size_t end_row;
+    int* cells;
+    int width;
+
+    // last letter of the chunk's rows, 0 if there is none
+    char last_letter;
+    // cell type in force at the start of the chunk
+    int in_flag;
+
+    // results. A run of S cells is checked against the snake count so far,
+    // which at the start of the chunk is 0 (no snake yet) or 1; both cases
+    // are decoded, [0] and [1]. Errors are byte offsets into the string.
+    size_t err_pos;  // first bad character or wrong row width
+    enum board_init_status err;
+    size_t snake_err_pos[2];
+    long long snake_total[2];
+    int has_snake;  // whether the chunk has an S run
+    size_t snake_pos;  // position of its last S run
+} chunk_t;
+
+/* Records a token start, growing the list as needed. Returns -1 if out of
+   memory.
+*/
+static int push_token(token_list_t* list, size_t start) {
+    if (list->len == list->cap) {
+        size_t cap = list->cap ? list->cap * 2 : 1024;
+        size_t* starts = realloc(list->starts, cap * sizeof(size_t));
+        if (starts == NULL) {
+            return -1;
+        }
+        list->starts = starts;
+        list->cap = cap;
+    }
+    list->starts[list->len++] = start;
+    return 0;
+}
+
+/* Finds the tokens that start in [lo, hi). memchr() does the searching; it
+   compares a vector's worth of bytes at a time.
+*/
+static void* scan_tokens(void* arg) {
+    chunk_t* chunk = arg;
+    const char* str = chunk->str;
+    size_t pos = chunk->lo;
+    if (pos == 0 && chunk->hi > 0 && str[0] != '|') {
+        if (push_token(&chunk->tokens, 0) < 0) {
+            return chunk;
+        }
+    }
+    while (pos < chunk->hi) {
+        const char* bar = memchr(str + pos, '|', chunk->hi - pos);
+        if (bar == NULL) {
+            break;
+        }
+        pos = (size_t)(bar - str) + 1;
+        if (pos < chunk->str_len && str[pos] != '|') {
+            if (push_token(&chunk->tokens, pos) < 0) {
+                return chunk;
+            }
+        }
+    }
+    return NULL;
+}
+
+/* Finds the last letter in the chunk's rows. The `|`s between them are not
+   letters, so the rows can be searched as one span.
+*/
+static void* find_last_letter(void* arg) {
+    chunk_t* chunk = arg;
+    const char* first = chunk->str + chunk->row_starts[chunk->first_row];
+    const char* c = chunk->str + (chunk->end_row < chunk->num_tokens
+                                      ? chunk->row_starts[chunk->end_row]
+                                      : chunk->str_len);
+    chunk->last_letter = 0;
+    while (c > first) {
+        c--;
+        if ((*c >= 'A' && *c <= 'Z') || (*c >= 'a' && *c <= 'z')) {
+            chunk->last_letter = *c;
+            break;
+        }
+    }
+    return NULL;
+}
+
+/* Notes a run of S cells at `pos` (a byte offset) for both possible snake
+   counts at the start of the chunk.
+*/
+static void count_snake(chunk_t* chunk, int num_cells, size_t pos) {
+    for (int i = 0; i < 2; i++) {
+        if (chunk->snake_err_pos[i] != NO_ERROR) {
+            continue;
+        }
+        chunk->snake_total[i] += num_cells;
+        if (chunk->snake_total[i] != 1) {
+            chunk->snake_err_pos[i] = pos;
+        }
+    }
+}
+
+/* Decodes the chunk's rows into their slice of the cells array, with the
+   same rules as decompress_rows() in game_setup.c. Decoding stops at the
+   first bad character or row width, or once a snake count error is certain.
+*/
+static void* decode_chunk(void* arg) {
+    chunk_t* chunk = arg;
+    const char* str = chunk->str;
+    int width = chunk->width;
+    int curr_flag = chunk->in_flag;
+    chunk->err_pos = NO_ERROR;
+    chunk->snake_err_pos[0] = NO_ERROR;
+    chunk->snake_err_pos[1] = NO_ERROR;
+    chunk->snake_total[0] = 0;
+    chunk->snake_total[1] = 1;
+    chunk->has_snake = 0;
+
+    for (size_t row = chunk->first_row; row < chunk->end_row; row++) {
+        const char* c = str + chunk->row_starts[row];
+        int col_index = 0;
+        while (*c != '|' && *c != '\0') {
+            if ((*c >= 'A' && *c <= 'Z') || (*c >= 'a' && *c <= 'z')) {
+                curr_flag = check_row_char(*c);
+                if (curr_flag == -1) {
+                    chunk->err_pos = (size_t)(c - str);
+                    chunk->err = INIT_ERR_BAD_CHAR;
+                    return NULL;
+                }
+                c++;
+                continue;
+            }
+            if (*c < '0' || *c > '9') {
+                c++;
+                continue;
+            }
+            const char* run = c;
+            while (*c >= '0' && *c <= '9') {
+                c++;
+            }
+            if (curr_flag == -1) {
+                chunk->err_pos = (size_t)(run - str);
+                chunk->err = INIT_ERR_BAD_CHAR;
+                return NULL;
+            }
+            int num_cells = atoi(run);
+            if (curr_flag == FLAG_SNAKE) {
+                count_snake(chunk, num_cells, (size_t)(run - str));
+                if (chunk->snake_err_pos[0] != NO_ERROR &&
+                    chunk->snake_err_pos[1] != NO_ERROR) {
+                    return NULL;
+                }
+                chunk->has_snake = 1;
+                chunk->snake_pos = cell_index(row - 1, col_index, width);
+            }
+            int room = width - col_index;
+            int first = col_index < 0 ? -col_index : 0;
+            int count = num_cells < room ? num_cells : room;
+            for (int i = first; i < count; i++) {
+                chunk->cells[cell_index(row - 1, col_index + i, width)] =
+                    curr_flag;
+            }
+            col_index += num_cells;
+        }
+        if (col_index != width) {
+            chunk->err_pos = (size_t)(c - str);
+            chunk->err = INIT_ERR_INCORRECT_DIMENSIONS;
+            return NULL;
+        }
+    }
+    return NULL;
+}
+
+/* Runs fn on each chunk, one thread per chunk after the first, which runs on
+   the calling thread. Returns -1 if some call returned non-NULL.
+*/
+static int run_chunks(void* (*fn)(void*), chunk_t* chunks, int num_chunks) {
+    pthread_t threads[MAX_THREADS];
+    int started[MAX_THREADS];
+    int failed = 0;
+    for (int i = 1; i < num_chunks; i++) {
+        started[i] = pthread_create(&threads[i], NULL, fn, &chunks[i]) == 0;
+        if (!started[i]) {
+            failed |= fn(&chunks[i]) != NULL;
+        }
+    }
+    failed |= num_chunks > 0 && fn(&chunks[0]) != NULL;
+    for (int i = 1; i < num_chunks; i++) {
+        void* result = NULL;
+        if (started[i]) {
+            pthread_join(threads[i], &result);
+            failed |= result != NULL;
+        }
+    }
+    return failed ? -1 : 0;
+}
+
+/* Number of threads to use for a string of `len` bytes. */
+static int pick_threads(int num_threads, size_t len) {
+    if (num_threads <= 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        size_t by_size = len / BYTES_PER_THREAD + 1;
+        num_threads = cores < 1 ? 1 : (int)cores;
+        if ((size_t)num_threads > by_size) {
+            num_threads = (int)by_size;
+        }
+    }
+    return num_threads > MAX_THREADS ? MAX_THREADS : num_threads;
+}
+
+/* Joins the chunks' token lists into chunks[0].tokens. Returns -1 if out of
+   memory.
+*/
+static int join_tokens(chunk_t* chunks, int num_chunks) {
+    token_list_t* all = &chunks[0].tokens;
+    size_t total = 0;
+    for (int i = 0; i < num_chunks; i++) {
+        total += chunks[i].tokens.len;
+    }
+    if (total > all->cap) {
+        size_t* starts = realloc(all->starts, total * sizeof(size_t));
+        if (starts == NULL) {
+            return -1;
+        }
+        all->starts = starts;
+        all->cap = total;
+    }
+    for (int i = 1; i < num_chunks; i++) {
+        memcpy(all->starts + all->len, chunks[i].tokens.starts,
+               chunks[i].tokens.len * sizeof(size_t));
+        all->len += chunks[i].tokens.len;
+        free(chunks[i].tokens.starts);
+        chunks[i].tokens.starts = NULL;
+    }
+    return 0;
+}
+
+/* Reads the dimensions from the header token, the way the serial decoder
+   does: strtok() on "Bx", then atoi().
+*/
+static void parse_header(const char* header, size_t len, size_t* width_p,
+                         size_t* height_p) {
+    char* copy = malloc(len + 1);
+    if (copy == NULL) {
+        *width_p = 0;
+        *height_p = 0;
+        return;
+    }
+    memcpy(copy, header, len);
+    copy[len] = '\0';
+    char* dimensions[2] = {NULL, NULL};
+    char* token = strtok(copy, "Bx");
+    for (int i = 0; i < 2 && token != NULL; i++) {
+        dimensions[i] = token;
+        token = strtok(NULL, "Bx");
+    }
+    *height_p = dimensions[0] ? atoi(dimensions[0]) : 0;
+    *width_p = dimensions[1] ? atoi(dimensions[1]) : 0;
+    free(copy);
+}
+
+/* Body of parallel_decompress_board_str(), once the tokens have been found
+   and joined into chunks[0].tokens.
+*/
+static enum board_init_status decode_rows(chunk_t* chunks, int num_threads,
+                                          int** cells_p, size_t* width_p,
+                                          size_t* height_p, snake_t* snake_p) {
+    const char* compressed = chunks[0].str;
+    size_t len = chunks[0].str_len;
+    const size_t* starts = chunks[0].tokens.starts;
+    size_t num_tokens = chunks[0].tokens.len;
+    size_t num_rows = num_tokens > 0 ? num_tokens - 1 : 1;
+    *width_p = 0;
+    *height_p = 0;
+    if (num_tokens > 0) {
+        const char* bar = memchr(compressed + starts[0], '|', len - starts[0]);
+        size_t header_len =
+            (bar ? (size_t)(bar - compressed) : len) - starts[0];
+        parse_header(compressed + starts[0], header_len, width_p, height_p);
+    }
+
+    size_t num_cells_total = num_rows == *height_p && (int)*width_p >= 0
+                                 ? cell_count(*width_p, *height_p)
+                                 : 0;
+    int* cells = game_alloc(num_cells_total * sizeof(int));
+    *cells_p = cells;
+    // padding cells outside the board (blocked layout only) count as walls
+    if (num_cells_total != *width_p * *height_p) {
+        for (size_t i = 0; i < num_cells_total; i++) {
+            cells[i] = FLAG_WALL;
+        }
+    }
+    if (num_rows != *height_p) {
+        return INIT_ERR_INCORRECT_DIMENSIONS;
+    }
+
+    // split the rows (tokens 1..num_rows) into chunks of about equal length
+    int num_chunks = 0;
+    size_t row = 1;
+    for (int i = 0; i < num_threads && row <= num_rows; i++) {
+        size_t end = row + 1;
+        size_t target = len * (i + 1) / num_threads;
+        while (end <= num_rows && starts[end] < target) {
+            end++;
+        }
+        if (i == num_threads - 1) {
+            end = num_rows + 1;
+        }
+        chunk_t* chunk = &chunks[num_chunks++];
+        chunk->row_starts = starts;
+        chunk->num_tokens = num_tokens;
+        chunk->first_row = row;
+        chunk->end_row = end;
+        chunk->cells = cells;
+        chunk->width = (int)*width_p;
+        row = end;
+    }
+
+    // each chunk starts with the cell type of the last letter before it
+    run_chunks(find_last_letter, chunks, num_chunks);
+    int flag = -1;
+    for (int i = 0; i < num_chunks; i++) {
+        chunks[i].in_flag = flag;
+        if (chunks[i].last_letter != 0) {
+            flag = check_row_char(chunks[i].last_letter);
+        }
+    }
+    run_chunks(decode_chunk, chunks, num_chunks);
+
+    // the first error in string order wins; the snake count carries over
+    int snakes = 0;
+    size_t snake_pos = 0;
+    for (int i = 0; i < num_chunks; i++) {
+        chunk_t* chunk = &chunks[i];
+        if (chunk->snake_err_pos[snakes] < chunk->err_pos) {
+            return INIT_ERR_WRONG_SNAKE_NUM;
+        }
+        if (chunk->err_pos != NO_ERROR) {
+            return chunk->err;
+        }
+        snakes = (int)chunk->snake_total[snakes];
+        if (chunk->has_snake) {
+            snake_pos = chunk->snake_pos;
+        }
+    }
+    if (snakes != 1) {
+        return INIT_ERR_WRONG_SNAKE_NUM;
+    }
+    snake_body_push_head(&snake_p->snake_pos, RIGHT, snake_pos);
+    return INIT_SUCCESS;
+}
+
+/** Decodes a compressed board string like decompress_board_str(), using up
+ * to `num_threads` threads (0 picks a number from the core count and the
+ * string's length). The results, including which error is reported for a
+ * bad string, are the same as the serial decoder's. `compressed` is not
+ * modified.
+ *
+ * Rows are found with a memchr() scan over a slice of the string per thread.
+ * The rows are then split into chunks of about equal size, and each thread
+ * decodes its chunk straight into its part of the cells array. A chunk's
+ * starting cell type comes from the last letter of the chunks before it, and
+ * its snake count is checked for both counts it can start with (0 or 1); the
+ * chunks' errors are then merged in string order, so the first error wins
+ * just as it does serially.
+ */
+enum board_init_status parallel_decompress_board_str(int** cells_p,
+                                                     size_t* width_p,
+                                                     size_t* height_p,
+                                                     snake_t* snake_p,
+                                                     const char* compressed,
+                                                     int num_threads) {
+    size_t len = strlen(compressed);
+    num_threads = pick_threads(num_threads, len);
+    chunk_t chunks[MAX_THREADS];
+    memset(chunks, 0, sizeof(chunks));
+    snake_body_init(&snake_p->snake_pos);
+    *cells_p = NULL;
+
+    // find the rows, a slice of the string per thread
+    for (int i = 0; i < num_threads; i++) {
+        chunks[i].str = compressed;
+        chunks[i].str_len = len;
+        chunks[i].lo = len * i / num_threads;
+        chunks[i].hi = len * (i + 1) / num_threads;
+    }
+    // out of memory for the row list: there is no status for that, and
+    // nothing was decoded
+    enum board_init_status status = INIT_ERR_BAD_CHAR;
+    if (run_chunks(scan_tokens, chunks, num_threads) == 0 &&
+        join_tokens(chunks, num_threads) == 0) {
+        status = decode_rows(chunks, num_threads, cells_p, width_p, height_p,
+                             snake_p);
+    }
+    for (int i = 0; i < num_threads; i++) {
+        free(chunks[i].tokens.starts);
+    }
+    return status;
+}
@@ -0,0 +1,20 @@
+#ifndef PARALLEL_DECODE_H
+#define PARALLEL_DECODE_H
+
+#include <stddef.h>
+
+#include "common.h"
+#include "game_setup.h"
+
+// initialize_game() hands board strings at least this long to the parallel
+// decoder; shorter ones would be decoded by a single thread anyway.
+#define PARALLEL_DECODE_MIN_LEN (512 * 1024)
+
+enum board_init_status parallel_decompress_board_str(int** cells_p,
+                                                     size_t* width_p,
+                                                     size_t* height_p,
+                                                     snake_t* snake_p,
+                                                     const char* compressed,
+                                                     int num_threads);
+
+#endif
@@ -0,0 +1,379 @@
+#include "raster.h"
+
+#include <curses.h>
+#include <pthread.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "render.h"
+
+// With num_threads == 0, one thread per core, up to this many.
+#define MAX_THREADS 64
+
+// Tiles smaller than this can't show a glyph's shape, so the glyph's colour
+// fills the whole tile instead.
+#define MIN_SHAPED_TILE 4
+
+// Each pixel of a shaped tile is sampled SUBSAMPLES x SUBSAMPLES times.
+#define SUBSAMPLES 4
+
+// A slot's frame is free to be overwritten, waiting for a thread, or drawn
+// and waiting to be written.
+#define SLOT_FREE 0
+#define SLOT_QUEUED 1
+#define SLOT_DRAWN 2
+
+// RGB of the curses colours render_game() uses, as a default xterm shows
+// them, and of a dark terminal's default background.
+static const uint8_t curses_rgb[8][3] = {
+    [COLOR_BLACK] = {0, 0, 0},        [COLOR_RED] = {205, 0, 0},
+    [COLOR_GREEN] = {0, 205, 0},      [COLOR_YELLOW] = {205, 205, 0},
+    [COLOR_BLUE] = {0, 0, 238},       [COLOR_MAGENTA] = {205, 0, 205},
+    [COLOR_CYAN] = {0, 205, 205},     [COLOR_WHITE] = {229, 229, 229},
+};
+static const uint8_t background_rgb[3] = {0, 0, 0};
+
+/* Returns 1 if the point (x, y) of a tile, both in [0, 1), is inside the
+   glyph's shape.
+*/
+static int inside_glyph(enum cell_glyph glyph, double x, double y) {
+    double dx = x - 0.5;
+    double dy = y - 0.5;
+    switch (glyph) {
+        case GLYPH_WALL:
+            return 1;
+        case GLYPH_SNAKE:
+            return dx > -0.42 && dx < 0.42 && dy > -0.42 && dy < 0.42;
+        case GLYPH_FOOD:
+            return dx * dx + dy * dy < 0.40 * 0.40;
+        case GLYPH_GRASS:
+            return dx * dx + dy * dy < 0.15 * 0.15;
+        case GLYPH_EMPTY:
+        default:
+            return 0;
+    }
+}
+
+/* Returns how many of a pixel's SUBSAMPLES^2 samples are inside the glyph.
+ */
+static int pixel_coverage(enum cell_glyph glyph, size_t tile, size_t px,
+                          size_t py) {
+    if (tile < MIN_SHAPED_TILE) {
+        return glyph == GLYPH_EMPTY ? 0 : SUBSAMPLES * SUBSAMPLES;
+    }
+    int covered = 0;
+    for (int sy = 0; sy < SUBSAMPLES; sy++) {
+        for (int sx = 0; sx < SUBSAMPLES; sx++) {
+            double x = (px + (sx + 0.5) / SUBSAMPLES) / tile;
+            double y = (py + (sy + 0.5) / SUBSAMPLES) / tile;
+            covered += inside_glyph(glyph, x, y);
+        }
+    }
+    return covered;
+}
+
+/* Converts an RGB pixel to BT.601 studio-range Y'CbCr, as Y4M players
+   expect.
+*/
+static void rgb_to_yuv(const uint8_t* rgb, uint8_t* yuv) {
+    int r = rgb[0];
+    int g = rgb[1];
+    int b = rgb[2];
+    yuv[0] = (uint8_t)(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+    yuv[1] = (uint8_t)(((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128);
+    yuv[2] = (uint8_t)(((112 * r - 94 * g - 18 * b + 128) >> 8) + 128);
+}
+
+/* Draws the tile of every cell look. A PPM tile is RGB rows; a Y4M tile is
+   a Y, a U and a V plane, one after another, so a frame can copy whole tile
+   rows into each of its planes.
+*/
+static void draw_tiles(raster_t* r) {
+    size_t t = r->tile;
+    for (int look = 0; look < RASTER_NUM_LOOKS; look++) {
+        enum cell_glyph glyph;
+        short color;
+        cell_look(look, &glyph, &color);
+        const uint8_t* fg = color >= 0 ? curses_rgb[color] : background_rgb;
+        uint8_t* dst = r->tiles + look * t * t * 3;
+        for (size_t py = 0; py < t; py++) {
+            for (size_t px = 0; px < t; px++) {
+                int covered = pixel_coverage(glyph, t, px, py);
+                uint8_t rgb[3];
+                for (int c = 0; c < 3; c++) {
+                    rgb[c] = (uint8_t)(background_rgb[c] +
+                                       (fg[c] - background_rgb[c]) * covered /
+                                           (SUBSAMPLES * SUBSAMPLES));
+                }
+                size_t i = py * t + px;
+                if (r->format == RASTER_PPM) {
+                    memcpy(dst + i * 3, rgb, 3);
+                } else {
+                    uint8_t yuv[3];
+                    rgb_to_yuv(rgb, yuv);
+                    for (int p = 0; p < 3; p++) {
+                        dst[p * t * t + i] = yuv[p];
+                    }
+                }
+            }
+        }
+    }
+}
+
+/* Draws one plane of a frame: each cell's tile row `ty` starts at
+   tiles[cell * tile_bytes + ty * span] and is `span` bytes long. Returns
+   the end of the plane.
+*/
+static uint8_t* draw_plane(uint8_t* dst, const uint8_t* cells, size_t width,
+                           size_t height, size_t tile, const uint8_t* tiles,
+                           size_t tile_bytes, size_t span) {
+    for (size_t row = 0; row < height; row++) {
+        const uint8_t* c = cells + row * width;
+        for (size_t ty = 0; ty < tile; ty++) {
+            const uint8_t* src = tiles + ty * span;
+            // the one pixel tiles of big boards are the hot case; don't
+            // leave them to a memcpy() call per cell
+            if (span == 1) {
+                for (size_t col = 0; col < width; col++) {
+                    *dst++ = src[c[col] * tile_bytes];
+                }
+            } else if (span == 3) {
+                for (size_t col = 0; col < width; col++) {
+                    const uint8_t* px = src + c[col] * tile_bytes;
+                    dst[0] = px[0];
+                    dst[1] = px[1];
+                    dst[2] = px[2];
+                    dst += 3;
+                }
+            } else {
+                for (size_t col = 0; col < width; col++) {
+                    memcpy(dst, src + c[col] * tile_bytes, span);
+                    dst += span;
+                }
+            }
+        }
+    }
+    return dst;
+}
+
+/* Encodes a slot's cells into its image.
+ */
+static void draw_frame(const raster_t* r, raster_slot_t* slot) {
+    size_t t = r->tile;
+    size_t tile_bytes = t * t * 3;
+    uint8_t* dst = slot->image + r->header_len;
+    if (r->format == RASTER_PPM) {
+        draw_plane(dst, slot->cells, r->width, r->height, t, r->tiles,
+                   tile_bytes, t * 3);
+        return;
+    }
+    for (size_t p = 0; p < 3; p++) {
+        dst = draw_plane(dst, slot->cells, r->width, r->height, t,
+                         r->tiles + p * t * t, tile_bytes, t);
+    }
+}
+
+/* A pool thread: draws queued frames, in any order, until told to stop.
+ */
+static void* pool_thread(void* arg) {
+    raster_t* r = arg;
+    pthread_mutex_lock(&r->lock);
+    for (;;) {
+        while (!r->stop && r->taken == r->queued) {
+            pthread_cond_wait(&r->work, &r->lock);
+        }
+        if (r->taken == r->queued) {
+            break;
+        }
+        raster_slot_t* slot = &r->slots[r->taken++ % r->num_slots];
+        pthread_mutex_unlock(&r->lock);
+        draw_frame(r, slot);
+        pthread_mutex_lock(&r->lock);
+        slot->state = SLOT_DRAWN;
+        pthread_cond_broadcast(&r->done);
+    }
+    pthread_mutex_unlock(&r->lock);
+    return NULL;
+}
+
+/* Waits for the oldest unwritten frame to be drawn and writes it.
+ */
+static void write_next(raster_t* r) {
+    raster_slot_t* slot = &r->slots[r->written % r->num_slots];
+    pthread_mutex_lock(&r->lock);
+    while (slot->state != SLOT_DRAWN) {
+        pthread_cond_wait(&r->done, &r->lock);
+    }
+    pthread_mutex_unlock(&r->lock);
+    if (!r->error &&
+        fwrite(slot->image, 1, r->frame_bytes, r->out) != r->frame_bytes) {
+        r->error = 1;
+    }
+    slot->state = SLOT_FREE;
+    r->written++;
+}
+
+/* Stops and joins the pool and frees everything raster_open() set up.
+ */
+static void free_raster(raster_t* r) {
+    pthread_mutex_lock(&r->lock);
+    r->stop = 1;
+    pthread_cond_broadcast(&r->work);
+    pthread_mutex_unlock(&r->lock);
+    for (size_t i = 0; i < r->num_threads; i++) {
+        pthread_join(r->threads[i], NULL);
+    }
+    if (r->slots != NULL) {
+        for (size_t i = 0; i < r->num_slots; i++) {
+            free(r->slots[i].cells);
+            free(r->slots[i].image);
+        }
+    }
+    free(r->slots);
+    free(r->threads);
+    free(r->tiles);
+    pthread_cond_destroy(&r->done);
+    pthread_cond_destroy(&r->work);
+    pthread_mutex_destroy(&r->lock);
+}
+
+/* Allocates the tiles, slots and pool of a raster whose sizes are set.
+   Returns 0 on success and -1 if memory or threads ran out.
+*/
+static int start_raster(raster_t* r, size_t num_threads) {
+    r->tiles = malloc(RASTER_NUM_LOOKS * r->tile * r->tile * 3);
+    // two frames per thread: one being drawn, one waiting for it
+    r->num_slots = 2 * num_threads;
+    r->slots = calloc(r->num_slots, sizeof(raster_slot_t));
+    r->threads = calloc(num_threads, sizeof(pthread_t));
+    if (r->tiles == NULL || r->slots == NULL || r->threads == NULL) {
+        return -1;
+    }
+    draw_tiles(r);
+    for (size_t i = 0; i < r->num_slots; i++) {
+        r->slots[i].cells = malloc(r->width * r->height);
+        r->slots[i].image = malloc(r->frame_bytes);
+        if (r->slots[i].cells == NULL || r->slots[i].image == NULL) {
+            return -1;
+        }
+        // the header is the same for every frame
+        memcpy(r->slots[i].image, r->header, r->header_len);
+    }
+    for (; r->num_threads < num_threads; r->num_threads++) {
+        if (pthread_create(&r->threads[r->num_threads], NULL, pool_thread,
+                           r) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/** Starts drawing frames of a `width` x `height` board into `out`.
+ *
+ * Returns 0 on success, or -1 if an argument is out of range, the image
+ * would be too big, or memory or threads ran out (nothing is written then).
+ *
+ * Arguments:
+ *  - width, height: board dimensions, in cells
+ *  - tile: side of a cell in pixels, 1 to RASTER_MAX_TILE. Below 4 pixels
+ *    cells are filled with their glyph's colour rather than drawn as shapes.
+ *  - format: RASTER_PPM or RASTER_Y4M
+ *  - fps: frame rate recorded in a Y4M stream, at least 1
+ *  - num_threads: threads drawing frames, or 0 for one per core
+ *  - out: where the frames go. It stays open after raster_close().
+ */
+int raster_open(raster_t* r, size_t width, size_t height, size_t tile,
+                enum raster_format format, unsigned fps, size_t num_threads,
+                FILE* out) {
+    memset(r, 0, sizeof(*r));
+    if (width == 0 || height == 0 || tile == 0 || tile > RASTER_MAX_TILE ||
+        fps == 0) {
+        return -1;
+    }
+    if (width > SIZE_MAX / 3 / tile / tile / height) {
+        return -1;
+    }
+    if (num_threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        num_threads = cores > 0 ? (size_t)cores : 1;
+    }
+    if (num_threads > MAX_THREADS) {
+        num_threads = MAX_THREADS;
+    }
+    r->width = width;
+    r->height = height;
+    r->tile = tile;
+    r->format = format;
+    r->out = out;
+
+    size_t image_w = width * tile;
+    size_t image_h = height * tile;
+    int len;
+    if (format == RASTER_PPM) {
+        len = snprintf(r->header, sizeof(r->header), "P6\n%zu %zu\n255\n",
+                       image_w, image_h);
+    } else {
+        len = snprintf(r->header, sizeof(r->header), "FRAME\n");
+        if (fprintf(out, "YUV4MPEG2 W%zu H%zu F%u:1 Ip A1:1 C444\n", image_w,
+                    image_h, fps) < 0) {
+            return -1;
+        }
+    }
+    r->header_len = (size_t)len;
+    r->frame_bytes = r->header_len + image_w * image_h * 3;
+
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->work, NULL);
+    pthread_cond_init(&r->done, NULL);
+    if (start_raster(r, num_threads) < 0) {
+        free_raster(r);
+        return -1;
+    }
+    return 0;
+}
+
+/** Queues a frame of the board `cells`, which holds width * height cells in
+ * row-major order (like delta_reader_t's cells). Only the cell flags are
+ * kept; the caller may change `cells` once this returns. Frames are written
+ * in the order they are added.
+ *
+ * Returns 0 on success and -1 once writing the output has failed.
+ */
+int raster_add_frame(raster_t* r, const int* cells) {
+    if (r->error) {
+        return -1;
+    }
+    if (r->queued - r->written == r->num_slots) {
+        write_next(r);
+    }
+    // a free slot is ours until it is queued
+    raster_slot_t* slot = &r->slots[r->queued % r->num_slots];
+    size_t n = r->width * r->height;
+    for (size_t i = 0; i < n; i++) {
+        slot->cells[i] = (uint8_t)(cells[i] & (RASTER_NUM_LOOKS - 1));
+    }
+    pthread_mutex_lock(&r->lock);
+    slot->state = SLOT_QUEUED;
+    r->queued++;
+    pthread_cond_signal(&r->work);
+    pthread_mutex_unlock(&r->lock);
+    return r->error ? -1 : 0;
+}
+
+/** Writes the frames still in flight, flushes the output and frees the
+ * raster.
+ *
+ * Returns 0 if every frame was written and -1 otherwise.
+ */
+int raster_close(raster_t* r) {
+    while (r->written < r->queued) {
+        write_next(r);
+    }
+    if (fflush(r->out) != 0) {
+        r->error = 1;
+    }
+    free_raster(r);
+    return r->error ? -1 : 0;
+}
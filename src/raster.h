@@ -0,0 +1,77 @@
+#ifndef RASTER_H
+#define RASTER_H
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+// Largest tile side, in pixels.
+#define RASTER_MAX_TILE 64
+
+// Number of distinct cell looks: every combination of the four flags.
+#define RASTER_NUM_LOOKS 16
+
+enum raster_format {
+    RASTER_PPM,  // concatenated binary PPM (P6) images, one per frame
+    RASTER_Y4M,  // YUV4MPEG2 video, 4:4:4 chroma
+};
+
+// A frame on its way through the pool. See raster.c.
+typedef struct raster_slot {
+    uint8_t* cells;
+    uint8_t* image;
+    int state;
+} raster_slot_t;
+
+/** Draws boards into image frames without a terminal, using the glyphs and
+ * colours render_game() would, and writes them to a file in order. Frames
+ * are drawn by a pool of threads while the caller reads the next ones.
+ * Fields:
+ *  - width, height: board dimensions, in cells
+ *  - tile: side of a cell, in pixels
+ *  - format: output format
+ *  - out: where the frames go
+ *  - tiles: each cell look drawn once, in the output's pixel format
+ *  - frame_bytes, header_len, header: size of an encoded frame and of its
+ *    header, which is part of it
+ *  - slots, num_slots: frames being drawn or waiting to be written
+ *  - queued, taken, written: numbers of frames handed to the pool, picked
+ *    up by a thread, and written out
+ *  - threads, num_threads: the pool
+ *  - lock, work, done: guard the slots; signalled when a frame is queued
+ *    and when one is drawn
+ *  - stop: set to make the pool exit
+ *  - error: set once a write fails
+ */
+typedef struct raster {
+    size_t width;
+    size_t height;
+    size_t tile;
+    enum raster_format format;
+    FILE* out;
+    uint8_t* tiles;
+    size_t frame_bytes;
+    size_t header_len;
+    char header[64];
+    raster_slot_t* slots;
+    size_t num_slots;
+    uint64_t queued;
+    uint64_t taken;
+    uint64_t written;
+    pthread_t* threads;
+    size_t num_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t work;
+    pthread_cond_t done;
+    int stop;
+    int error;
+} raster_t;
+
+int raster_open(raster_t* r, size_t width, size_t height, size_t tile,
+                enum raster_format format, unsigned fps, size_t num_threads,
+                FILE* out);
+int raster_add_frame(raster_t* r, const int* cells);
+int raster_close(raster_t* r);
+
+#endif
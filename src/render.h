@@ -5,9 +5,19 @@
 
 #include "common.h"
 
+// Glyphs that render_game() draws cells with.
+enum cell_glyph {
+    GLYPH_EMPTY,  // a space
+    GLYPH_GRASS,  // a middle dot
+    GLYPH_WALL,   // a full block
+    GLYPH_SNAKE,  // `S`
+    GLYPH_FOOD,   // `O`
+};
+
 void check_terminal_size(size_t width, size_t height);
 void initialize_window(size_t width, size_t height);
 void end_game(int* cells, size_t width, size_t height, snake_t* snake_p);
 void render_game(int* cells, size_t width, size_t height);
+void cell_look(int cell, enum cell_glyph* glyph_p, short* color_p);
 
 #endif
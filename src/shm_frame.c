@@ -0,0 +1,217 @@
+#include "shm_frame.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "common.h"
+
+#define SHM_FRAME_MAGIC 0x324d415246454b53ull  // "SKEFRAM2"
+#define MAX_SPINS (1u << 20)  // read attempts before giving up on a frame
+
+// The shared region. `seq` is a seqlock: odd while the game is writing a
+// frame. Readers copy the frame and keep it only if `seq` was even and
+// unchanged throughout, so the game never waits for them. `pid` lets them
+// notice a game that was killed before it could publish its last frame.
+typedef struct shm_frame_region {
+    uint64_t magic;  // written last, once the region is set up
+    uint32_t seq;
+    uint32_t width;
+    uint32_t height;
+    int32_t score;
+    int32_t game_over;
+    int32_t pid;
+    uint64_t tick;
+    char name[SHM_FRAME_NAME_LEN];
+    int cells[];
+} shm_frame_region_t;
+
+/** Writes the name the game with process id `pid` publishes under by
+ * default into `out`, which has room for `size` bytes.
+ */
+void shm_frame_default_name(char* out, size_t size, long pid) {
+    snprintf(out, size, SHM_FRAME_PREFIX "%ld", pid);
+}
+
+/** Creates the shared-memory object `name` for publishing frames of a
+ * width x height board. An existing object is left alone, since another
+ * game may be publishing to it (or viewers reading it): resizing it under
+ * them would crash them.
+ *
+ * Returns 0 on success and -1 on failure, including if `name` exists.
+ */
+int shm_frame_create(shm_frame_t* frame, const char* name, size_t width,
+                     size_t height) {
+    memset(frame, 0, sizeof(*frame));
+    snprintf(frame->name, sizeof(frame->name), "%s", name);
+    frame->width = width;
+    frame->height = height;
+    frame->map_size =
+        sizeof(shm_frame_region_t) + cell_count(width, height) * sizeof(int);
+
+    int fd = shm_open(frame->name, O_RDWR | O_CREAT | O_EXCL, 0644);
+    if (fd < 0) {
+        return -1;
+    }
+    frame->writer = 1;
+    if (ftruncate(fd, (off_t)frame->map_size) < 0) {
+        close(fd);
+        shm_unlink(frame->name);
+        return -1;
+    }
+    void* map = mmap(NULL, frame->map_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        shm_unlink(frame->name);
+        return -1;
+    }
+
+    frame->region = map;
+    frame->region->width = (uint32_t)width;
+    frame->region->height = (uint32_t)height;
+    frame->region->pid = (int32_t)getpid();
+    __atomic_store_n(&frame->region->magic, SHM_FRAME_MAGIC, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/** Publishes one frame: a single copy of the board plus a few scalars.
+ * Never waits for viewers.
+ * Arguments:
+ *  - frame: a region made by shm_frame_create().
+ *  - cells: the board, of the size the region was made for.
+ *  - score, game_over: the game's g_score and g_game_over.
+ *  - player: the player's name, or NULL.
+ */
+void shm_frame_publish(shm_frame_t* frame, int* cells, int score,
+                       int game_over, const char* player) {
+    shm_frame_region_t* region = frame->region;
+    size_t num_cells = shm_frame_num_cells(frame);
+
+    uint32_t seq = region->seq;
+    __atomic_store_n(&region->seq, seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    memcpy(region->cells, cells, num_cells * sizeof(int));
+    region->score = score;
+    region->game_over = game_over;
+    if (region->tick == 0 && player != NULL) {
+        // the name doesn't change during a game
+        snprintf(region->name, sizeof(region->name), "%s", player);
+    }
+    region->tick++;
+
+    __atomic_store_n(&region->seq, seq + 2, __ATOMIC_RELEASE);
+}
+
+/** Attaches read-only to the frames published under `name`.
+ *
+ * Returns 0 on success and -1 if there is no (fully set up) region.
+ */
+int shm_frame_attach(shm_frame_t* frame, const char* name) {
+    memset(frame, 0, sizeof(*frame));
+    snprintf(frame->name, sizeof(frame->name), "%s", name);
+
+    int fd = shm_open(frame->name, O_RDONLY, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(shm_frame_region_t)) {
+        close(fd);
+        return -1;
+    }
+    void* map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) {
+        return -1;
+    }
+    frame->region = map;
+    frame->map_size = (size_t)st.st_size;
+
+    if (__atomic_load_n(&frame->region->magic, __ATOMIC_ACQUIRE) !=
+            SHM_FRAME_MAGIC ||
+        frame->map_size < sizeof(shm_frame_region_t) +
+                              shm_frame_num_cells(frame) * sizeof(int)) {
+        shm_frame_close(frame);
+        return -1;
+    }
+    frame->width = frame->region->width;
+    frame->height = frame->region->height;
+    return 0;
+}
+
+/** Returns the number of cells in each frame.
+ */
+size_t shm_frame_num_cells(shm_frame_t* frame) {
+    return cell_count(frame->width, frame->height);
+}
+
+/** Returns the current publication number, which changes with every frame.
+ * Cheap enough to poll.
+ */
+uint32_t shm_frame_seq(shm_frame_t* frame) {
+    return __atomic_load_n(&frame->region->seq, __ATOMIC_ACQUIRE);
+}
+
+/** Returns 0 if the publishing game's process is gone, as after a SIGKILL
+ * that left no final frame, and 1 otherwise.
+ */
+int shm_frame_writer_alive(shm_frame_t* frame) {
+    pid_t pid = (pid_t)__atomic_load_n(&frame->region->pid, __ATOMIC_RELAXED);
+    return !(kill(pid, 0) < 0 && errno == ESRCH);
+}
+
+/** Copies out the latest complete frame. `snapshot->cells` must already
+ * point at room for shm_frame_num_cells() cells.
+ *
+ * Returns 1 if a frame was copied, 0 if nothing has been published yet (or
+ * the game died partway through publishing).
+ */
+int shm_frame_read(shm_frame_t* frame, shm_frame_snapshot_t* snapshot) {
+    shm_frame_region_t* region = frame->region;
+    size_t num_cells = shm_frame_num_cells(frame);
+    for (unsigned spins = 0; spins < MAX_SPINS; spins++) {
+        uint32_t seq = __atomic_load_n(&region->seq, __ATOMIC_ACQUIRE);
+        if (seq % 2 == 1) {
+            continue;  // mid-publish; a frame takes one memcpy to finish
+        }
+        if (seq == 0) {
+            return 0;
+        }
+        memcpy(snapshot->cells, region->cells, num_cells * sizeof(int));
+        snapshot->tick = region->tick;
+        snapshot->score = region->score;
+        snapshot->game_over = region->game_over;
+        memcpy(snapshot->name, region->name, SHM_FRAME_NAME_LEN);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&region->seq, __ATOMIC_RELAXED) == seq) {
+            snapshot->seq = seq;
+            snapshot->width = frame->width;
+            snapshot->height = frame->height;
+            snapshot->name[SHM_FRAME_NAME_LEN - 1] = '\0';
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** Unmaps the region. The publishing game also removes the shared-memory
+ * object it created, though viewers that are attached keep their mapping.
+ */
+void shm_frame_close(shm_frame_t* frame) {
+    if (frame->region != NULL) {
+        munmap(frame->region, frame->map_size);
+        frame->region = NULL;
+    }
+    if (frame->writer) {
+        shm_unlink(frame->name);
+    }
+}
@@ -0,0 +1,62 @@
+#ifndef SHM_FRAME_H
+#define SHM_FRAME_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define SHM_FRAME_PREFIX "/snake-"  // default names end in the game's pid
+#define SHM_FRAME_NAME_LEN 64       // bytes of player name published
+
+struct shm_frame_region;
+
+/** A mapped frame region, as either the publishing game or a viewer.
+ * Fields:
+ *  - name: the shared-memory object name
+ *  - width, height: board dimensions
+ *  - region: the mapping
+ *  - map_size: bytes mapped
+ *  - writer: 1 for the publishing game, which created the object and
+ *    unlinks it on close
+ */
+typedef struct shm_frame {
+    char name[256];
+    size_t width;
+    size_t height;
+    struct shm_frame_region* region;
+    size_t map_size;
+    int writer;
+} shm_frame_t;
+
+/** One frame as copied out by a viewer.
+ * Fields:
+ *  - seq: publication number; even, and increasing by 2 per frame
+ *  - tick: number of frames published before this one
+ *  - width, height: board dimensions
+ *  - score, game_over, name: g_score, g_game_over and g_name at publication
+ *  - cells: the board, in the same layout as the game's cells (see
+ *    cell_index()); holds shm_frame_num_cells() cells
+ */
+typedef struct shm_frame_snapshot {
+    uint32_t seq;
+    uint64_t tick;
+    size_t width;
+    size_t height;
+    int score;
+    int game_over;
+    char name[SHM_FRAME_NAME_LEN];
+    int* cells;
+} shm_frame_snapshot_t;
+
+void shm_frame_default_name(char* out, size_t size, long pid);
+int shm_frame_create(shm_frame_t* frame, const char* name, size_t width,
+                     size_t height);
+void shm_frame_publish(shm_frame_t* frame, int* cells, int score,
+                       int game_over, const char* player);
+int shm_frame_attach(shm_frame_t* frame, const char* name);
+size_t shm_frame_num_cells(shm_frame_t* frame);
+uint32_t shm_frame_seq(shm_frame_t* frame);
+int shm_frame_writer_alive(shm_frame_t* frame);
+int shm_frame_read(shm_frame_t* frame, shm_frame_snapshot_t* snapshot);
+void shm_frame_close(shm_frame_t* frame);
+
+#endif
@@ -1,16 +1,33 @@
 #define _XOPEN_SOURCE_EXTENDED 1
 #include <curses.h>
+#include <signal.h>
 #include <stddef.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#endif
 
 #include "common.h"
+#include "delta.h"
+#include "event_loop.h"
 #include "game.h"
 #include "game_over.h"
 #include "game_setup.h"
+#include "hiscore.h"
 #include "mbstrings.h"
+#include "net_proto.h"
 #include "render.h"
+#include "shm_frame.h"
+
+// frames published for snake-watch, if the region could be made (it isn't
+// if another game already publishes under the name)
+static shm_frame_t g_frame;
+static int g_publishing;
 
 /** Gets the next input from the user, or returns INPUT_NONE if no input is
  * provided quickly enough.
@@ -35,6 +52,28 @@ enum input_key get_input() {
     /* DO NOT MODIFY THIS FUNCTION */
 }
 
+/** Records the finished game in the high-score file named by $SNAKE_SCORES,
+ * or ~/.snake_scores if that is unset. Failures are ignored: a missing score
+ * file shouldn't stop the game from ending.
+ */
+void save_score(uint64_t board_key) {
+    char path[4096];
+    const char* env = getenv("SNAKE_SCORES");
+    if (env != NULL) {
+        snprintf(path, sizeof(path), "%s", env);
+    } else if (getenv("HOME") != NULL) {
+        snprintf(path, sizeof(path), "%s/.snake_scores", getenv("HOME"));
+    } else {
+        return;
+    }
+
+    hiscore_t store;
+    if (hiscore_open(&store, path, HISCORE_CAPACITY) == 0) {
+        hiscore_add(&store, board_key, g_name, g_score);
+        hiscore_close(&store);
+    }
+}
+
 /** Helper function that procs the GAME OVER screen and final key prompt.
  * `snake_p` is not needed until Part 3!
  */
@@ -55,6 +94,347 @@ void end_game(int* cells, size_t width, size_t height, snake_t* snake_p) {
     endwin();
 }
 
+/** Draws the board and publishes it to any watching processes.
+ */
+void show_tick(int* cells, size_t width, size_t height) {
+    render_game(cells, width, height);
+    if (g_publishing) {
+        shm_frame_publish(&g_frame, cells, g_score, g_game_over, g_name);
+    }
+    if (g_delta != NULL) {
+        fflush(g_delta->out);  // readers may be following a pipe live
+    }
+}
+
+/** Runs the game by sleeping for a tick, then waiting briefly for a key.
+ * Used where the event loop isn't available.
+ */
+void play_polling(int* cells, size_t width, size_t height, snake_t* snake_p,
+                  int snake_grows, update_fn step) {
+    while (g_game_over == 0) {
+        usleep(1000000);
+        step(cells, width, height, snake_p, get_input(), snake_grows);
+        show_tick(cells, width, height);
+    }
+}
+
+#ifdef __linux__
+// Everything the event handlers need to play one game.
+typedef struct game_loop {
+    event_loop_t loop;
+    int* cells;
+    size_t width;
+    size_t height;
+    snake_t* snake_p;
+    int snake_grows;
+    update_fn step;
+    enum input_key next_input;  // latest key since the last tick
+    int paused;
+    int terminated;
+} game_loop_t;
+
+/* Takes every key waiting on stdin. Only the latest arrow key is kept; it
+   is applied at the next tick. Once stdin hangs up or fails it is dropped
+   from the loop, since it would otherwise stay ready and spin; the game
+   plays on without keys.
+*/
+static void on_key(int fd, uint32_t events, void* data) {
+    game_loop_t* game = data;
+    enum input_key input;
+    // getch() doesn't block in nodelay mode. Other keys read as INPUT_NONE
+    // and end this pass early, but stdin stays ready so we're called again.
+    while ((input = get_input()) != INPUT_NONE) {
+        game->next_input = input;
+    }
+    if (events & (EPOLLHUP | EPOLLERR)) {
+        event_loop_remove(&game->loop, fd);
+    }
+}
+
+/* Advances the game by one tick.
+ */
+static void on_tick(int fd, uint32_t events, void* data) {
+    game_loop_t* game = data;
+    // ticks missed while the process was stopped collapse into one
+    if (event_loop_timer_expirations(fd) == 0 || game->paused) {
+        return;
+    }
+    game->step(game->cells, game->width, game->height, game->snake_p,
+               game->next_input, game->snake_grows);
+    game->next_input = INPUT_NONE;
+    show_tick(game->cells, game->width, game->height);
+    if (g_game_over) {
+        event_loop_stop(&game->loop);
+    }
+}
+
+/* Handles SIGWINCH (redraw for the new terminal size), SIGTERM (quit) and
+   SIGUSR1 (pause or resume).
+*/
+static void on_signal(int fd, uint32_t events, void* data) {
+    game_loop_t* game = data;
+    int signo;
+    while ((signo = event_loop_next_signal(fd)) != 0) {
+        if (signo == SIGWINCH) {
+            endwin();
+            refresh();
+            clear();
+            render_game(game->cells, game->width, game->height);
+        } else if (signo == SIGTERM) {
+            game->terminated = 1;
+            event_loop_stop(&game->loop);
+        } else if (signo == SIGUSR1) {
+            game->paused = !game->paused;
+        }
+    }
+}
+
+/** Runs the game on an epoll loop: a timerfd drives the ticks, keys are
+ * read as soon as stdin is ready, and signals arrive through a signalfd.
+ * The process sleeps in epoll_wait() between events.
+ *
+ * Returns 1 if the game ended by SIGTERM, 0 if it ended normally, and -1 if
+ * the loop couldn't be set up (nothing has been played in that case).
+ */
+int play_events(int* cells, size_t width, size_t height, snake_t* snake_p,
+                int snake_grows, update_fn step) {
+    game_loop_t game;
+    memset(&game, 0, sizeof(game));
+    game.cells = cells;
+    game.width = width;
+    game.height = height;
+    game.snake_p = snake_p;
+    game.snake_grows = snake_grows;
+    game.step = step;
+    game.next_input = INPUT_NONE;
+
+    static const int signals[] = {SIGWINCH, SIGTERM, SIGUSR1};
+    if (event_loop_init(&game.loop) < 0) {
+        return -1;
+    }
+    if (event_loop_add(&game.loop, STDIN_FILENO, EPOLLIN, on_key, &game) < 0 ||
+        event_loop_add_timer(&game.loop, 1000, on_tick, &game) < 0 ||
+        event_loop_add_signals(&game.loop, signals,
+                               sizeof(signals) / sizeof(signals[0]), on_signal,
+                               &game) < 0) {
+        event_loop_close(&game.loop);
+        return -1;
+    }
+
+    nodelay(stdscr, TRUE);
+    event_loop_run(&game.loop);
+    nodelay(stdscr, FALSE);
+    event_loop_close(&game.loop);
+    return game.terminated;
+}
+
+// A multiplayer client. The board is the server's: it arrives as a delta
+// stream, one packet per tick, and is copied into `cells` for rendering.
+typedef struct remote {
+    event_loop_t loop;
+    int fd;
+    delta_reader_t reader;
+    int* cells;  // the board in this build's cell layout
+    unsigned char* keyframe;  // the welcome's keyframe while it arrives
+    size_t keyframe_len;      // its length
+    size_t keyframe_have;     // bytes of it received so far
+    uint32_t seq;
+    int failed;
+} remote_t;
+
+/* Applies a delta packet to the reader, the welcome's keyframe if `open`
+   is set and a tick record otherwise, and copies changed cells over.
+   Returns -1 if the packet is corrupt.
+*/
+static int remote_apply(remote_t* remote, const unsigned char* data,
+                        size_t len, int open) {
+    FILE* in = fmemopen((void*)data, len, "r");
+    if (in == NULL) {
+        return -1;
+    }
+    delta_reader_t* reader = &remote->reader;
+    int status;
+    if (open) {
+        status = delta_reader_open(reader, in);
+    } else {
+        reader->in = in;
+        status = delta_reader_next(reader) == 1 ? 0 : -1;
+    }
+    fclose(in);
+    if (status < 0) {
+        return -1;
+    }
+    size_t width = reader->width;
+    if (open) {
+        remote->cells = malloc(cell_count(width, reader->height) * sizeof(int));
+        for (size_t i = 0; i < cell_count(width, reader->height); i++) {
+            remote->cells[i] = FLAG_WALL;
+        }
+        for (size_t i = 0; i < width * reader->height; i++) {
+            remote->cells[cell_index(i / width, i % width, width)] =
+                reader->cells[i];
+        }
+    } else {
+        for (size_t i = 0; i < reader->num_changed; i++) {
+            size_t pos = reader->changed[i];
+            remote->cells[cell_index(pos / width, pos % width, width)] =
+                reader->cells[pos];
+        }
+    }
+    return 0;
+}
+
+/* Collects the welcome's keyframe, which comes in a NET_WELCOME packet and
+   then NET_KEYFRAME packets, and applies it once it is all there. Returns 1
+   once it has been applied, 0 while more is to come, and -1 if the packets
+   are corrupt.
+*/
+static int remote_welcome(remote_t* remote, const unsigned char* msg,
+                          size_t len) {
+    const unsigned char* p = msg + 1;
+    const unsigned char* end = msg + len;
+    if (msg[0] == NET_WELCOME) {
+        uint64_t id;
+        uint64_t frame_len;
+        if (net_get_varint(&p, end, &id) ||
+            net_get_varint(&p, end, &frame_len) || frame_len == 0 ||
+            frame_len > SIZE_MAX) {
+            return -1;
+        }
+        remote->keyframe = malloc((size_t)frame_len);
+        if (remote->keyframe == NULL) {
+            return -1;
+        }
+        remote->keyframe_len = (size_t)frame_len;
+        remote->keyframe_have = 0;
+    }
+    size_t chunk = (size_t)(end - p);
+    if (chunk > remote->keyframe_len - remote->keyframe_have) {
+        return -1;
+    }
+    memcpy(remote->keyframe + remote->keyframe_have, p, chunk);
+    remote->keyframe_have += chunk;
+    if (remote->keyframe_have < remote->keyframe_len) {
+        return 0;
+    }
+    int status =
+        remote_apply(remote, remote->keyframe, remote->keyframe_len, 1);
+    free(remote->keyframe);
+    remote->keyframe = NULL;
+    return status < 0 ? -1 : 1;
+}
+
+/* Sends every arrow key to the server as soon as it is pressed.
+ */
+static void on_remote_key(int fd, uint32_t events, void* data) {
+    remote_t* remote = data;
+    enum input_key input;
+    while ((input = get_input()) != INPUT_NONE) {
+        unsigned char msg[16];
+        size_t len = net_encode_input(msg, input, ++remote->seq);
+        send(remote->fd, msg, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+    }
+}
+
+/* Reads the welcome and then every tick the server sends, redrawing after
+   each.
+*/
+static void on_remote_packet(int fd, uint32_t events, void* data) {
+    remote_t* remote = data;
+    static unsigned char msg[NET_MAX_PACKET];
+    ssize_t len;
+    while ((len = recv(fd, msg, sizeof(msg), 0)) > 0) {
+        if ((msg[0] == NET_WELCOME && remote->cells == NULL &&
+             remote->keyframe == NULL) ||
+            (msg[0] == NET_KEYFRAME && remote->keyframe != NULL)) {
+            int status = remote_welcome(remote, msg, (size_t)len);
+            if (status < 0) {
+                remote->failed = 1;
+                event_loop_stop(&remote->loop);
+                return;
+            }
+            if (status == 0) {
+                continue;
+            }
+            initialize_window(remote->reader.width, remote->reader.height);
+            nodelay(stdscr, TRUE);
+            event_loop_add(&remote->loop, STDIN_FILENO, EPOLLIN,
+                           on_remote_key, remote);
+        } else if (msg[0] == NET_TICK && remote->cells != NULL) {
+            net_tick_t tick;
+            size_t header_len;
+            if (net_decode_tick(msg, len, &tick, &header_len) ||
+                remote_apply(remote, msg + header_len, len - header_len, 0) <
+                    0) {
+                remote->failed = 1;
+                event_loop_stop(&remote->loop);
+                return;
+            }
+            g_score = tick.score;
+        } else {
+            continue;
+        }
+        render_game(remote->cells, remote->reader.width,
+                    remote->reader.height);
+    }
+    if (len == 0) {
+        event_loop_stop(&remote->loop);  // the server went away
+    }
+}
+
+/* Stops the client on SIGINT or SIGTERM.
+ */
+static void on_remote_signal(int fd, uint32_t events, void* data) {
+    remote_t* remote = data;
+    while (event_loop_next_signal(fd) != 0) {
+        event_loop_stop(&remote->loop);
+    }
+}
+
+/** Joins the snake-server listening at socket path `path` and plays there
+ * until the server shuts down or the player quits with Ctrl-C.
+ *
+ * Returns 0 on success and -1 if the server couldn't be reached or sent
+ * something unreadable.
+ */
+int play_remote(const char* path) {
+    remote_t remote;
+    memset(&remote, 0, sizeof(remote));
+    remote.fd = net_connect(path);
+    if (remote.fd < 0) {
+        fprintf(stderr, "snake: could not connect to %s\n", path);
+        return -1;
+    }
+    unsigned char hello[1 + NET_MAX_NAME];
+    size_t name_len = strlen(g_name) < NET_MAX_NAME ? strlen(g_name)
+                                                    : NET_MAX_NAME;
+    hello[0] = NET_HELLO;
+    memcpy(hello + 1, g_name, name_len);
+    send(remote.fd, hello, 1 + name_len, MSG_NOSIGNAL);
+
+    static const int signals[] = {SIGINT, SIGTERM};
+    if (event_loop_init(&remote.loop) < 0 ||
+        event_loop_add(&remote.loop, remote.fd, EPOLLIN, on_remote_packet,
+                       &remote) < 0 ||
+        event_loop_add_signals(&remote.loop, signals,
+                               sizeof(signals) / sizeof(signals[0]),
+                               on_remote_signal, &remote) < 0) {
+        close(remote.fd);
+        return -1;
+    }
+    event_loop_run(&remote.loop);
+    event_loop_close(&remote.loop);
+    close(remote.fd);
+    if (remote.cells != NULL) {
+        endwin();
+    }
+    free(remote.cells);
+    free(remote.keyframe);
+    delta_reader_close(&remote.reader);
+    return remote.failed ? -1 : 0;
+}
+#endif
+
 int main(int argc, char** argv) {
     // Main program function — this is what gets called when you run the
     // generated executable file from the command line!
@@ -110,6 +490,19 @@ int main(int argc, char** argv) {
     if (status != INIT_SUCCESS) {
         return EXIT_FAILURE;
     }
+    // with $SNAKE_EDGE=wrap, a board without border walls wraps around
+    const char* edge = getenv("SNAKE_EDGE");
+    if (edge != NULL && strcmp(edge, "wrap") == 0 &&
+        set_board_edges(cells, width, height, EDGE_WRAP) < 0) {
+        fprintf(stderr, "snake: wrapping edges need `make LAYOUT=padded`\n");
+        teardown(cells, &snake);
+        return EXIT_FAILURE;
+    }
+    // with $SNAKE_FOOD=N, the board keeps N food items instead of one
+    const char* food = getenv("SNAKE_FOOD");
+    if (food != NULL && atoi(food) > 0) {
+        set_food_count(cells, width, height, atoi(food));
+    }
 
     // Read in the player's name & save its name and length
     char name_buffer[1000];
@@ -119,12 +512,66 @@ int main(int argc, char** argv) {
     // ? save name_buffer ?
     // ? save mbslen(name_buffer) ?
 
+#ifdef __linux__
+    // with $SNAKE_CONNECT set, join a snake-server instead of playing alone
+    const char* server_path = getenv("SNAKE_CONNECT");
+    if (server_path != NULL) {
+        int played = play_remote(server_path);
+        teardown(cells, &snake);
+        return played < 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+    }
+#endif
+
+    // scores are filed under the board as it was before play
+    uint64_t board_key = hiscore_board_key(cells, width, height);
+
     // Part 1A
     initialize_window(width, height);
-    while (g_game_over == 0) {
-        usleep(1000000);
-        update(cells, width, height, &snake, get_input(), snake_grows);
-        render_game(cells, width, height);
+    // frames go to $SNAKE_SHM, or a name of our own, for `snake-watch PID`
+    char frame_name[64];
+    shm_frame_default_name(frame_name, sizeof(frame_name), (long)getpid());
+    const char* shm_env = getenv("SNAKE_SHM");
+    g_publishing = shm_frame_create(&g_frame, shm_env ? shm_env : frame_name,
+                                    width, height) == 0;
+    if (g_publishing) {
+        shm_frame_publish(&g_frame, cells, g_score, g_game_over, g_name);
+    }
+
+    // record a delta stream of the game if $SNAKE_DELTA names a file or pipe
+    delta_writer_t delta;
+    const char* delta_path = getenv("SNAKE_DELTA");
+    FILE* delta_out = delta_path ? fopen(delta_path, "w") : NULL;
+    if (delta_out != NULL) {
+        delta_writer_open(&delta, delta_out, cells, width, height);
+        g_delta = &delta;
+    }
+
+    update_fn step = select_update(cells, width, height, snake_grows);
+    int terminated = -1;
+#ifdef __linux__
+    terminated = play_events(cells, width, height, &snake, snake_grows, step);
+#endif
+    if (terminated < 0) {
+        play_polling(cells, width, height, &snake, snake_grows, step);
+        terminated = 0;
+    }
+    save_score(board_key);
+    if (terminated && g_publishing) {
+        // a final frame, so viewers see the game end
+        shm_frame_publish(&g_frame, cells, g_score, 1, g_name);
+    }
+    if (g_delta != NULL) {
+        delta_writer_close(g_delta);
+        fclose(delta_out);
+        g_delta = NULL;
+    }
+    if (g_publishing) {
+        shm_frame_close(&g_frame);
+    }
+    if (terminated) {
+        teardown(cells, &snake);
+        endwin();
+        return EXIT_SUCCESS;
     }
     end_game(cells, width, height, &snake);
 }
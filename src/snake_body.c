@@ -0,0 +1,50 @@
+#include "snake_body.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "arena.h"
+
+/** Makes `body` empty, without freeing anything it held. The first
+ * snake_body_push_head() places the snake.
+ */
+void snake_body_init(snake_body_t* body) {
+    memset(body, 0, sizeof(*body));
+}
+
+/** Makes room for at least `num_dirs` directions, that is a body of
+ * num_dirs + 1 segments, so growing that far won't reallocate. The ring is
+ * unrolled into the new buffer so the tail's direction is at index 0.
+ */
+void snake_body_reserve(snake_body_t* body, size_t num_dirs) {
+    if (num_dirs <= body->cap) {
+        return;
+    }
+    size_t cap = (num_dirs + 3) & ~(size_t)3;
+    uint8_t* dirs = game_alloc(cap / 4);
+    memset(dirs, 0, cap / 4);
+    size_t used = body->length > 0 ? body->length - 1 : 0;
+    if (used > 0 && body->first % 4 == 0 && body->first + used <= body->cap) {
+        memcpy(dirs, body->dirs + body->first / 4, (used + 3) / 4);
+    } else {
+        for (size_t k = 0, i = body->first; k < used; k++) {
+            unsigned dir = (body->dirs[i >> 2] >> ((i & 3) * 2)) & 3;
+            dirs[k >> 2] |= (uint8_t)(dir << ((k & 3) * 2));
+            if (++i == body->cap) {
+                i = 0;
+            }
+        }
+    }
+    game_free(body->dirs);
+    body->dirs = dirs;
+    body->cap = cap;
+    body->first = 0;
+}
+
+/** Frees the body's memory and empties it.
+ */
+void snake_body_clear(snake_body_t* body) {
+    game_free(body->dirs);
+    memset(body, 0, sizeof(*body));
+}
@@ -0,0 +1,82 @@
+#ifndef SNAKE_BODY_H
+#define SNAKE_BODY_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** A snake's body as its head and tail positions plus the direction of each
+ * step from the tail to the head, packed four to a byte in a ring. A
+ * segment costs 2 bits, so a 10-million-segment body is about 2.5 MB.
+ *
+ * Moving the head writes one direction; moving the tail reads one and
+ * steps the tail position along it, so both are O(1) and the body never
+ * needs walking. The body doesn't know the board's layout: callers step
+ * positions themselves and pass the result in.
+ *
+ * A zeroed snake_body_t is an empty body.
+ * Fields:
+ *  - head, tail: positions of the first and last segments
+ *  - length: number of segments
+ *  - dirs: ring of cap 2-bit directions (enum direction values); the one
+ *    leaving the tail is at index `first`
+ *  - cap: capacity of `dirs` in directions, a multiple of 4
+ *  - first: ring index of the tail's direction
+ */
+typedef struct snake_body {
+    size_t head;
+    size_t tail;
+    size_t length;
+    uint8_t* dirs;
+    size_t cap;
+    size_t first;
+} snake_body_t;
+
+void snake_body_init(snake_body_t* body);
+void snake_body_reserve(snake_body_t* body, size_t num_dirs);
+void snake_body_clear(snake_body_t* body);
+
+/** Returns the direction from the tail to the next segment. Only valid if
+ * the body has at least two segments.
+ */
+static inline unsigned snake_body_tail_dir(const snake_body_t* body) {
+    return (body->dirs[body->first >> 2] >> ((body->first & 3) * 2)) & 3;
+}
+
+/** Adds a head at `new_head`, one step in direction `dir` from the current
+ * head. An empty body just gets the one segment, and `dir` is ignored.
+ */
+static inline void snake_body_push_head(snake_body_t* body, unsigned dir,
+                                        size_t new_head) {
+    if (body->length == 0) {
+        body->head = body->tail = new_head;
+        body->length = 1;
+        return;
+    }
+    if (body->length - 1 == body->cap) {
+        snake_body_reserve(body, body->cap + body->cap / 2 + 64);
+    }
+    size_t i = body->first + body->length - 1;
+    if (i >= body->cap) {
+        i -= body->cap;
+    }
+    unsigned shift = (i & 3) * 2;
+    body->dirs[i >> 2] =
+        (uint8_t)((body->dirs[i >> 2] & ~(3u << shift)) | (dir << shift));
+    body->head = new_head;
+    body->length++;
+}
+
+/** Removes the tail. `new_tail` must be the old tail stepped in
+ * snake_body_tail_dir(); it is ignored when removing the last segment.
+ */
+static inline void snake_body_pop_tail(snake_body_t* body, size_t new_tail) {
+    if (--body->length == 0) {
+        return;
+    }
+    body->tail = new_tail;
+    if (++body->first == body->cap) {
+        body->first = 0;
+    }
+}
+
+#endif
@@ -0,0 +1,52 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "board_gen.h"
+
+/** Prints a generated board string, for example
+ * `./snake 0 "$(./snake-gen maze 80 24)"`. The board is streamed to stdout a
+ * row at a time, so it may be any size.
+ */
+int main(int argc, char** argv) {
+    if (argc < 4 || argc > 7) {
+        printf("usage: snake-gen random|maze|rooms WIDTH HEIGHT [SEED "
+               "(default 1)] [PARAM] [GRASS (default 0)]\n"
+               "  PARAM is the wall percentage for random boards (default "
+               "20) and the room size for rooms (default 8)\n");
+        return 0;
+    }
+    board_gen_t gen;
+    memset(&gen, 0, sizeof(gen));
+    if (strcmp(argv[1], "random") == 0) {
+        gen.kind = GEN_RANDOM;
+    } else if (strcmp(argv[1], "maze") == 0) {
+        gen.kind = GEN_MAZE;
+    } else if (strcmp(argv[1], "rooms") == 0) {
+        gen.kind = GEN_ROOMS;
+    } else {
+        fprintf(stderr, "snake-gen: unknown kind %s\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+    gen.width = strtoull(argv[2], NULL, 10);
+    gen.height = strtoull(argv[3], NULL, 10);
+    gen.seed = argc > 4 ? strtoull(argv[4], NULL, 10) : 1;
+    long param = argc > 5 ? atol(argv[5]) : (gen.kind == GEN_ROOMS ? 8 : 20);
+    gen.density = (unsigned)param;
+    gen.room_size = (size_t)param;
+    gen.grass = argc > 6 ? strtoull(argv[6], NULL, 10) : 0;
+    if (gen.width < 3 || gen.height < 3) {
+        fprintf(stderr, "snake-gen: boards must be at least 3x3\n");
+        return EXIT_FAILURE;
+    }
+    if ((gen.kind == GEN_RANDOM && (param < 0 || param > 100)) ||
+        (gen.kind == GEN_ROOMS && param < 2)) {
+        fprintf(stderr, "snake-gen: invalid PARAM %ld\n", param);
+        return EXIT_FAILURE;
+    }
+    if (board_gen_write(&gen, stdout) < 0) {
+        return EXIT_FAILURE;
+    }
+    putchar('\n');
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,180 @@
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "event_loop.h"
+#include "net_proto.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+
+#define DEFAULT_SOCKET "/tmp/snake.sock"
+
+// A growable list of latencies, in nanoseconds.
+typedef struct samples {
+    uint64_t* values;
+    size_t count;
+    size_t cap;
+} samples_t;
+
+struct loadgen;
+
+// One simulated player.
+typedef struct player {
+    struct loadgen* gen;
+    int fd;
+    uint32_t seq;         // last input sent
+    uint64_t input_sent;  // when it was sent, or 0 once acknowledged
+    unsigned rng;
+} player_t;
+
+typedef struct loadgen {
+    event_loop_t loop;
+    player_t* players;
+    size_t num_players;
+    size_t num_dropped;
+    samples_t broadcast;  // tick start on the server to arrival here
+    samples_t input;      // input sent to the first tick that applied it
+} loadgen_t;
+
+static void add_sample(samples_t* samples, uint64_t value) {
+    if (samples->count == samples->cap) {
+        samples->cap = samples->cap ? samples->cap * 2 : 1024;
+        samples->values =
+            realloc(samples->values, samples->cap * sizeof(uint64_t));
+    }
+    samples->values[samples->count++] = value;
+}
+
+static int compare_u64(const void* a, const void* b) {
+    uint64_t x = *(const uint64_t*)a;
+    uint64_t y = *(const uint64_t*)b;
+    return (x > y) - (x < y);
+}
+
+/* Prints the median, 99th percentile and worst of a set of samples.
+ */
+static void report(const char* name, samples_t* samples) {
+    if (samples->count == 0) {
+        printf("%-10s no samples\n", name);
+        return;
+    }
+    qsort(samples->values, samples->count, sizeof(uint64_t), compare_u64);
+    uint64_t* v = samples->values;
+    size_t n = samples->count;
+    printf("%-10s %8zu samples  p50 %8.3f ms  p99 %8.3f ms  max %8.3f ms\n",
+           name, n, v[n / 2] / 1e6, v[n * 99 / 100] / 1e6, v[n - 1] / 1e6);
+}
+
+/* Sends a random key, as a player would. */
+static void send_input(player_t* player) {
+    player->rng = player->rng * 1103515245 + 12345;
+    enum input_key key = (enum input_key)((player->rng >> 16) % 4);
+    unsigned char msg[16];
+    size_t len = net_encode_input(msg, key, ++player->seq);
+    player->input_sent = net_now_ns();
+    send(player->fd, msg, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+}
+
+/* Times every tick as it arrives, and answers it with the next key.
+ */
+static void on_packet(int fd, uint32_t events, void* data) {
+    player_t* player = data;
+    loadgen_t* gen = player->gen;
+    unsigned char msg[1 << 16];
+    ssize_t len;
+    while ((len = recv(fd, msg, sizeof(msg), 0)) > 0) {
+        net_tick_t tick;
+        size_t header_len;
+        if (net_decode_tick(msg, len, &tick, &header_len) < 0) {
+            continue;  // the welcome
+        }
+        uint64_t now = net_now_ns();
+        add_sample(&gen->broadcast, now - tick.sent_ns);
+        if (player->input_sent != 0 && tick.ack_seq == player->seq) {
+            add_sample(&gen->input, now - player->input_sent);
+            player->input_sent = 0;
+        }
+        if (player->input_sent == 0) {
+            send_input(player);
+        }
+    }
+    if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        event_loop_remove(&gen->loop, fd);
+        close(fd);
+        player->fd = -1;
+        gen->num_dropped++;
+    }
+}
+
+static void on_deadline(int fd, uint32_t events, void* data) {
+    loadgen_t* gen = data;
+    event_loop_stop(&gen->loop);
+}
+
+/** Load generator for snake-server: connects many players that each send a
+ * random key every tick, then reports how long ticks take to reach the
+ * players and how long a key waits to be played.
+ */
+int main(int argc, char** argv) {
+    if (argc > 4) {
+        printf("usage: snake-loadgen [SOCKET (default %s)] [CLIENTS (default "
+               "64)] [SECONDS (default 5)]\n",
+               DEFAULT_SOCKET);
+        return 0;
+    }
+    const char* path = argc > 1 ? argv[1] : DEFAULT_SOCKET;
+    size_t num_players = argc > 2 ? (size_t)atol(argv[2]) : 64;
+    long seconds = argc > 3 ? atol(argv[3]) : 5;
+
+    loadgen_t gen;
+    memset(&gen, 0, sizeof(gen));
+    if (event_loop_init(&gen.loop) < 0) {
+        return EXIT_FAILURE;
+    }
+    gen.players = calloc(num_players, sizeof(player_t));
+    gen.num_players = num_players;
+    for (size_t i = 0; i < num_players; i++) {
+        player_t* player = &gen.players[i];
+        player->gen = &gen;
+        player->rng = (unsigned)i + 1;
+        player->fd = net_connect(path);
+        if (player->fd < 0 || event_loop_add(&gen.loop, player->fd, EPOLLIN,
+                                             on_packet, player) < 0) {
+            fprintf(stderr, "snake-loadgen: could not connect to %s\n", path);
+            return EXIT_FAILURE;
+        }
+        unsigned char hello[] = {NET_HELLO, 'b', 'o', 't'};
+        send(player->fd, hello, sizeof(hello), MSG_NOSIGNAL);
+    }
+    event_loop_add_timer(&gen.loop, seconds * 1000, on_deadline, &gen);
+    event_loop_run(&gen.loop);
+
+    printf("snake-loadgen: %zu players, %ld s, %zu dropped by the server\n",
+           num_players, seconds, gen.num_dropped);
+    report("broadcast", &gen.broadcast);
+    report("input", &gen.input);
+
+    for (size_t i = 0; i < num_players; i++) {
+        if (gen.players[i].fd >= 0) {
+            close(gen.players[i].fd);
+        }
+    }
+    event_loop_close(&gen.loop);
+    free(gen.players);
+    free(gen.broadcast.values);
+    free(gen.input.values);
+    return EXIT_SUCCESS;
+}
+#else
+int main(void) {
+    fprintf(stderr, "snake-loadgen needs Linux (epoll)\n");
+    return EXIT_FAILURE;
+}
+#endif
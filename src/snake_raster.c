@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "delta.h"
+#include "raster.h"
+
+/* Returns 1 if `path` ends in `suffix`.
+ */
+static int ends_with(const char* path, const char* suffix) {
+    size_t len = strlen(path);
+    size_t suffix_len = strlen(suffix);
+    return len >= suffix_len &&
+           strcmp(path + len - suffix_len, suffix) == 0;
+}
+
+/* Draws every tick of the stream, the starting board first. Returns the
+   number of frames drawn, or -1 on a corrupt stream or failed write.
+*/
+static long raster_stream(delta_reader_t* reader, raster_t* r) {
+    long frames = 0;
+    int more = 1;
+    while (more == 1) {
+        if (raster_add_frame(r, reader->cells) < 0) {
+            return -1;
+        }
+        frames++;
+        more = delta_reader_next(reader);
+    }
+    return more < 0 ? -1 : frames;
+}
+
+/** Turns a recorded game (a delta stream, see $SNAKE_DELTA in snake.c) into
+ * images without a terminal: one frame per tick, drawn as render_game()
+ * would. OUT gets a Y4M video if it ends in .y4m and concatenated PPM images
+ * otherwise; `-` is stdout.
+ */
+int main(int argc, char** argv) {
+    if (argc < 3 || argc > 6) {
+        printf("usage: snake-raster DELTA_FILE OUT [TILE (default 8)] "
+               "[FPS (default 10)] [THREADS (default: one per core)]\n");
+        return 0;
+    }
+    size_t tile = argc > 3 ? strtoull(argv[3], NULL, 10) : 8;
+    unsigned fps = argc > 4 ? (unsigned)strtoul(argv[4], NULL, 10) : 10;
+    size_t num_threads = argc > 5 ? strtoull(argv[5], NULL, 10) : 0;
+    enum raster_format format =
+        ends_with(argv[2], ".y4m") ? RASTER_Y4M : RASTER_PPM;
+
+    FILE* in = fopen(argv[1], "rb");
+    if (in == NULL) {
+        perror("snake-raster");
+        return EXIT_FAILURE;
+    }
+    delta_reader_t reader;
+    if (delta_reader_open(&reader, in) < 0) {
+        fprintf(stderr, "snake-raster: %s is not a delta stream\n", argv[1]);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+    int to_stdout = strcmp(argv[2], "-") == 0;
+    FILE* out = to_stdout ? stdout : fopen(argv[2], "wb");
+    if (out == NULL) {
+        perror("snake-raster");
+        delta_reader_close(&reader);
+        fclose(in);
+        return EXIT_FAILURE;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    raster_t r;
+    long frames = -1;
+    if (raster_open(&r, reader.width, reader.height, tile, format, fps,
+                    num_threads, out) < 0) {
+        fprintf(stderr, "snake-raster: can't draw %zux%zu boards at tile %zu\n",
+                reader.width, reader.height, tile);
+    } else {
+        frames = raster_stream(&reader, &r);
+        if (raster_close(&r) < 0 || frames < 0) {
+            fprintf(stderr, "snake-raster: corrupt stream or failed write\n");
+            frames = -1;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double secs =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    if (frames >= 0) {
+        fprintf(stderr, "snake-raster: %ld frames of %zux%zu in %.3f s "
+                "(%.1f frames/s)\n",
+                frames, reader.width * tile, reader.height * tile, secs,
+                secs > 0 ? frames / secs : 0.0);
+    }
+
+    delta_reader_close(&reader);
+    fclose(in);
+    if (!to_stdout) {
+        fclose(out);
+    }
+    return frames >= 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,373 @@
+#include <errno.h>
+#include <limits.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "common.h"
+#include "delta.h"
+#include "event_loop.h"
+#include "food_index.h"
+#include "multi_snake.h"
+#include "net_proto.h"
+
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#define MAX_CLIENTS 256
+#define DEFAULT_SOCKET "/tmp/snake.sock"
+
+// One connected player.
+typedef struct client {
+    struct server* server;
+    int fd;  // -1 if the slot is free
+    int id;  // the player's snake, or -1 until one spawns
+    enum input_key input;  // latest key since the last tick
+    uint32_t seq;          // sequence number of that key
+    char name[NET_MAX_NAME];
+} client_t;
+
+/** The server: one multi-snake game, the players, and the delta stream the
+ * ticks are encoded with.
+ * Fields:
+ *  - loop: the event loop
+ *  - listen_fd: the listening socket
+ *  - game: the authoritative game
+ *  - inputs: each snake's input for the next tick, indexed by snake id
+ *  - bots: snake ids played by the server, -1 while one waits to spawn
+ *  - num_bots: length of `bots`
+ *  - clients, num_clients: player slots and how many are in use
+ *  - delta: writes each tick's record into `record`
+ *  - record, record_size, record_out: the memory stream behind `delta`
+ */
+typedef struct server {
+    event_loop_t loop;
+    int listen_fd;
+    multi_game_t game;
+    enum input_key* inputs;
+    int* bots;
+    size_t num_bots;
+    client_t clients[MAX_CLIENTS];
+    size_t num_clients;
+    delta_writer_t delta;
+    char* record;
+    size_t record_size;
+    FILE* record_out;
+} server_t;
+
+/* Disconnects a player and takes its snake off the board.
+ */
+static void drop_client(server_t* server, client_t* client) {
+    event_loop_remove(&server->loop, client->fd);
+    close(client->fd);
+    if (client->id >= 0) {
+        multi_remove_snake(&server->game, client->id);
+    }
+    client->fd = -1;
+    server->num_clients--;
+}
+
+/* Sends a player its snake id and the whole board as it is now, split into
+   packets of at most NET_KEYFRAME_CHUNK keyframe bytes. Later ticks'
+   records apply on top of it, so it must be queued all at once: the
+   socket's send buffer is raised to fit it first. Returns -1 if it couldn't
+   be sent.
+*/
+static int send_welcome(server_t* server, client_t* client) {
+    char* frame = NULL;
+    size_t size = 0;
+    FILE* out = open_memstream(&frame, &size);
+    delta_writer_t keyframe;
+    delta_writer_open(&keyframe, out, server->game.cells, server->game.width,
+                      server->game.height);
+    delta_writer_close(&keyframe);
+    fclose(out);
+
+    // each packet costs the kernel a few KiB on top of its bytes
+    size_t num_packets = size / NET_KEYFRAME_CHUNK + 1;
+    size_t room = size + num_packets * 4096;
+    int sndbuf = room < INT_MAX ? (int)room : INT_MAX;
+    setsockopt(client->fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    unsigned char header[32];
+    size_t header_len = 0;
+    header[header_len++] = NET_WELCOME;
+    header_len += net_put_varint(header + header_len,
+                                 (uint64_t)(client->id + 1));
+    header_len += net_put_varint(header + header_len, size);
+    int status = 0;
+    size_t sent = 0;
+    do {
+        size_t chunk = size - sent < NET_KEYFRAME_CHUNK ? size - sent
+                                                        : NET_KEYFRAME_CHUNK;
+        struct iovec iov[2] = {{header, header_len}, {frame + sent, chunk}};
+        struct msghdr msg = {0};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        if (sendmsg(client->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) !=
+            (ssize_t)(header_len + chunk)) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS ||
+                errno == EMSGSIZE) {
+                fprintf(stderr,
+                        "snake-server: the board (%zu bytes) doesn't fit in "
+                        "a player's socket buffer; raise "
+                        "net.core.wmem_max\n",
+                        size);
+            }
+            status = -1;
+        }
+        sent += chunk;
+        header[0] = NET_KEYFRAME;
+        header_len = 1;
+    } while (status == 0 && sent < size);
+    free(frame);
+    return status;
+}
+
+/* Reads everything a player has sent: its name and keys. The latest key
+   wins, as in the single-player game.
+*/
+static void on_client(int fd, uint32_t events, void* data) {
+    client_t* client = data;
+    unsigned char msg[256];
+    ssize_t len;
+    while ((len = recv(fd, msg, sizeof(msg), 0)) > 0) {
+        const unsigned char* p = msg + 2;
+        uint64_t seq;
+        if (msg[0] == NET_INPUT && len >= 3 && msg[1] <= INPUT_NONE &&
+            net_get_varint(&p, msg + len, &seq) == 0) {
+            client->input = (enum input_key)msg[1];
+            client->seq = (uint32_t)seq;
+        } else if (msg[0] == NET_HELLO) {
+            size_t name_len = (size_t)len - 1 < NET_MAX_NAME - 1
+                                  ? (size_t)len - 1
+                                  : NET_MAX_NAME - 1;
+            memcpy(client->name, msg + 1, name_len);
+            client->name[name_len] = '\0';
+        }
+    }
+    if (len == 0 || (errno != EAGAIN && errno != EWOULDBLOCK)) {
+        drop_client(client->server, client);
+    }
+}
+
+/* Accepts new players, each with a fresh snake if there's room for one.
+ */
+static void on_accept(int fd, uint32_t events, void* data) {
+    server_t* server = data;
+    int client_fd;
+    while ((client_fd = net_accept(fd)) >= 0) {
+        client_t* client = NULL;
+        for (size_t i = 0; i < MAX_CLIENTS && client == NULL; i++) {
+            if (server->clients[i].fd < 0) {
+                client = &server->clients[i];
+            }
+        }
+        if (client == NULL) {
+            close(client_fd);  // full
+            continue;
+        }
+        memset(client, 0, sizeof(*client));
+        client->server = server;
+        client->fd = client_fd;
+        client->input = INPUT_NONE;
+        client->id = multi_spawn(&server->game);
+        server->num_clients++;
+        if (event_loop_add(&server->loop, client_fd, EPOLLIN, on_client,
+                           client) < 0 ||
+            send_welcome(server, client) < 0) {
+            event_loop_remove(&server->loop, client_fd);
+            close(client_fd);
+            if (client->id >= 0) {
+                multi_remove_snake(&server->game, client->id);
+            }
+            client->fd = -1;
+            server->num_clients--;
+        }
+    }
+}
+
+/* Plays one tick: applies each player's latest key and the bots' moves,
+   then sends every player the tick's record with its own status in front.
+   A player whose socket is full has fallen behind and is dropped, since
+   the records only make sense in order.
+*/
+static void on_tick(int fd, uint32_t events, void* data) {
+    server_t* server = data;
+    if (event_loop_timer_expirations(fd) == 0) {
+        return;
+    }
+    uint64_t start = net_now_ns();
+    multi_game_t* game = &server->game;
+
+    // snakes spawned below sit still for their first tick
+    for (size_t i = 0; i < game->max_snakes; i++) {
+        server->inputs[i] = INPUT_NONE;
+    }
+    for (size_t i = 0; i < server->num_bots; i++) {
+        if (server->bots[i] < 0) {
+            server->bots[i] = multi_spawn(game);
+        } else {
+            server->inputs[server->bots[i]] =
+                multi_bot_input(game, server->bots[i]);
+        }
+    }
+    for (size_t i = 0; i < MAX_CLIENTS; i++) {
+        client_t* client = &server->clients[i];
+        if (client->fd < 0) {
+            continue;
+        }
+        if (client->id < 0) {
+            client->id = multi_spawn(game);  // dead players come back
+        } else {
+            server->inputs[client->id] = client->input;
+        }
+        client->input = INPUT_NONE;
+    }
+    multi_step(game, server->inputs);
+    // a dead snake's id may go to a new snake, so forget it straight away
+    for (size_t i = 0; i < server->num_bots; i++) {
+        if (server->bots[i] >= 0 && !game->snakes[server->bots[i]].alive) {
+            server->bots[i] = -1;
+        }
+    }
+
+    // the record goes to the start of the memory stream every time; scores
+    // and deaths are per player, so they travel in the tick header instead
+    fseek(server->record_out, 0, SEEK_SET);
+    delta_end_tick(&server->delta, game->cells, 0, 0);
+    fflush(server->record_out);
+    size_t record_len = (size_t)ftell(server->record_out);
+
+    for (size_t i = 0; i < MAX_CLIENTS; i++) {
+        client_t* client = &server->clients[i];
+        if (client->fd < 0) {
+            continue;
+        }
+        net_tick_t tick = {game->tick, client->id, 0, 0, client->seq, start};
+        if (client->id >= 0) {
+            tick.alive = game->snakes[client->id].alive;
+            tick.score = game->snakes[client->id].score;
+            if (!tick.alive) {
+                client->id = -1;  // respawned next tick
+            }
+        }
+        unsigned char header[NET_MAX_HEADER];
+        struct iovec iov[2] = {{header, net_encode_tick(header, &tick)},
+                               {server->record, record_len}};
+        struct msghdr msg = {0};
+        msg.msg_iov = iov;
+        msg.msg_iovlen = 2;
+        if (sendmsg(client->fd, &msg, MSG_DONTWAIT | MSG_NOSIGNAL) < 0) {
+            drop_client(server, client);
+        }
+    }
+}
+
+/* Stops the server on SIGINT or SIGTERM.
+ */
+static void on_signal(int fd, uint32_t events, void* data) {
+    server_t* server = data;
+    while (event_loop_next_signal(fd) != 0) {
+        event_loop_stop(&server->loop);
+    }
+}
+
+/** Runs a lockstep multiplayer game. Players connect with
+ * `SNAKE_CONNECT=<SOCKET> snake 0`; the server runs the authoritative board,
+ * plays a tick every TICK_MS milliseconds and sends each player only what
+ * changed. With $SNAKE_FOOD=N the board keeps N food items instead of one.
+ */
+int main(int argc, char** argv) {
+    if (argc > 5) {
+        printf("usage: snake-server [SOCKET (default %s)] [TICK_MS (default "
+               "100)] [BOTS (default 0)] [BOARD STRING]\n",
+               DEFAULT_SOCKET);
+        return 0;
+    }
+    const char* path = argc > 1 ? argv[1] : DEFAULT_SOCKET;
+    long tick_ms = argc > 2 ? atol(argv[2]) : 100;
+    size_t num_bots = argc > 3 ? (size_t)atol(argv[3]) : 0;
+    char* board = argc > 4 && *argv[4] != '\0' ? argv[4] : NULL;
+    if (tick_ms <= 0) {
+        tick_ms = 100;
+    }
+
+    const char* food = getenv("SNAKE_FOOD");
+    if (food != NULL && atoi(food) > 0) {
+        g_food_count = atoi(food);
+    }
+
+    static server_t server;
+    if (multi_init(&server.game, board, MAX_CLIENTS + num_bots, 1) !=
+        INIT_SUCCESS) {
+        fprintf(stderr, "snake-server: invalid board\n");
+        return EXIT_FAILURE;
+    }
+    // the board's own snake has no player
+    multi_remove_snake(&server.game, 0);
+    server.inputs = malloc(server.game.max_snakes * sizeof(enum input_key));
+    server.num_bots = num_bots;
+    server.bots = malloc((num_bots + 1) * sizeof(int));
+    for (size_t i = 0; i < num_bots; i++) {
+        server.bots[i] = -1;
+    }
+    for (size_t i = 0; i < MAX_CLIENTS; i++) {
+        server.clients[i].fd = -1;
+    }
+
+    // every cell change from here on is recorded for the next tick
+    server.record_out = open_memstream(&server.record, &server.record_size);
+    delta_writer_open(&server.delta, server.record_out, server.game.cells,
+                      server.game.width, server.game.height);
+    g_delta = &server.delta;
+
+    static const int signals[] = {SIGINT, SIGTERM};
+    server.listen_fd = net_listen(path);
+    if (server.listen_fd < 0 || event_loop_init(&server.loop) < 0) {
+        fprintf(stderr, "snake-server: could not listen on %s\n", path);
+        return EXIT_FAILURE;
+    }
+    if (event_loop_add(&server.loop, server.listen_fd, EPOLLIN, on_accept,
+                       &server) < 0 ||
+        event_loop_add_timer(&server.loop, tick_ms, on_tick, &server) < 0 ||
+        event_loop_add_signals(&server.loop, signals,
+                               sizeof(signals) / sizeof(signals[0]), on_signal,
+                               &server) < 0) {
+        fprintf(stderr, "snake-server: could not set up the event loop\n");
+        return EXIT_FAILURE;
+    }
+    printf("snake-server: listening on %s, %ldms ticks, %zux%zu board\n", path,
+           tick_ms, server.game.width, server.game.height);
+    fflush(stdout);
+    event_loop_run(&server.loop);
+
+    for (size_t i = 0; i < MAX_CLIENTS; i++) {
+        if (server.clients[i].fd >= 0) {
+            drop_client(&server, &server.clients[i]);
+        }
+    }
+    event_loop_close(&server.loop);
+    close(server.listen_fd);
+    unlink(path);
+    g_delta = NULL;
+    delta_writer_close(&server.delta);
+    fclose(server.record_out);
+    free(server.record);
+    free(server.inputs);
+    free(server.bots);
+    multi_teardown(&server.game);
+    return EXIT_SUCCESS;
+}
+#else
+int main(void) {
+    fprintf(stderr, "snake-server needs Linux (epoll and timerfd)\n");
+    return EXIT_FAILURE;
+}
+#endif
@@ -0,0 +1,78 @@
+#define _XOPEN_SOURCE_EXTENDED 1
+#include <curses.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "common.h"
+#include "game_over.h"
+#include "mbstrings.h"
+#include "render.h"
+#include "shm_frame.h"
+
+/** Watches a game running in another process. The game publishes every
+ * tick to shared memory (see shm_frame.c); this attaches read-only and
+ * draws each new frame until the game ends or `q` is pressed, or the
+ * game's process goes away without a final frame. The game is named by its
+ * pid, or by the $SNAKE_SHM name it was started with.
+ */
+int main(int argc, char** argv) {
+    if (argc != 2) {
+        printf("usage: snake-watch <GAME PID | SHM NAME>\n");
+        return 0;
+    }
+    char name[64];
+    char* end;
+    long pid = strtol(argv[1], &end, 10);
+    if (*argv[1] != '\0' && *end == '\0') {
+        shm_frame_default_name(name, sizeof(name), pid);
+    } else {
+        snprintf(name, sizeof(name), "%s", argv[1]);
+    }
+
+    shm_frame_t frame;
+    if (shm_frame_attach(&frame, name) < 0) {
+        fprintf(stderr, "snake-watch: no game is publishing to %s\n", name);
+        return EXIT_FAILURE;
+    }
+    shm_frame_snapshot_t snapshot;
+    snapshot.cells = malloc(shm_frame_num_cells(&frame) * sizeof(int));
+
+    // halfdelay mode: getch() waits up to 1/10th of a second, which paces
+    // how often we look for a new frame
+    initialize_window(frame.width, frame.height);
+    uint32_t seen = 0;
+    int game_over = 0;
+    int gone = 0;
+    while (!game_over) {
+        if (shm_frame_seq(&frame) != seen &&
+            shm_frame_read(&frame, &snapshot)) {
+            seen = snapshot.seq;
+            g_score = snapshot.score;
+            render_game(snapshot.cells, snapshot.width, snapshot.height);
+            game_over = snapshot.game_over;
+        } else if (!shm_frame_writer_alive(&frame)) {
+            gone = 1;
+            break;
+        }
+        if (getch() == 'q') {
+            break;
+        }
+    }
+
+    if (game_over) {
+        g_name = snapshot.name;
+        g_name_len = mbslen(snapshot.name);
+        render_game_over(frame.width, frame.height);
+        cbreak();  // leave halfdelay mode
+        getch();
+    }
+    endwin();
+    free(snapshot.cells);
+    shm_frame_close(&frame);
+    if (gone) {
+        fprintf(stderr, "snake-watch: the game was killed\n");
+    }
+    return 0;
+}
@@ -0,0 +1,448 @@
+#include "tiled_board.h"
+
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arena.h"
+#include "common.h"
+#include "food_index.h"
+#include "game.h"
+#include "game_setup.h"
+#include "snake_body.h"
+#include "zobrist.h"
+
+#define TILED_MIN_CAPACITY 64
+
+// The position of every cell off an open-edged board. It reads as a wall.
+#define OFF_BOARD SIZE_MAX
+
+/* Returns the hash table slot where `key` should start probing.
+ */
+static size_t tile_slot(tiled_board_t* board, size_t key) {
+    // Fibonacci hashing spreads neighbouring tile keys across the table
+    return (key * 11400714819323198485ull) & (board->capacity - 1);
+}
+
+/** Initializes an empty (all plain cells) tiled board.
+ * Arguments:
+ *  - board: the board to initialize.
+ *  - width: width of the board.
+ *  - height: height of the board.
+ */
+void tiled_board_init(tiled_board_t* board, size_t width, size_t height) {
+    board->width = width;
+    board->height = height;
+    board->tiles_x = (width + TILE_MASK) >> TILE_SHIFT;
+    board->capacity = TILED_MIN_CAPACITY;
+    board->keys = calloc(board->capacity, sizeof(size_t));
+    board->tiles = calloc(board->capacity, sizeof(unsigned char*));
+    board->num_tiles = 0;
+    board->last_key = 0;
+    board->last_tile = NULL;
+    board->edges = EDGE_OPEN;
+}
+
+/** Frees every tile of the board.
+ */
+void tiled_board_free(tiled_board_t* board) {
+    for (size_t i = 0; i < board->capacity; i++) {
+        free(board->tiles[i]);
+    }
+    free(board->keys);
+    free(board->tiles);
+    memset(board, 0, sizeof(*board));
+}
+
+/** Returns the tile with key `key`, or NULL if it is implicitly empty.
+ */
+unsigned char* tiled_find_tile(tiled_board_t* board, size_t key) {
+    size_t slot = tile_slot(board, key);
+    while (board->keys[slot] != 0) {
+        if (board->keys[slot] == key) {
+            board->last_key = key;
+            board->last_tile = board->tiles[slot];
+            return board->tiles[slot];
+        }
+        slot = (slot + 1) & (board->capacity - 1);
+    }
+    return NULL;
+}
+
+/* Doubles the hash table and re-inserts every tile.
+ */
+static void grow_table(tiled_board_t* board) {
+    size_t old_capacity = board->capacity;
+    size_t* old_keys = board->keys;
+    unsigned char** old_tiles = board->tiles;
+
+    board->capacity = old_capacity * 2;
+    board->keys = calloc(board->capacity, sizeof(size_t));
+    board->tiles = calloc(board->capacity, sizeof(unsigned char*));
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_keys[i] == 0) {
+            continue;
+        }
+        size_t slot = tile_slot(board, old_keys[i]);
+        while (board->keys[slot] != 0) {
+            slot = (slot + 1) & (board->capacity - 1);
+        }
+        board->keys[slot] = old_keys[i];
+        board->tiles[slot] = old_tiles[i];
+    }
+    free(old_keys);
+    free(old_tiles);
+}
+
+/** Allocates a plain tile for key `key`, which must not exist yet, and
+ * returns it.
+ */
+unsigned char* tiled_make_tile(tiled_board_t* board, size_t key) {
+    if (2 * (board->num_tiles + 1) > board->capacity) {
+        grow_table(board);
+    }
+    size_t slot = tile_slot(board, key);
+    while (board->keys[slot] != 0) {
+        slot = (slot + 1) & (board->capacity - 1);
+    }
+    board->keys[slot] = key;
+    board->tiles[slot] = calloc(TILE_CELLS, 1);
+    board->num_tiles++;
+    board->last_key = key;
+    board->last_tile = board->tiles[slot];
+    return board->tiles[slot];
+}
+
+/* Returns the number of cells food can be placed on. Cells outside every
+   tile are plain, so only the tiles need looking at.
+*/
+static size_t count_free_tiled(tiled_board_t* board) {
+    size_t taken = 0;
+    for (size_t i = 0; i < board->capacity; i++) {
+        if (board->keys[i] == 0) {
+            continue;
+        }
+        for (size_t j = 0; j < TILE_CELLS; j++) {
+            int cell = board->tiles[i][j];
+            taken += cell != PLAIN_CELL && cell != FLAG_GRASS;
+        }
+    }
+    return board->width * board->height - taken;
+}
+
+/** Initialize a tiled board and snake. Mirrors initialize_game().
+ * Arguments:
+ *  - board: the tiled board to initialize.
+ *  - snake_p: a pointer to your snake struct. Snake positions are stored as
+ *    size_t (row * width + col), since huge boards overflow an int.
+ *  - board_rep: a string representing the initial board. May be NULL for
+ *    default board.
+ */
+enum board_init_status tiled_initialize_game(tiled_board_t* board,
+                                             snake_t* snake_p,
+                                             char* board_rep) {
+    enum board_init_status status;
+    snake_body_init(&snake_p->snake_pos);
+    if (board_rep == NULL) {
+        int* cells;
+        size_t width;
+        size_t height;
+        status = initialize_default_board(&cells, &width, &height);
+        tiled_board_init(board, width, height);
+        for (size_t row = 0; row < height; row++) {
+            for (size_t col = 0; col < width; col++) {
+                tiled_set(board, row, col, cells[cell_index(row, col, width)]);
+            }
+        }
+        game_free(cells);
+
+        size_t init_pos = 2 * width + 2;
+        snake_body_push_head(&snake_p->snake_pos, RIGHT, init_pos);
+    } else {
+        status = tiled_decompress_board_str(board, snake_p, board_rep);
+    }
+
+    if (status == INIT_SUCCESS) {
+        // as place_start_food(): never more food than free cells
+        size_t free_cells = count_free_tiled(board);
+        for (int i = 0; i < g_food_count && (size_t)i < free_cells; i++) {
+            tiled_place_food(board);
+        }
+        g_game_over = 0;
+        g_score = 0;
+        snake_p->snake_dir = RIGHT;
+    }
+    return status;
+}
+
+/* Returns the flag for a board letter, or -1 if it is not a valid letter.
+ */
+static int letter_flag(char c) {
+    switch (c) {
+        case 'E':
+            return PLAIN_CELL;
+        case 'W':
+            return FLAG_WALL;
+        case 'G':
+            return FLAG_GRASS;
+        case 'S':
+            return FLAG_SNAKE;
+    }
+    return -1;
+}
+
+/** Decodes a compressed board string into a tiled board without building a
+ * dense cell array. Runs of `E` only advance the column, so they never touch
+ * memory. Accepts the same format, and returns the same statuses, as
+ * decompress_board_str(). The string is not modified.
+ * Arguments:
+ *  - board: the tiled board to initialize. On failure it may be partially
+ *    filled and must still be freed.
+ *  - snake_p: a pointer to your snake struct.
+ *  - compressed: a string that contains the representation of the board.
+ */
+enum board_init_status tiled_decompress_board_str(tiled_board_t* board,
+                                                  snake_t* snake_p,
+                                                  char* compressed) {
+    // the first non-empty segment holds the dimensions
+    char* seg = compressed;
+    while (*seg == '|') {
+        seg++;
+    }
+    char* seg_end = seg;
+    while (*seg_end != '\0' && *seg_end != '|') {
+        seg_end++;
+    }
+    char header[64];
+    size_t header_len = seg_end - seg;
+    if (header_len >= sizeof(header)) {
+        header_len = sizeof(header) - 1;
+    }
+    memcpy(header, seg, header_len);
+    header[header_len] = '\0';
+    char* dim = strtok(header, "Bx");
+    size_t height = dim ? (size_t)atoi(dim) : 0;
+    dim = dim ? strtok(NULL, "Bx") : NULL;
+    size_t width = dim ? (size_t)atoi(dim) : 0;
+    tiled_board_init(board, width, height);
+
+    // count rows (empty segments between `|`s are not rows)
+    size_t num_rows = 0;
+    for (char* p = seg_end; *p != '\0'; p++) {
+        if (*p != '|' && (p[-1] == '|')) {
+            num_rows++;
+        }
+    }
+    if (num_rows != height) {
+        return INIT_ERR_INCORRECT_DIMENSIONS;
+    }
+
+    int check_snake = 0;
+    int curr_flag = -1;
+    size_t row = 0;
+    char* p = seg_end;
+    while (*p != '\0') {
+        if (*p == '|') {
+            p++;
+            continue;
+        }
+        size_t col = 0;
+        while (*p != '\0' && *p != '|') {
+            char c = *p;
+            if ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z')) {
+                curr_flag = letter_flag(c);
+                if (curr_flag == -1) {
+                    return INIT_ERR_BAD_CHAR;
+                }
+                p++;
+            } else if (c >= '0' && c <= '9') {
+                size_t num_cells = 0;
+                while (*p >= '0' && *p <= '9') {
+                    num_cells = num_cells * 10 + (*p - '0');
+                    p++;
+                }
+                if (curr_flag == -1) {
+                    return INIT_ERR_BAD_CHAR;  // a run with no cell type
+                }
+                if (curr_flag == FLAG_SNAKE) {
+                    check_snake += num_cells;
+                    if (check_snake != 1) {
+                        return INIT_ERR_WRONG_SNAKE_NUM;
+                    }
+                    size_t start_pos = row * width + col;
+                    snake_body_init(&snake_p->snake_pos);
+                    snake_body_push_head(&snake_p->snake_pos, RIGHT, start_pos);
+                }
+                // cells past the row end are dropped; the row then fails the
+                // width check below
+                if (curr_flag != PLAIN_CELL) {
+                    for (size_t i = 0; i < num_cells && col + i < width; i++) {
+                        tiled_set(board, row, col + i, curr_flag);
+                    }
+                }
+                col += num_cells;
+            } else {
+                p++;
+            }
+        }
+        if (col != width) {
+            return INIT_ERR_INCORRECT_DIMENSIONS;
+        }
+        row++;
+    }
+    if (check_snake != 1) {
+        return INIT_ERR_WRONG_SNAKE_NUM;
+    }
+    return INIT_SUCCESS;
+}
+
+/** Sets what happens at the edges of the board: the snake dies running off
+ * it (EDGE_OPEN, the default) or comes back on at the opposite edge
+ * (EDGE_WRAP). Border walls on the board itself are unaffected.
+ */
+void tiled_set_board_edges(tiled_board_t* board, enum edge_mode mode) {
+    board->edges = mode;
+}
+
+/** Starts tracking a tiled game's hash, as zobrist_init() does for a cells
+ * array. Only the allocated tiles are visited, so huge boards are cheap.
+ */
+void tiled_zobrist_init(zobrist_t* zobrist, tiled_board_t* board,
+                        snake_t* snake_p, int score) {
+    uint64_t hash = 0;
+    for (size_t i = 0; i < board->capacity; i++) {
+        if (board->keys[i] == 0) {
+            continue;
+        }
+        size_t key = board->keys[i] - 1;
+        size_t row0 = key / board->tiles_x * TILE_SIZE;
+        size_t col0 = key % board->tiles_x * TILE_SIZE;
+        for (size_t j = 0; j < TILE_CELLS; j++) {
+            // plain cells, including the padding past the board's edges,
+            // hash to 0
+            size_t row = row0 + (j >> TILE_SHIFT);
+            size_t col = col0 + (j & TILE_MASK);
+            hash ^= zobrist_cell_key(row * board->width + col,
+                                     board->tiles[i][j]);
+        }
+    }
+    zobrist_start(zobrist, hash, board->width, snake_p->snake_pos.head,
+                  snake_p->snake_dir, score);
+}
+
+// update()'s rules reach a tiled board through these.
+
+static int tiled_get_pos(void* data, size_t pos) {
+    tiled_board_t* board = data;
+    if (pos == OFF_BOARD) {
+        return FLAG_WALL;
+    }
+    return tiled_get(board, pos / board->width, pos % board->width);
+}
+
+static void tiled_set_pos(void* data, size_t pos, int value) {
+    tiled_board_t* board = data;
+    size_t row = pos / board->width;
+    size_t col = pos % board->width;
+    if (g_zobrist != NULL) {
+        zobrist_set_index(g_zobrist, pos, tiled_get(board, row, col), value);
+    }
+    tiled_set(board, row, col, value);
+}
+
+static size_t tiled_step(void* data, size_t pos, enum direction dir) {
+    tiled_board_t* board = data;
+    size_t width = board->width;
+    size_t height = board->height;
+    size_t row = pos / width;
+    size_t col = pos % width;
+    int wrap = board->edges == EDGE_WRAP;
+    switch (dir) {
+        case UP:
+            if (row == 0) {
+                return wrap ? (height - 1) * width + col : OFF_BOARD;
+            }
+            return pos - width;
+        case DOWN:
+            if (row == height - 1) {
+                return wrap ? col : OFF_BOARD;
+            }
+            return pos + width;
+        case LEFT:
+            if (col == 0) {
+                return wrap ? pos + width - 1 : OFF_BOARD;
+            }
+            return pos - 1;
+        case RIGHT:
+        default:
+            if (col == width - 1) {
+                return wrap ? pos - col : OFF_BOARD;
+            }
+            return pos + 1;
+    }
+}
+
+static void tiled_place_food_at(void* data) {
+    tiled_place_food(data);
+}
+
+static void tiled_end_tick(void* data, snake_t* snake_p, enum direction dir,
+                           int score, int game_over) {
+    if (g_zobrist != NULL) {
+        zobrist_end_tick_index(g_zobrist, snake_p->snake_pos.head, dir,
+                               score);
+    }
+}
+
+static const cell_access_t tiled_access = {
+    tiled_get_pos,       tiled_set_pos, tiled_step,
+    tiled_place_food_at, NULL,          tiled_end_tick,
+};
+
+/** Updates a tiled game by a single step, by the rules of update().
+ * Arguments:
+ *  - board: the tiled board.
+ *  - snake_p: pointer to your snake struct.
+ *  - input: the next input.
+ *  - growing: 0 if the snake does not grow on eating, 1 if it does.
+ */
+void tiled_update(tiled_board_t* board, snake_t* snake_p,
+                  enum input_key input, int growing) {
+    update_on(&tiled_access, board, snake_p, input, growing);
+}
+
+/** Sets a random empty or grass cell of the tiled board to food. Draws
+ * exactly as place_food() does while the cell count fits generate_index(),
+ * so a tiled game matches the same game on a cells array; bigger boards
+ * pick the row and column with separate draws.
+ */
+void tiled_place_food(tiled_board_t* board) {
+    size_t width = board->width;
+    size_t num_cells = width * board->height;
+    while (1) {
+        size_t row;
+        size_t col;
+        if (num_cells <= UINT_MAX) {
+            unsigned food_index = generate_index((unsigned)num_cells);
+            row = food_index / width;
+            col = food_index % width;
+        } else {
+            row = generate_index(board->height);
+            col = generate_index(width);
+        }
+        int cell = tiled_get(board, row, col);
+        if (cell == PLAIN_CELL || cell == FLAG_GRASS) {
+            tiled_set_pos(board, row * width + col, cell | FLAG_FOOD);
+            return;
+        }
+    }
+}
+
+/** Frees a tiled game's board and snake.
+ */
+void tiled_teardown(tiled_board_t* board, snake_t* snake_p) {
+    tiled_board_free(board);
+    snake_body_clear(&snake_p->snake_pos);
+}
@@ -0,0 +1,96 @@
+#ifndef TILED_BOARD_H
+#define TILED_BOARD_H
+
+#include <stddef.h>
+
+#include "common.h"
+#include "game_setup.h"
+#include "zobrist.h"
+
+// Tiles are TILE_SIZE x TILE_SIZE squares of cells, one byte per cell.
+#define TILE_SHIFT 4
+#define TILE_SIZE (1 << TILE_SHIFT)
+#define TILE_MASK (TILE_SIZE - 1)
+#define TILE_CELLS (TILE_SIZE * TILE_SIZE)
+
+/** Sparse board storage for huge, mostly empty boards. Only tiles that hold
+ * a non-plain cell are allocated; every other tile is implicitly empty. Tiles
+ * are found through an open-addressing hash table keyed by tile coordinates.
+ * Games play by update()'s rules, through update_on(). Positions are
+ * row-major (row * width + col) whatever the cell layout. g_zobrist is kept
+ * up to date (start it with tiled_zobrist_init()); deltas and the food
+ * index address dense cells arrays, so tiled games don't record them.
+ * Fields:
+ *  - width, height: board dimensions in cells
+ *  - tiles_x: number of tiles per row of tiles
+ *  - keys: tile keys (tile row * tiles_x + tile column, plus one so that 0
+ *    marks an unused slot)
+ *  - tiles: tile storage, parallel to keys
+ *  - capacity: number of slots in keys/tiles (a power of two)
+ *  - num_tiles: number of allocated tiles
+ *  - last_key, last_tile: the most recently looked up tile
+ *  - edges: what happens at the edges of the board, EDGE_OPEN unless
+ *    tiled_set_board_edges() says otherwise. Any layout supports both.
+ */
+typedef struct tiled_board {
+    size_t width;
+    size_t height;
+    size_t tiles_x;
+    size_t* keys;
+    unsigned char** tiles;
+    size_t capacity;
+    size_t num_tiles;
+    size_t last_key;
+    unsigned char* last_tile;
+    enum edge_mode edges;
+} tiled_board_t;
+
+void tiled_board_init(tiled_board_t* board, size_t width, size_t height);
+void tiled_board_free(tiled_board_t* board);
+unsigned char* tiled_find_tile(tiled_board_t* board, size_t key);
+unsigned char* tiled_make_tile(tiled_board_t* board, size_t key);
+
+/** Returns the flags of the cell at (row, col).
+ */
+static inline int tiled_get(tiled_board_t* board, size_t row, size_t col) {
+    size_t key = (row >> TILE_SHIFT) * board->tiles_x + (col >> TILE_SHIFT) + 1;
+    unsigned char* tile = key == board->last_key ? board->last_tile
+                                                 : tiled_find_tile(board, key);
+    if (tile == NULL) {
+        return PLAIN_CELL;
+    }
+    return tile[((row & TILE_MASK) << TILE_SHIFT) | (col & TILE_MASK)];
+}
+
+/** Sets the flags of the cell at (row, col), allocating its tile if needed.
+ */
+static inline void tiled_set(tiled_board_t* board, size_t row, size_t col,
+                             int flags) {
+    size_t key = (row >> TILE_SHIFT) * board->tiles_x + (col >> TILE_SHIFT) + 1;
+    unsigned char* tile = key == board->last_key ? board->last_tile
+                                                 : tiled_find_tile(board, key);
+    if (tile == NULL) {
+        if (flags == PLAIN_CELL) {
+            return;
+        }
+        tile = tiled_make_tile(board, key);
+    }
+    tile[((row & TILE_MASK) << TILE_SHIFT) | (col & TILE_MASK)] =
+        (unsigned char)flags;
+}
+
+enum board_init_status tiled_initialize_game(tiled_board_t* board,
+                                             snake_t* snake_p,
+                                             char* board_rep);
+enum board_init_status tiled_decompress_board_str(tiled_board_t* board,
+                                                  snake_t* snake_p,
+                                                  char* compressed);
+void tiled_set_board_edges(tiled_board_t* board, enum edge_mode mode);
+void tiled_zobrist_init(zobrist_t* zobrist, tiled_board_t* board,
+                        snake_t* snake_p, int score);
+void tiled_update(tiled_board_t* board, snake_t* snake_p,
+                  enum input_key input, int growing);
+void tiled_place_food(tiled_board_t* board);
+void tiled_teardown(tiled_board_t* board, snake_t* snake_p);
+
+#endif
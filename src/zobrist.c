@@ -0,0 +1,63 @@
+#include "zobrist.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+#include "snake_body.h"
+
+_Thread_local zobrist_t* g_zobrist;
+
+/** Hashes a game's state from scratch, in O(width * height). The result is
+ * what an incrementally maintained hash of the same state holds.
+ * Arguments:
+ *  - cells: the board.
+ *  - width, height: board dimensions.
+ *  - snake_p: the snake; only its head and direction are hashed.
+ *  - score: the score.
+ */
+uint64_t zobrist_compute(int* cells, size_t width, size_t height,
+                         snake_t* snake_p, int score) {
+    uint64_t hash = 0;
+    for (size_t row = 0; row < height; row++) {
+        for (size_t col = 0; col < width; col++) {
+            hash ^= zobrist_cell_key(row * width + col,
+                                     cells[cell_index(row, col, width)]);
+        }
+    }
+    size_t head_pos = snake_p->snake_pos.head;
+    size_t head = cell_row(head_pos, width) * width + cell_col(head_pos, width);
+    hash ^= zobrist_mix(head ^ ZOBRIST_HEAD_SALT);
+    hash ^= zobrist_mix((uint64_t)snake_p->snake_dir ^ ZOBRIST_DIR_SALT);
+    hash ^= zobrist_mix((uint64_t)score ^ ZOBRIST_SCORE_SALT);
+    return hash;
+}
+
+/** Starts tracking a game's hash. Set g_zobrist to it to keep it up to date
+ * as the game runs.
+ */
+void zobrist_init(zobrist_t* zobrist, int* cells, size_t width, size_t height,
+                  snake_t* snake_p, int score) {
+    size_t head_pos = snake_p->snake_pos.head;
+    zobrist->hash = zobrist_compute(cells, width, height, snake_p, score);
+    zobrist->width = width;
+    zobrist->head =
+        cell_row(head_pos, width) * width + cell_col(head_pos, width);
+    zobrist->dir = snake_p->snake_dir;
+    zobrist->score = score;
+}
+
+/** Starts tracking the hash of a game on a board that isn't a cells array
+ * (see tiled_board.c), given the XOR of zobrist_cell_key() over its cells,
+ * the row-major index of the snake's head, its direction and the score.
+ */
+void zobrist_start(zobrist_t* zobrist, uint64_t cells_hash, size_t width,
+                   size_t head, int dir, int score) {
+    zobrist->hash = cells_hash ^ zobrist_mix(head ^ ZOBRIST_HEAD_SALT) ^
+                    zobrist_mix((uint64_t)dir ^ ZOBRIST_DIR_SALT) ^
+                    zobrist_mix((uint64_t)score ^ ZOBRIST_SCORE_SALT);
+    zobrist->width = width;
+    zobrist->head = head;
+    zobrist->dir = dir;
+    zobrist->score = score;
+}
@@ -0,0 +1,124 @@
+#ifndef ZOBRIST_H
+#define ZOBRIST_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "common.h"
+
+/** Incrementally maintained 64-bit Zobrist hash of a game's state: every
+ * cell's flags, the snake's head and direction, and the score. Equal states
+ * hash equally whatever the cell layout.
+ * Fields:
+ *  - hash: the current hash
+ *  - width: board width
+ *  - head: row-major index of the snake's head
+ *  - dir: the snake's direction
+ *  - score: the score
+ */
+typedef struct zobrist {
+    uint64_t hash;
+    size_t width;
+    size_t head;
+    int dir;
+    int score;
+} zobrist_t;
+
+/** The hash that update() and place_food() keep up to date, or NULL (the
+ * default) for none.
+ */
+extern _Thread_local zobrist_t* g_zobrist;
+
+void zobrist_init(zobrist_t* zobrist, int* cells, size_t width, size_t height,
+                  snake_t* snake_p, int score);
+uint64_t zobrist_compute(int* cells, size_t width, size_t height,
+                         snake_t* snake_p, int score);
+void zobrist_start(zobrist_t* zobrist, uint64_t cells_hash, size_t width,
+                   size_t head, int dir, int score);
+
+#define ZOBRIST_CELL_SALT 0x2545f4914f6cdd1dull
+#define ZOBRIST_HEAD_SALT 0x9e3779b97f4a7c15ull
+#define ZOBRIST_DIR_SALT 0xbf58476d1ce4e5b9ull
+#define ZOBRIST_SCORE_SALT 0x94d049bb133111ebull
+
+/** Scrambles a 64-bit value (the splitmix64 finalizer). Keys are derived
+ * with this on the fly rather than stored, so boards of any size cost no
+ * table memory.
+ */
+static inline uint64_t zobrist_mix(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+/** Returns the key for row-major cell `index` holding `flags`. Empty cells
+ * have key 0.
+ */
+static inline uint64_t zobrist_cell_key(size_t index, int flags) {
+    if (flags == 0) {
+        return 0;
+    }
+    // mixing the index on its own first keeps all 64 bits of it
+    return zobrist_mix(zobrist_mix((uint64_t)index ^ ZOBRIST_CELL_SALT) ^
+                       (uint64_t)flags);
+}
+
+/** Updates the hash for row-major cell `index` changing from `old` to
+ * `value`.
+ */
+static inline void zobrist_set_index(zobrist_t* zobrist, size_t index,
+                                     int old, int value) {
+    zobrist->hash ^= zobrist_cell_key(index, old) ^
+                     zobrist_cell_key(index, value);
+}
+
+/** Updates the hash for cells[pos] changing from `old` to `value`.
+ */
+static inline void zobrist_set_cell(zobrist_t* zobrist, size_t pos, int old,
+                                    int value) {
+    zobrist_set_index(zobrist,
+                      cell_row(pos, zobrist->width) * zobrist->width +
+                          cell_col(pos, zobrist->width),
+                      old, value);
+}
+
+/** Updates the hash for the snake's head (row-major index `head`),
+ * direction and score at the end of a tick.
+ */
+static inline void zobrist_end_tick_index(zobrist_t* zobrist, size_t head,
+                                          int dir, int score) {
+    if (head != zobrist->head) {
+        zobrist->hash ^= zobrist_mix(zobrist->head ^ ZOBRIST_HEAD_SALT) ^
+                         zobrist_mix(head ^ ZOBRIST_HEAD_SALT);
+        zobrist->head = head;
+    }
+    if (dir != zobrist->dir) {
+        zobrist->hash ^=
+            zobrist_mix((uint64_t)zobrist->dir ^ ZOBRIST_DIR_SALT) ^
+            zobrist_mix((uint64_t)dir ^ ZOBRIST_DIR_SALT);
+        zobrist->dir = dir;
+    }
+    if (score != zobrist->score) {
+        zobrist->hash ^=
+            zobrist_mix((uint64_t)zobrist->score ^ ZOBRIST_SCORE_SALT) ^
+            zobrist_mix((uint64_t)score ^ ZOBRIST_SCORE_SALT);
+        zobrist->score = score;
+    }
+}
+
+/** Updates the hash for the snake's head (cell position `head_pos`),
+ * direction and score at the end of a tick.
+ */
+static inline void zobrist_end_tick(zobrist_t* zobrist, size_t head_pos,
+                                    int dir, int score) {
+    zobrist_end_tick_index(zobrist,
+                           cell_row(head_pos, zobrist->width) *
+                                   zobrist->width +
+                               cell_col(head_pos, zobrist->width),
+                           dir, score);
+}
+
+#endif
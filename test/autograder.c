@@ -7,10 +7,12 @@
 #include <unistd.h>
 #include <wchar.h>
 
+#include "../src/arena.h"
 #include "../src/common.h"
 #include "../src/game.h"
 #include "../src/game_setup.h"
 #include "../src/mbstrings.h"
+#include "../src/zobrist.h"
 
 // Verbosity of test runner. Overridden via compilation flag
 #ifdef VERBOSE
@@ -41,7 +43,7 @@ void print_game(int* cells, size_t height, size_t width) {
     setlocale(LC_CTYPE, "");
     for (size_t i = 0; i < height; i++) {
         for (size_t j = 0; j < width; j++) {
-            char cell = cells[i * width + j];
+            char cell = cells[cell_index(i, j, width)];
             if ((cell & FLAG_GRASS) && (cell & FLAG_SNAKE)) {
                 printf("s");
             } else if ((cell & FLAG_GRASS) && (cell & FLAG_FOOD)) {
@@ -65,6 +67,10 @@ void print_game(int* cells, size_t height, size_t width) {
     printf("\n");
 }
 
+// Zobrist hash of the game, kept up to date in hash-only mode (HASH_ONLY=1),
+// where the result is reported as one word instead of the cells string
+static zobrist_t hash;
+
 // returns 0 if success, or a board decompress error code if failure
 int run_test(int** cells_p, size_t* width_p, size_t* height_p, snake_t* snake_p, 
                 char* board_rep, unsigned int snake_grows, char* input_string) {
@@ -75,27 +81,47 @@ int run_test(int** cells_p, size_t* width_p, size_t* height_p, snake_t* snake_p,
         return status;
     }
 
-    int i = 0;
-    while (1) {
-        if (VERBOSE) {
+    if (getenv("HASH_ONLY")) {
+        zobrist_init(&hash, *cells_p, *width_p, *height_p, snake_p, g_score);
+        g_zobrist = &hash;
+    }
+
+    if (VERBOSE) {
+        // step one input at a time so every intermediate board is printed
+        int i = 0;
+        while (1) {
             printf("Board at time step %d:\n", i);
             print_game(*cells_p, *height_p, *width_p);
-        }
-        // if we reach the end of the input, the trace is over
-        if (*input_string == '\0') {
-            break;
-        }
+            // if we reach the end of the input, the trace is over
+            if (*input_string == '\0') {
+                break;
+            }
 
-        // Get user input
-        enum input_key input = get_input(*input_string);
-        input_string += 1;
+            // Get user input
+            enum input_key input = get_input(*input_string);
+            input_string += 1;
 
-        // Update game state
-        update(*cells_p, *width_p, *height_p, snake_p, input, snake_grows);
+            // Update game state
+            update(*cells_p, *width_p, *height_p, snake_p, input, snake_grows);
 
-        i += 1;
+            i += 1;
+        }
+        return 0;
     }
 
+    // decode the whole trace up front, then run it in one batch
+    size_t num_inputs = strlen(input_string);
+    enum input_key* inputs = malloc(num_inputs * sizeof(enum input_key) + 1);
+    unsigned char* packed = malloc((num_inputs + 3) / 4 + 1);
+    for (size_t i = 0; i < num_inputs; i++) {
+        inputs[i] = get_input(input_string[i]);
+    }
+    pack_inputs(inputs, num_inputs, snake_p->snake_dir, packed);
+    update_batch(*cells_p, *width_p, *height_p, snake_p, packed, num_inputs,
+                 snake_grows);
+    free(inputs);
+    free(packed);
+
     return 0;
 }
 
@@ -153,7 +179,30 @@ int main(int argc, char **argv) {
         exit(EXIT_SUCCESS);
     }
 
-    char *cell_string = (char *)malloc(
+    if (g_zobrist != NULL) {
+        // the incremental hash must match one computed from scratch
+        if (hash.hash !=
+            zobrist_compute(cells, width, height, &snake, g_score)) {
+            fprintf(stderr, "Incremental hash does not match the board\n");
+            exit(EXIT_FAILURE);
+        }
+        fprintf(pipe,
+                "{\n"
+                "    \"game_over\": %d,\n"
+                "    \"score\": %d,\n"
+                "    \"width\": %lu,\n"
+                "    \"height\": %lu,\n"
+                "    \"hash\": \"%016llx\"\n"
+                "}\n",
+                g_game_over, g_score, width, height,
+                (unsigned long long)hash.hash);
+        g_zobrist = NULL;
+        teardown(cells, &snake);
+        fclose(pipe);
+        exit(EXIT_SUCCESS);
+    }
+
+    char *cell_string = (char *)game_alloc(
         width * height + 1);
     if (cell_string == NULL) {
         fprintf(stderr, "Failed to allocate memory for cell string\n");
@@ -162,7 +211,7 @@ int main(int argc, char **argv) {
     }
     for (size_t i = 0; i < height; i++) {
         for (size_t j = 0; j < width; j++) {
-            char cell = cells[i * width + j];
+            char cell = cells[cell_index(i, j, width)];
             char cell_as_char;
             if ((cell & FLAG_GRASS) && (cell & FLAG_SNAKE)) {
                 cell_as_char = 's';
@@ -234,8 +283,9 @@ int main(int argc, char **argv) {
                 cell_string);
     }
 
+    // the cell string may share the game's arena, so free it first
+    game_free(cell_string);
     teardown(cells, &snake);
-    free(cell_string);
     fclose(pipe);
     exit(EXIT_SUCCESS);
 }
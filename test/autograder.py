@@ -114,7 +114,11 @@ def run_test(test_name, test_parameters):
     if not ensure_keys_exist(
         test_parameters["output"], ["game_over",
                                     "score", "width", "height", "cells"]
-    ) and not ensure_keys_exist(test_parameters["output"], ["board_error"]):
+    ) and not ensure_keys_exist(test_parameters["output"], ["board_error"]) \
+      and not ensure_keys_exist(
+        test_parameters["output"], ["game_over",
+                                    "score", "width", "height", "hash"]
+    ):
         eprint("missing test output parameters")
         sys.exit(1)
 
@@ -144,6 +148,13 @@ def run_test(test_name, test_parameters):
     os.set_inheritable(r, True)
     os.set_inheritable(w, True)
 
+    # Tests that expect a hash run in hash-only mode, where the autograder
+    # reports a Zobrist hash of the final state instead of every cell
+    hash_only = "hash" in test_parameters["output"]
+    env = dict(os.environ)
+    if hash_only:
+        env["HASH_ONLY"] = "1"
+
     # Run the autograder via a subprocess
     print("Running test", test_name),
     results = subprocess.run(
@@ -159,6 +170,7 @@ def run_test(test_name, test_parameters):
             str(w),
         ],
         close_fds=False,
+        env=env,
         input=(
             test_parameters.get("name", "") + "\n"
         ).encode(),
@@ -200,16 +212,23 @@ def run_test(test_name, test_parameters):
                 print_mismatch(key, actual, expected)
                 failure = True
 
-        # We special case checking for mismatches in the boards so that we can pretty print
-        failure = (
-            print_board_mismatch(
-                actual_output["cells"],
-                expected_output["cells"],
-                expected_output["width"],
-                expected_output["height"],
+        if hash_only:
+            # one word stands in for the whole board
+            if actual_output["hash"] != expected_output["hash"]:
+                print_mismatch("hash", actual_output["hash"],
+                               expected_output["hash"])
+                failure = True
+        else:
+            # We special case checking for mismatches in the boards so that we can pretty print
+            failure = (
+                print_board_mismatch(
+                    actual_output["cells"],
+                    expected_output["cells"],
+                    expected_output["width"],
+                    expected_output["height"],
+                )
+                or failure
             )
-            or failure
-        )
 
         # If name was specified, test name
         if "name" in test_parameters:
@@ -0,0 +1,1265 @@
+#include <curses.h>
+#include <math.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#include "../src/arena.h"
+#include "../src/batch_env.h"
+#include "../src/board_gen.h"
+#include "../src/common.h"
+#include "../src/food_index.h"
+#include "../src/game.h"
+#include "../src/game_sched.h"
+#include "../src/game_setup.h"
+#include "../src/hiscore.h"
+#include "../src/multi_snake.h"
+#include "../src/parallel_decode.h"
+#include "../src/raster.h"
+#include "../src/render.h"
+#include "../src/snake_body.h"
+
+// Benchmarks for the game engine. Build with `make bench ASAN=0` (address
+// sanitizer distorts timings). Run `./bench` for every benchmark or
+// `./bench <name>` for one of them.
+
+#if defined(CELL_LAYOUT_BLOCKED)
+#define LAYOUT_NAME "blocked"
+#elif defined(CELL_LAYOUT_PADDED)
+#define LAYOUT_NAME "padded"
+#else
+#define LAYOUT_NAME "rowmajor"
+#endif
+
+/* Opens a hardware counter (a PERF_COUNT_HW_* event) for this process, or
+   returns -1 if the platform or kernel does not allow it.
+*/
+static int open_counter(unsigned long long event) {
+#ifdef __linux__
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.size = sizeof(attr);
+    attr.config = event;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    return syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+    (void)event;
+    return -1;
+#endif
+}
+
+#define NUM_COUNTERS 2
+static const char* counter_names[NUM_COUNTERS] = {"cache-misses",
+                                                  "branch-misses"};
+
+/* A running measurement: wall clock plus hardware counters if available.
+ */
+typedef struct measure {
+    struct timespec start;
+    int counter_fds[NUM_COUNTERS];
+} measure_t;
+
+static void measure_start(measure_t* m) {
+#ifdef __linux__
+    m->counter_fds[0] = open_counter(PERF_COUNT_HW_CACHE_MISSES);
+    m->counter_fds[1] = open_counter(PERF_COUNT_HW_BRANCH_MISSES);
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        if (m->counter_fds[i] >= 0) {
+            ioctl(m->counter_fds[i], PERF_EVENT_IOC_RESET, 0);
+            ioctl(m->counter_fds[i], PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+#else
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        m->counter_fds[i] = -1;
+    }
+#endif
+    clock_gettime(CLOCK_MONOTONIC, &m->start);
+}
+
+/* Stops the measurement and prints one result line for `ops` operations.
+   Returns the time per operation in nanoseconds.
+*/
+static double measure_stop(measure_t* m, const char* name, const char* unit,
+                           size_t ops) {
+    struct timespec end;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double ns = (end.tv_sec - m->start.tv_sec) * 1e9 +
+                (end.tv_nsec - m->start.tv_nsec);
+
+    printf("%-28s %-8s %10.2f ns/%s", name, LAYOUT_NAME, ns / ops, unit);
+    for (int i = 0; i < NUM_COUNTERS; i++) {
+        long long count = -1;
+#ifdef __linux__
+        if (m->counter_fds[i] >= 0) {
+            ioctl(m->counter_fds[i], PERF_EVENT_IOC_DISABLE, 0);
+            if (read(m->counter_fds[i], &count, sizeof(count)) !=
+                sizeof(count)) {
+                count = -1;
+            }
+            close(m->counter_fds[i]);
+        }
+#endif
+        if (count >= 0) {
+            printf(" %10.3f %s/%s", (double)count / ops, counter_names[i],
+                   unit);
+        } else {
+            printf("        n/a %s/%s", counter_names[i], unit);
+        }
+    }
+    printf("\n");
+    return ns / ops;
+}
+
+/* Builds a compressed board string of the given size: walls around the
+   edge, plain cells inside, and the snake in the top left corner. The caller
+   frees the result.
+*/
+static char* make_board_str(size_t width, size_t height) {
+    size_t cap = 64 + height * 48;
+    char* board = malloc(cap);
+    size_t len = snprintf(board, cap, "B%zux%zu|W%zu", height, width, width);
+    for (size_t row = 1; row + 1 < height; row++) {
+        if (row == 1) {
+            len += snprintf(board + len, cap - len, "|W1S1E%zuW1", width - 3);
+        } else {
+            len += snprintf(board + len, cap - len, "|W1E%zuW1", width - 2);
+        }
+    }
+    snprintf(board + len, cap - len, "|W%zu", width);
+    return board;
+}
+
+/* Sets up a game on an empty walled board of the given size.
+ */
+static void setup_game(int** cells_p, size_t width, size_t height,
+                       snake_t* snake_p) {
+    char* board = make_board_str(width, height);
+    size_t w;
+    size_t h;
+    if (initialize_game(cells_p, &w, &h, snake_p, board) != INIT_SUCCESS) {
+        fprintf(stderr, "could not initialize %zux%zu board\n", width, height);
+        exit(EXIT_FAILURE);
+    }
+    free(board);
+}
+
+/* Steps the snake in a vertical serpentine (down a column, one step right,
+   up the next column, ...) so nearly every tick is an UP or DOWN move.
+*/
+static void bench_vertical_ticks(size_t width, size_t height) {
+    int* cells;
+    snake_t snake;
+    setup_game(&cells, width, height, &snake);
+
+    size_t ticks = 0;
+    measure_t m;
+    measure_start(&m);
+    for (size_t col = 1; col + 1 < width; col++) {
+        enum input_key vertical = (col % 2) ? INPUT_DOWN : INPUT_UP;
+        for (size_t step = 0; step + 3 < height; step++) {
+            update(cells, width, height, &snake, vertical, 0);
+            ticks++;
+        }
+        if (col + 2 < width) {
+            update(cells, width, height, &snake, INPUT_RIGHT, 0);
+            ticks++;
+        }
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "tick-vertical %zux%zu", width, height);
+    measure_stop(&m, name, "tick", ticks);
+    if (g_game_over) {
+        fprintf(stderr, "warning: snake died during %s\n", name);
+    }
+    teardown(cells, &snake);
+}
+
+/* Counts non-plain cells in every 3x3 neighbourhood, the access pattern of
+   bots and renderers looking around a cell.
+*/
+static void bench_neighbourhood_scan(size_t width, size_t height) {
+    int* cells;
+    snake_t snake;
+    setup_game(&cells, width, height, &snake);
+
+    size_t total = 0;
+    measure_t m;
+    measure_start(&m);
+    for (size_t col = 1; col + 1 < width; col++) {
+        for (size_t row = 1; row + 1 < height; row++) {
+            for (size_t dr = 0; dr < 3; dr++) {
+                for (size_t dc = 0; dc < 3; dc++) {
+                    total += cells[cell_index(row + dr - 1, col + dc - 1,
+                                              width)] != PLAIN_CELL;
+                }
+            }
+        }
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "scan-3x3 %zux%zu", width, height);
+    measure_stop(&m, name, "cell", (width - 2) * (height - 2));
+    if (total == 0) {
+        fprintf(stderr, "warning: scan found no cells\n");
+    }
+    teardown(cells, &snake);
+}
+
+/* Runs the layout benchmarks on square and wide boards.
+ */
+static void bench_layout(void) {
+    bench_vertical_ticks(256, 256);
+    bench_vertical_ticks(8192, 512);
+    bench_vertical_ticks(32768, 128);
+    bench_neighbourhood_scan(256, 256);
+    bench_neighbourhood_scan(8192, 512);
+    bench_neighbourhood_scan(32768, 128);
+}
+
+/* Builds the inputs of a vertical serpentine over the whole board, as in
+   bench_vertical_ticks(). Returns the number of inputs; the caller frees
+   *inputs_p.
+*/
+static size_t serpentine_inputs(size_t width, size_t height,
+                                enum input_key** inputs_p) {
+    enum input_key* inputs = malloc(width * height * sizeof(enum input_key));
+    size_t n = 0;
+    for (size_t col = 1; col + 1 < width; col++) {
+        enum input_key vertical = (col % 2) ? INPUT_DOWN : INPUT_UP;
+        for (size_t step = 0; step + 3 < height; step++) {
+            inputs[n++] = step == 0 ? vertical : INPUT_NONE;
+        }
+        if (col + 2 < width) {
+            inputs[n++] = INPUT_RIGHT;
+        }
+    }
+    *inputs_p = inputs;
+    return n;
+}
+
+/* Replays the same trace with one update() call per input and with a single
+   update_batch() call.
+*/
+static void bench_trace(void) {
+    size_t width = 512;
+    size_t height = 512;
+    enum input_key* inputs;
+    size_t n = serpentine_inputs(width, height, &inputs);
+
+    int* cells;
+    snake_t snake;
+    set_seed(0);
+    setup_game(&cells, width, height, &snake);
+    measure_t m;
+    measure_start(&m);
+    for (size_t i = 0; i < n && !g_game_over; i++) {
+        update(cells, width, height, &snake, inputs[i], 0);
+    }
+    measure_stop(&m, "trace-update 512x512", "tick", n);
+    teardown(cells, &snake);
+
+    set_seed(0);
+    setup_game(&cells, width, height, &snake);
+    unsigned char* packed = malloc((n + 3) / 4);
+    measure_start(&m);
+    pack_inputs(inputs, n, snake.snake_dir, packed);
+    update_batch(cells, width, height, &snake, packed, n, 0);
+    measure_stop(&m, "trace-batch 512x512", "tick", n);
+    teardown(cells, &snake);
+
+    free(packed);
+    free(inputs);
+}
+
+/* Replays a serpentine trace on a board of the given width through update()
+   and through the kernel chosen by select_update().
+*/
+static void bench_kernel_width(size_t width, size_t height, int growing) {
+    enum input_key* inputs;
+    size_t n = serpentine_inputs(width, height, &inputs);
+    char name[64];
+
+    for (int specialized = 0; specialized < 2; specialized++) {
+        int* cells;
+        snake_t snake;
+        set_seed(0);
+        setup_game(&cells, width, height, &snake);
+        update_fn step = specialized
+                             ? select_update(cells, width, height, growing)
+                             : update;
+        measure_t m;
+        measure_start(&m);
+        for (size_t i = 0; i < n && !g_game_over; i++) {
+            step(cells, width, height, &snake, inputs[i], growing);
+        }
+        snprintf(name, sizeof(name), "%s w%zu g%d",
+                 specialized ? "kernel" : "update", width, growing);
+        measure_stop(&m, name, "tick", n);
+        teardown(cells, &snake);
+    }
+    free(inputs);
+}
+
+/* Compares update() with the specialized kernels on fixed-width boards.
+ */
+static void bench_kernels(void) {
+    bench_kernel_width(20, 1024, 0);
+    bench_kernel_width(64, 1024, 0);
+    bench_kernel_width(64, 1024, 1);
+    bench_kernel_width(100, 1024, 0);
+}
+
+#define BATCH_STEPS 2000
+#define BATCH_ACTION_ROWS 16
+
+/* Steps batches of default-board games with random actions, as a training
+   loop would. Games that die are reset inside batch_env_step(), so the
+   steps include the resets. The actions are drawn up front, so the time is
+   the environment's alone.
+*/
+static void bench_batch(void) {
+    static const size_t sizes[] = {64, 1024, 16384};
+    char name[64];
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        size_t num_games = sizes[s];
+        batch_env_t env;
+        set_seed(0);
+        batch_env_init(&env, num_games, NULL, 1);
+        enum input_key* actions =
+            malloc(BATCH_ACTION_ROWS * num_games * sizeof(enum input_key));
+        for (size_t i = 0; i < BATCH_ACTION_ROWS * num_games; i++) {
+            // mostly keep going, as a trained agent would
+            unsigned roll = generate_index(12);
+            actions[i] = roll < 4 ? (enum input_key)roll : INPUT_NONE;
+        }
+        int* rewards = malloc(num_games * sizeof(int));
+        size_t resets = 0;
+        long eaten = 0;
+
+        measure_t m;
+        measure_start(&m);
+        for (size_t step = 0; step < BATCH_STEPS; step++) {
+            batch_env_step(&env,
+                           actions + step % BATCH_ACTION_ROWS * num_games,
+                           rewards);
+            for (size_t i = 0; i < num_games; i++) {
+                resets += env.done[i];
+                eaten += rewards[i];
+            }
+        }
+        snprintf(name, sizeof(name), "batch-%zu-games", num_games);
+        double ns = measure_stop(&m, name, "step", num_games * BATCH_STEPS);
+        printf("%-28s %.1fM env-steps/s (%zu resets, %ld food eaten)\n", "",
+               1e3 / ns, resets, eaten);
+        free(rewards);
+        free(actions);
+        batch_env_teardown(&env);
+    }
+}
+
+/* Plays one short game on the default board: along the top, down the side
+   and back along the bottom.
+*/
+static void play_short_game(void) {
+    int* cells;
+    size_t width;
+    size_t height;
+    snake_t snake;
+    initialize_game(&cells, &width, &height, &snake, NULL);
+    for (int i = 0; i < 14; i++) {
+        update(cells, width, height, &snake, INPUT_RIGHT, 1);
+    }
+    for (int i = 0; i < 4; i++) {
+        update(cells, width, height, &snake, INPUT_DOWN, 1);
+    }
+    for (int i = 0; i < 14; i++) {
+        update(cells, width, height, &snake, INPUT_LEFT, 1);
+    }
+    teardown(cells, &snake);
+}
+
+/* Plays many back-to-back games with malloc and with a reused arena.
+ */
+static void bench_arena(void) {
+    size_t games = 100000;
+    measure_t m;
+    measure_start(&m);
+    for (size_t i = 0; i < games; i++) {
+        play_short_game();
+    }
+    measure_stop(&m, "games-malloc", "game", games);
+
+    arena_t arena;
+    arena_init(&arena, 4096);
+    g_arena = &arena;
+    play_short_game();
+    size_t warm_chunks = arena.num_chunk_mallocs;
+    measure_start(&m);
+    for (size_t i = 0; i < games; i++) {
+        play_short_game();
+    }
+    measure_stop(&m, "games-arena", "game", games);
+    printf("arena chunk mallocs after the first game: %zu\n",
+           arena.num_chunk_mallocs - warm_chunks);
+    g_arena = NULL;
+    arena_destroy(&arena);
+}
+
+/* Manhattan distance between two cell positions.
+ */
+static size_t manhattan(size_t a, size_t b, size_t width) {
+    size_t row_a = cell_row(a, width);
+    size_t row_b = cell_row(b, width);
+    size_t col_a = cell_col(a, width);
+    size_t col_b = cell_col(b, width);
+    return (row_a > row_b ? row_a - row_b : row_b - row_a) +
+           (col_a > col_b ? col_a - col_b : col_b - col_a);
+}
+
+/* Finds the nearest food by scanning every cell, for comparison.
+ */
+static size_t nearest_food_scan(int* cells, size_t width, size_t height,
+                                size_t pos) {
+    size_t best = (size_t)-1;
+    size_t best_pos = 0;
+    for (size_t r = 0; r < height; r++) {
+        for (size_t c = 0; c < width; c++) {
+            size_t other = cell_index(r, c, width);
+            if ((cells[other] & FLAG_FOOD) &&
+                manhattan(pos, other, width) < best) {
+                best = manhattan(pos, other, width);
+                best_pos = other;
+            }
+        }
+    }
+    return best_pos;
+}
+
+/* Nearest-food queries on a big board with many food items, through the
+   food index and by scanning the board.
+*/
+static void bench_food(void) {
+    size_t width = 1024;
+    size_t height = 1024;
+    food_index_t index;
+    g_food_index = &index;
+    g_food_count = 300;
+    int* cells;
+    snake_t snake;
+    setup_game(&cells, width, height, &snake);
+
+    size_t queries = 2000;
+    size_t* targets = malloc(queries * sizeof(size_t));
+    size_t* found = malloc(queries * sizeof(size_t));
+    for (size_t i = 0; i < queries; i++) {
+        targets[i] = cell_index(1 + generate_index(height - 2),
+                                1 + generate_index(width - 2), width);
+    }
+
+    measure_t m;
+    measure_start(&m);
+    for (size_t i = 0; i < queries; i++) {
+        food_index_nearest(&index, targets[i], &found[i]);
+    }
+    measure_stop(&m, "nearest-food-index 1024^2", "query", queries);
+
+    size_t mismatches = 0;
+    measure_start(&m);
+    for (size_t i = 0; i < queries / 20; i++) {
+        size_t pos = nearest_food_scan(cells, width, height, targets[i]);
+        // ties may pick different cells, so compare distances
+        size_t d_scan = manhattan(pos, targets[i], width);
+        size_t d_index = manhattan(found[i], targets[i], width);
+        mismatches += d_scan != d_index;
+    }
+    measure_stop(&m, "nearest-food-scan 1024^2", "query", queries / 20);
+    if (mismatches) {
+        fprintf(stderr, "warning: %zu nearest-food mismatches\n", mismatches);
+    }
+
+    free(targets);
+    free(found);
+    teardown(cells, &snake);
+    g_food_index = NULL;
+    g_food_count = 1;
+}
+
+typedef struct benchmark {
+    const char* name;
+    void (*run)(void);
+} benchmark_t;
+
+// Snake-style list traffic on a list of `len` ints: read the tail, push a
+// new head and drop the tail, then look up an element by index.
+static void bench_list_len(size_t len) {
+    size_t ops = 20000;
+    char name[64];
+    measure_t m;
+
+    node_t* list = NULL;
+    for (size_t i = 0; i < len; i++) {
+        int value = (int)i;
+        insert_first(&list, &value, sizeof(int));
+    }
+    int sum = 0;
+    measure_start(&m);
+    for (size_t i = 0; i < ops; i++) {
+        int value = *(int*)get_last(list) + 1;
+        remove_last(&list);
+        insert_first(&list, &value, sizeof(int));
+        sum += *(int*)get(list, (int)(i % len));
+    }
+    snprintf(name, sizeof(name), "list-%zu", len);
+    measure_stop(&m, name, "op", ops);
+    while (list != NULL) {
+        remove_last(&list);
+    }
+
+    ulist_t ulist;
+    ulist_init(&ulist);
+    for (size_t i = 0; i < len; i++) {
+        int value = (int)i;
+        ulist_insert_first(&ulist, &value, sizeof(int));
+    }
+    measure_start(&m);
+    for (size_t i = 0; i < ops; i++) {
+        int value = *(int*)ulist_get_last(&ulist) + 1;
+        ulist_remove_last(&ulist);
+        ulist_insert_first(&ulist, &value, sizeof(int));
+        sum += *(int*)ulist_get(&ulist, (int)(i % len));
+    }
+    snprintf(name, sizeof(name), "ulist-%zu", len);
+    measure_stop(&m, name, "op", ops);
+
+    // membership and removal by value, then the same with a hash index
+    for (int indexed = 0; indexed < 2; indexed++) {
+        if (indexed) {
+            ulist_enable_index(&ulist);
+        }
+        measure_start(&m);
+        for (size_t i = 0; i < ops; i++) {
+            int value = *(int*)ulist_get_last(&ulist) + (int)(i % len);
+            sum += ulist_contains(&ulist, &value, sizeof(int));
+            int last = *(int*)ulist_get_last(&ulist);
+            ulist_remove_element(&ulist, &last, sizeof(int));
+            ulist_insert_first(&ulist, &last, sizeof(int));
+        }
+        snprintf(name, sizeof(name), "ulist-%s-%zu",
+                 indexed ? "indexed" : "scan", len);
+        measure_stop(&m, name, "op", ops);
+    }
+    ulist_clear(&ulist);
+    printf("(checksum %d)\n", sum);
+}
+
+static void bench_list(void) {
+    bench_list_len(64);
+    bench_list_len(1024);
+    bench_list_len(16384);
+}
+
+/* Grows a packed snake body to `len` segments by walking a serpentine
+   path, then moves it along (push a head, pop the tail). Positions are
+   row-major on a board `width` wide.
+*/
+static void bench_body_len(size_t len, size_t width) {
+    static const int step[4] = {0, 0, -1, 1};  // UP and DOWN unused
+    char name[64];
+    measure_t m;
+    snake_body_t body;
+    snake_body_init(&body);
+    snake_body_push_head(&body, RIGHT, 0);
+
+    // left to right, down one row at each edge
+    size_t col = 0;
+    enum direction dir = RIGHT;
+    size_t ops = 0;
+    measure_start(&m);
+    while (ops < 2 * len) {
+        size_t head = body.head;
+        enum direction next = dir;
+        if ((dir == RIGHT && col == width - 1) || (dir == LEFT && col == 0)) {
+            next = DOWN;
+        }
+        size_t new_head =
+            next == DOWN ? head + width : (size_t)((long)head + step[next]);
+        snake_body_push_head(&body, next, new_head);
+        if (next == DOWN) {
+            dir = dir == RIGHT ? LEFT : RIGHT;
+        } else {
+            col += next == RIGHT ? 1 : -1;
+        }
+        if (++ops > len) {
+            size_t tail = body.tail;
+            unsigned tail_dir = snake_body_tail_dir(&body);
+            size_t new_tail = tail_dir == DOWN
+                                  ? tail + width
+                                  : (size_t)((long)tail + step[tail_dir]);
+            snake_body_pop_tail(&body, new_tail);
+        }
+    }
+    snprintf(name, sizeof(name), "body-%zu", len);
+    measure_stop(&m, name, "op", ops);
+    printf("(%zu segments in %zu bytes, tail at %zu)\n", body.length,
+           body.cap / 4, body.tail);
+    snake_body_clear(&body);
+}
+
+static void bench_body(void) {
+    bench_body_len(1000, 64);
+    bench_body_len(10000000, 4096);
+}
+
+/* Plays `num_snakes` bots at once on a large board. The cost per snake
+   move should not depend on the number of snakes or the board size.
+*/
+static void bench_multi_snakes(size_t num_snakes, size_t width, size_t height) {
+    size_t ticks = 1000;
+    char name[64];
+    measure_t m;
+    char* board = make_board_str(width, height);
+    multi_game_t game;
+    multi_init(&game, board, num_snakes, 1);
+    free(board);
+    while (game.num_snakes < num_snakes && multi_spawn(&game) >= 0) {
+    }
+
+    enum input_key* inputs = malloc(num_snakes * sizeof(enum input_key));
+    size_t moves = 0;
+    measure_start(&m);
+    for (size_t t = 0; t < ticks && game.num_alive > 0; t++) {
+        for (size_t i = 0; i < game.num_snakes; i++) {
+            inputs[i] =
+                game.snakes[i].alive ? multi_bot_input(&game, i) : INPUT_NONE;
+        }
+        moves += game.num_alive;
+        multi_step(&game, inputs);
+    }
+    snprintf(name, sizeof(name), "multi-%zu-%zux%zu", num_snakes, width,
+             height);
+    measure_stop(&m, name, "move", moves);
+    printf("(%zu of %zu snakes alive)\n", game.num_alive, game.num_snakes);
+    free(inputs);
+    multi_teardown(&game);
+}
+
+static void bench_multi(void) {
+    bench_multi_snakes(16, 256, 256);
+    bench_multi_snakes(256, 256, 256);
+    bench_multi_snakes(256, 1024, 1024);
+    bench_multi_snakes(4096, 1024, 1024);
+}
+
+/* Position and outgoing direction of step `k` of a row-by-row serpentine
+   over the inside of a walled board: right along row 1, down, left along
+   row 2, and so on.
+*/
+static size_t serpentine_pos(size_t k, size_t width) {
+    size_t inner = width - 2;
+    size_t row = k / inner;
+    size_t j = k % inner;
+    return cell_index(1 + row, row % 2 == 0 ? 1 + j : inner - j, width);
+}
+
+static enum direction serpentine_dir(size_t k, size_t width) {
+    size_t inner = width - 2;
+    if (k % inner == inner - 1) {
+        return DOWN;
+    }
+    return (k / inner) % 2 == 0 ? RIGHT : LEFT;
+}
+
+/* Replaces the board's one-cell snake with one of `len` segments laid along
+   the serpentine, tail at (1, 1).
+*/
+static void lay_snake(int* cells, size_t width, snake_t* snake_p,
+                      size_t len) {
+    snake_body_clear(&snake_p->snake_pos);
+    for (size_t k = 0; k < len; k++) {
+        size_t pos = serpentine_pos(k, width);
+        cells[pos] |= FLAG_SNAKE;
+        snake_body_push_head(&snake_p->snake_pos,
+                             k ? serpentine_dir(k - 1, width) : RIGHT, pos);
+    }
+    snake_p->snake_dir = serpentine_dir(len - 1, width);
+}
+
+#define SCALING_SIZES 4
+#define SCALING_LENGTHS 3
+
+/* Prints how a cost per op grows from the smallest board to the largest,
+   as the exponent k in cost ~ cells^k.
+*/
+static void report_growth(const char* what, const double* costs,
+                          const size_t* sizes, size_t num_sizes) {
+    double cells_ratio = (double)sizes[num_sizes - 1] * sizes[num_sizes - 1] /
+                         ((double)sizes[0] * sizes[0]);
+    printf("scaling: %-24s grows as cells^%.2f from %zux%zu to %zux%zu\n",
+           what, log(costs[num_sizes - 1] / costs[0]) / log(cells_ratio),
+           sizes[0], sizes[0], sizes[num_sizes - 1], sizes[num_sizes - 1]);
+}
+
+/* Sweeps square generated boards through every stage of a game: generating
+   and decoding the board string, ticks and food placement with snakes
+   filling none, half and nine tenths of the board, and rendering (to a
+   headless screen, on boards small enough to hold one). Then reports how
+   each cost per cell or per op grows with the board.
+*/
+static void bench_scaling(void) {
+    static const size_t sizes[SCALING_SIZES] = {64, 256, 1024, 4096};
+    static const unsigned fill[SCALING_LENGTHS] = {0, 50, 90};
+    static const char* kind_names[] = {"random", "maze", "rooms"};
+    double gen_ns[3][SCALING_SIZES];
+    double init_ns[3][SCALING_SIZES];
+    double tick_ns[SCALING_LENGTHS][SCALING_SIZES];
+    double food_ns[SCALING_LENGTHS][SCALING_SIZES];
+    double render_ns[SCALING_SIZES];
+    size_t num_render = 0;
+    char name[64];
+    measure_t m;
+
+    for (size_t s = 0; s < SCALING_SIZES; s++) {
+        size_t size = sizes[s];
+        size_t num_cells = size * size;
+        board_gen_t gen = {GEN_RANDOM, size, size, 1, 20, 8, 2};
+
+        // decoding cost by kind of board
+        for (int kind = GEN_RANDOM; kind <= GEN_ROOMS; kind++) {
+            gen.kind = (enum board_gen_kind)kind;
+            measure_start(&m);
+            char* board = board_gen_string(&gen);
+            snprintf(name, sizeof(name), "gen-%s-%zu", kind_names[kind], size);
+            gen_ns[kind][s] = measure_stop(&m, name, "cell", num_cells);
+
+            int* cells;
+            size_t w;
+            size_t h;
+            snake_t snake;
+            measure_start(&m);
+            enum board_init_status status =
+                initialize_game(&cells, &w, &h, &snake, board);
+            snprintf(name, sizeof(name), "init-%s-%zu", kind_names[kind],
+                     size);
+            init_ns[kind][s] = measure_stop(&m, name, "cell", num_cells);
+            if (status != INIT_SUCCESS) {
+                fprintf(stderr, "generated board did not decode (%d)\n",
+                        status);
+                exit(EXIT_FAILURE);
+            }
+            teardown(cells, &snake);
+            free(board);
+        }
+
+        // ticks and food on an open board, by snake length
+        gen.kind = GEN_RANDOM;
+        gen.density = 0;
+        gen.grass = 0;
+        size_t inner = (size - 2) * (size - 2);
+        for (size_t l = 0; l < SCALING_LENGTHS; l++) {
+            char* board = board_gen_string(&gen);
+            int* cells;
+            size_t w;
+            size_t h;
+            snake_t snake;
+            set_seed(0);
+            initialize_game(&cells, &w, &h, &snake, board);
+            free(board);
+            size_t len = fill[l] ? inner * fill[l] / 100 : 1;
+            lay_snake(cells, size, &snake, len);
+            g_game_over = 0;
+
+            size_t num_food = (inner - len) / 4 < 2000 ? (inner - len) / 4
+                                                         : 2000;
+            measure_start(&m);
+            for (size_t i = 0; i < num_food; i++) {
+                place_food(cells, size, size);
+            }
+            snprintf(name, sizeof(name), "food-%zu-len%u%%", size, fill[l]);
+            food_ns[l][s] = measure_stop(&m, name, "food", num_food);
+            for (size_t i = 0; i < cell_count(size, size); i++) {
+                cells[i] &= ~FLAG_FOOD;
+            }
+
+            size_t ticks = inner - len < 200000 ? inner - len : 200000;
+            measure_start(&m);
+            for (size_t t = 0; t < ticks; t++) {
+                enum direction dir = serpentine_dir(len - 1 + t, size);
+                update(cells, size, size, &snake, (enum input_key)dir, 0);
+            }
+            snprintf(name, sizeof(name), "tick-%zu-len%u%%", size, fill[l]);
+            tick_ns[l][s] = measure_stop(&m, name, "tick", ticks);
+            if (g_game_over) {
+                fprintf(stderr, "snake died during the tick sweep\n");
+                exit(EXIT_FAILURE);
+            }
+
+            // render the half-full board; a screen of 4096x4096 is too big
+            if (l == 1 && size <= 1024) {
+                char lines[32];
+                char cols[32];
+                snprintf(lines, sizeof(lines), "%zu", size + 2);
+                snprintf(cols, sizeof(cols), "%zu", size);
+                setenv("LINES", lines, 1);
+                setenv("COLUMNS", cols, 1);
+                FILE* out = fopen("/dev/null", "w");
+                FILE* in = fopen("/dev/null", "r");
+                const char* term = getenv("TERM");
+                SCREEN* screen = newterm(term ? term : "xterm", out, in);
+                if (screen != NULL) {
+                    size_t frames = (1u << 22) / num_cells + 1;
+                    measure_start(&m);
+                    for (size_t f = 0; f < frames; f++) {
+                        render_game(cells, size, size);
+                    }
+                    snprintf(name, sizeof(name), "render-%zu", size);
+                    render_ns[s] =
+                        measure_stop(&m, name, "cell", frames * num_cells);
+                    num_render = s + 1;
+                    endwin();
+                    delscreen(screen);
+                }
+                fclose(out);
+                fclose(in);
+            }
+            teardown(cells, &snake);
+        }
+    }
+
+    for (int kind = GEN_RANDOM; kind <= GEN_ROOMS; kind++) {
+        snprintf(name, sizeof(name), "gen-%s/cell", kind_names[kind]);
+        report_growth(name, gen_ns[kind], sizes, SCALING_SIZES);
+        snprintf(name, sizeof(name), "init-%s/cell", kind_names[kind]);
+        report_growth(name, init_ns[kind], sizes, SCALING_SIZES);
+    }
+    for (size_t l = 0; l < SCALING_LENGTHS; l++) {
+        snprintf(name, sizeof(name), "tick len%u%%/tick", fill[l]);
+        report_growth(name, tick_ns[l], sizes, SCALING_SIZES);
+        snprintf(name, sizeof(name), "food len%u%%/food", fill[l]);
+        report_growth(name, food_ns[l], sizes, SCALING_SIZES);
+    }
+    if (num_render > 1) {
+        report_growth("render/cell", render_ns, sizes, num_render);
+    }
+}
+
+/* Decoding a large generated board: decompress_board_str() against the
+   parallel decoder at several thread counts. Threads past the number of
+   cores only add overhead.
+*/
+static void bench_decode(void) {
+    static const int threads[] = {1, 2, 4, 8};
+    board_gen_t gen = {GEN_RANDOM, 4096, 4096, 1, 20, 8, 2};
+    size_t num_cells = gen.width * gen.height;
+    char* board = board_gen_string(&gen);
+    size_t len = strlen(board) + 1;
+    char* copy = malloc(len);
+    char name[64];
+    measure_t m;
+
+    int* cells;
+    size_t w;
+    size_t h;
+    snake_t snake;
+    memcpy(copy, board, len);
+    snake_body_init(&snake.snake_pos);
+    measure_start(&m);
+    enum board_init_status status =
+        decompress_board_str(&cells, &w, &h, &snake, copy);
+    double serial_ns = measure_stop(&m, "decode-serial", "cell", num_cells);
+    game_free(cells);
+    if (status != INIT_SUCCESS) {
+        fprintf(stderr, "generated board did not decode (%d)\n", status);
+        exit(EXIT_FAILURE);
+    }
+
+    for (size_t i = 0; i < sizeof(threads) / sizeof(threads[0]); i++) {
+        measure_start(&m);
+        status = parallel_decompress_board_str(&cells, &w, &h, &snake, board,
+                                               threads[i]);
+        snprintf(name, sizeof(name), "decode-parallel-%d", threads[i]);
+        double ns = measure_stop(&m, name, "cell", num_cells);
+        game_free(cells);
+        if (status != INIT_SUCCESS) {
+            fprintf(stderr, "parallel decode failed (%d)\n", status);
+            exit(EXIT_FAILURE);
+        }
+        printf("%-28s %.2fx serial\n", "", serial_ns / ns);
+    }
+    printf("(%ld cores online)\n", sysconf(_SC_NPROCESSORS_ONLN));
+    free(copy);
+    free(board);
+}
+
+#define SCHED_GAMES 100000
+#define SCHED_SECONDS 10
+
+// One thread's share of the scheduler benchmark.
+typedef struct sched_worker {
+    size_t num_games;
+    pthread_barrier_t* barrier;
+    size_t ticks;
+    size_t finished;
+} sched_worker_t;
+
+/* Steers a default-board snake around a rectangle inside the grass, so the
+   games run for as long as the benchmark does.
+*/
+static void steer_in_loop(game_task_t* task, void* data) {
+    sched_worker_t* worker = data;
+    if (task->game_over) {
+        worker->finished++;
+        return;
+    }
+    size_t row = cell_row(task->snake.snake_pos.head, task->width);
+    size_t col = cell_col(task->snake.snake_pos.head, task->width);
+    enum direction dir = task->snake.snake_dir;
+    if (dir == RIGHT && col == task->width - 3) {
+        game_task_input(task, INPUT_DOWN);
+    } else if (dir == DOWN && row == task->height - 3) {
+        game_task_input(task, INPUT_LEFT);
+    } else if (dir == LEFT && col == 2) {
+        game_task_input(task, INPUT_UP);
+    } else if (dir == UP && row == 2) {
+        game_task_input(task, INPUT_RIGHT);
+    }
+}
+
+/* Spawns the worker's games, waits for the others, then runs SCHED_SECONDS
+   of simulated time a millisecond at a time.
+*/
+static void* run_sched_worker(void* arg) {
+    sched_worker_t* worker = arg;
+    game_sched_t* sched = malloc(sizeof(game_sched_t));
+    game_sched_init(sched, 0);
+    for (size_t i = 0; i < worker->num_games; i++) {
+        // human-speed games, ticking every 100 to 1000 ms
+        unsigned interval = 100 + (unsigned)(i * 7919 % 901);
+        game_sched_spawn(sched, NULL, 0, interval, steer_in_loop, worker,
+                         NULL);
+    }
+    pthread_barrier_wait(worker->barrier);
+    for (uint64_t now = 1; now <= SCHED_SECONDS * 1000; now++) {
+        worker->ticks += game_sched_advance(sched, now);
+    }
+    pthread_barrier_wait(worker->barrier);
+    game_sched_free(sched);
+    free(sched);
+    return NULL;
+}
+
+/* Resident memory of the process in bytes, or 0 if unknown. */
+static size_t resident_bytes(void) {
+    size_t pages = 0;
+    FILE* statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        if (fscanf(statm, "%*u %zu", &pages) != 1) {
+            pages = 0;
+        }
+        fclose(statm);
+    }
+    return pages * (size_t)sysconf(_SC_PAGESIZE);
+}
+
+/* SCHED_GAMES default-board games on game_sched_t schedulers, one per
+   core, with simulated time so the run doesn't take SCHED_SECONDS. Reports
+   the cost of a tick (including the scheduling) and the memory per game.
+*/
+static void bench_sched(void) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t num_threads = cores < 1 ? 1 : (size_t)cores;
+    sched_worker_t* workers = calloc(num_threads, sizeof(sched_worker_t));
+    pthread_t* threads = calloc(num_threads, sizeof(pthread_t));
+    pthread_barrier_t barrier;
+    pthread_barrier_init(&barrier, NULL, num_threads + 1);
+
+    size_t before = resident_bytes();
+    for (size_t i = 0; i < num_threads; i++) {
+        workers[i].num_games = SCHED_GAMES / num_threads +
+                               (i < SCHED_GAMES % num_threads);
+        workers[i].barrier = &barrier;
+        pthread_create(&threads[i], NULL, run_sched_worker, &workers[i]);
+    }
+    pthread_barrier_wait(&barrier);
+    size_t after = resident_bytes();
+    measure_t m;
+    measure_start(&m);
+    pthread_barrier_wait(&barrier);
+    size_t ticks = 0;
+    size_t finished = 0;
+    for (size_t i = 0; i < num_threads; i++) {
+        ticks += workers[i].ticks;
+        finished += workers[i].finished;
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "sched-%dk-games-%zut", SCHED_GAMES / 1000,
+             num_threads);
+    double ns = measure_stop(&m, name, "tick", ticks);
+    printf("(%zu ticks in %d simulated s, %.0f%% of one core per thread in "
+           "real time; %zu games ended; %.0f bytes/game)\n",
+           ticks, SCHED_SECONDS,
+           ns * ticks / (SCHED_SECONDS * 1e9) * 100 / num_threads, finished,
+           (double)(after - before) / SCHED_GAMES);
+
+    for (size_t i = 0; i < num_threads; i++) {
+        pthread_join(threads[i], NULL);
+    }
+    pthread_barrier_destroy(&barrier);
+    free(threads);
+    free(workers);
+}
+
+#define RASTER_FRAMES 200
+
+/* Draws RASTER_FRAMES frames of a 1000x1000 generated board into /dev/null
+   at several thread counts and tile sizes, with a few cells changing
+   between frames as in a game. The frames/s figure includes copying each
+   board into the raster.
+*/
+static void bench_raster(void) {
+    static const struct {
+        size_t tile;
+        enum raster_format format;
+        size_t threads;
+    } runs[] = {{1, RASTER_PPM, 1}, {1, RASTER_PPM, 2}, {1, RASTER_PPM, 4},
+                {1, RASTER_Y4M, 1}, {1, RASTER_Y4M, 4}, {4, RASTER_PPM, 4}};
+    board_gen_t gen = {GEN_ROOMS, 1000, 1000, 1, 20, 8, 2};
+    char* board = board_gen_string(&gen);
+    int* cells;
+    size_t w;
+    size_t h;
+    snake_t snake;
+    if (initialize_game(&cells, &w, &h, &snake, board) != INIT_SUCCESS) {
+        fprintf(stderr, "could not initialize the raster board\n");
+        exit(EXIT_FAILURE);
+    }
+    // the raster takes row-major boards, whatever the game's layout
+    int* frame = malloc(w * h * sizeof(int));
+    for (size_t row = 0; row < h; row++) {
+        for (size_t col = 0; col < w; col++) {
+            frame[row * w + col] = cells[cell_index(row, col, w)];
+        }
+    }
+    FILE* out = fopen("/dev/null", "wb");
+    char name[64];
+    measure_t m;
+
+    for (size_t i = 0; i < sizeof(runs) / sizeof(runs[0]); i++) {
+        raster_t r;
+        if (raster_open(&r, w, h, runs[i].tile, runs[i].format, 30,
+                        runs[i].threads, out) < 0) {
+            fprintf(stderr, "could not open the raster\n");
+            exit(EXIT_FAILURE);
+        }
+        measure_start(&m);
+        for (size_t f = 0; f < RASTER_FRAMES; f++) {
+            frame[(f * 7919) % (w * h)] ^= FLAG_SNAKE;
+            raster_add_frame(&r, frame);
+        }
+        raster_close(&r);
+        snprintf(name, sizeof(name), "raster-%s-tile%zu-%zut",
+                 runs[i].format == RASTER_PPM ? "ppm" : "y4m", runs[i].tile,
+                 runs[i].threads);
+        double ns = measure_stop(&m, name, "frame", RASTER_FRAMES);
+        printf("%-28s %.1f frames/s\n", "", 1e9 / ns);
+    }
+    printf("(%ld cores online)\n", sysconf(_SC_NPROCESSORS_ONLN));
+    fclose(out);
+    free(frame);
+    teardown(cells, &snake);
+    free(board);
+}
+
+#define HISCORE_WRITERS 4
+#define HISCORE_GAMES 20000  // per writer
+#define HISCORE_KEYS 1000    // boards played, well past any fixed table
+#define HISCORE_KILLS 50     // rounds of writers killed mid-append
+
+/* The board and score of writer `w`'s game `i`. */
+static uint64_t hiscore_game_key(size_t w, size_t i) {
+    return 1 + (w * HISCORE_GAMES + i) * 7919 % HISCORE_KEYS;
+}
+
+static int hiscore_game_score(size_t w, size_t i) {
+    return (int)((w * HISCORE_GAMES + i) * 2654435761u % 100000);
+}
+
+static int by_score_desc(const void* a, const void* b) {
+    return *(const int*)b - *(const int*)a;
+}
+
+/* Fails unless board `key` lists the best of the `n` scores. */
+static void check_top(hiscore_t* store, uint64_t key, int* scores, size_t n) {
+    qsort(scores, n, sizeof(int), by_score_desc);
+    hiscore_entry_t top[HISCORE_TOP_K];
+    size_t got = hiscore_top(store, key, top, HISCORE_TOP_K);
+    size_t want = n < HISCORE_TOP_K ? n : HISCORE_TOP_K;
+    for (size_t i = 0; i < want && got == want; i++) {
+        if (top[i].score != scores[i]) {
+            got = 0;
+        }
+    }
+    if (got != want) {
+        fprintf(stderr, "hiscore: wrong leaderboard for board %llu\n",
+                (unsigned long long)key);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Starts a process that appends writer `w`'s games (or, with `w` < 0,
+   games until it is killed) to the file at `path`. The games played until
+   killed each beat every earlier one, so each is also filed overall.
+*/
+static pid_t start_hiscore_writer(const char* path, long w) {
+    pid_t pid = fork();
+    if (pid != 0) {
+        return pid;
+    }
+    hiscore_t store;
+    if (hiscore_open(&store, path, 0) < 0) {
+        _exit(EXIT_FAILURE);
+    }
+    for (size_t i = 0; w < 0 || i < HISCORE_GAMES; i++) {
+        size_t game_w = w < 0 ? (size_t)getpid() : (size_t)w;
+        int score = w < 0 ? 100000 + (int)i : hiscore_game_score(game_w, i);
+        if (hiscore_add(&store, hiscore_game_key(game_w, i), "bench",
+                        score) < 0) {
+            break;
+        }
+    }
+    _exit(EXIT_SUCCESS);
+}
+
+/* Appends HISCORE_GAMES games from each of HISCORE_WRITERS processes at once
+   to a file that starts small and grows as they go, and checks every
+   leaderboard. Then, HISCORE_KILLS times, kills writers at a random point
+   mid-append or mid-growth, and checks that the leaderboards they were
+   changing are repaired.
+*/
+static void bench_hiscore(void) {
+    char path[] = "/tmp/snake-bench-hiscore-XXXXXX";
+    int fd = mkstemp(path);
+    hiscore_t store;
+    if (fd < 0 || hiscore_open(&store, path, HISCORE_CAPACITY) < 0) {
+        fprintf(stderr, "hiscore: can't create %s\n", path);
+        exit(EXIT_FAILURE);
+    }
+    close(fd);
+
+    pid_t writers[HISCORE_WRITERS];
+    measure_t m;
+    measure_start(&m);
+    for (long w = 0; w < HISCORE_WRITERS; w++) {
+        writers[w] = start_hiscore_writer(path, w);
+    }
+    for (size_t w = 0; w < HISCORE_WRITERS; w++) {
+        waitpid(writers[w], NULL, 0);
+    }
+    char name[64];
+    snprintf(name, sizeof(name), "hiscore-add-%dp", HISCORE_WRITERS);
+    measure_stop(&m, name, "add", HISCORE_WRITERS * HISCORE_GAMES);
+
+    size_t total = HISCORE_WRITERS * HISCORE_GAMES;
+    int* all = malloc(total * sizeof(int));
+    int* board = malloc(total * sizeof(int));
+    for (size_t w = 0; w < HISCORE_WRITERS; w++) {
+        for (size_t i = 0; i < HISCORE_GAMES; i++) {
+            all[w * HISCORE_GAMES + i] = hiscore_game_score(w, i);
+        }
+    }
+    for (uint64_t key = 1; key <= HISCORE_KEYS; key++) {
+        size_t n = 0;
+        for (size_t w = 0; w < HISCORE_WRITERS; w++) {
+            for (size_t i = 0; i < HISCORE_GAMES; i++) {
+                if (hiscore_game_key(w, i) == key) {
+                    board[n++] = hiscore_game_score(w, i);
+                }
+            }
+        }
+        check_top(&store, key, board, n);
+    }
+    check_top(&store, HISCORE_ALL, all, total);
+    if (hiscore_count(&store) != total || hiscore_check(&store) < 0) {
+        fprintf(stderr, "hiscore: lost games with concurrent writers\n");
+        exit(EXIT_FAILURE);
+    }
+    free(board);
+    free(all);
+
+    for (int round = 0; round < HISCORE_KILLS; round++) {
+        for (long w = 0; w < HISCORE_WRITERS; w++) {
+            writers[w] = start_hiscore_writer(path, -1);
+        }
+        usleep(1000 + generate_index(2000));
+        for (size_t w = 0; w < HISCORE_WRITERS; w++) {
+            kill(writers[w], SIGKILL);
+        }
+        // a dead writer's pid only reads as free once it has been reaped
+        for (size_t w = 0; w < HISCORE_WRITERS; w++) {
+            waitpid(writers[w], NULL, 0);
+        }
+        // growing the file rebuilds every leaderboard, which would hide
+        // a missed repair if only the final state were checked
+        if (round % 10 == 9 && hiscore_check(&store) < 0) {
+            fprintf(stderr,
+                    "hiscore: leaderboards not repaired after a crash\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+    size_t added = hiscore_count(&store) - total;
+    printf("%-28s %zu boards consistent; %d kill rounds, %zu more games\n",
+           "", (size_t)HISCORE_KEYS, HISCORE_KILLS, added);
+    hiscore_close(&store);
+    unlink(path);
+}
+
+static benchmark_t benchmarks[] = {
+    {"layout", bench_layout},
+    {"trace", bench_trace},
+    {"kernels", bench_kernels},
+    {"batch", bench_batch},
+    {"arena", bench_arena},
+    {"food", bench_food},
+    {"list", bench_list},
+    {"body", bench_body},
+    {"scaling", bench_scaling},
+    {"multi", bench_multi},
+    {"decode", bench_decode},
+    {"sched", bench_sched},
+    {"raster", bench_raster},
+    {"hiscore", bench_hiscore},
+};
+
+int main(int argc, char** argv) {
+    set_seed(0);
+    size_t num_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+    int ran = 0;
+    for (size_t i = 0; i < num_benchmarks; i++) {
+        if (argc < 2 || strcmp(argv[1], benchmarks[i].name) == 0) {
+            benchmarks[i].run();
+            ran = 1;
+        }
+    }
+    if (!ran) {
+        printf("usage: bench [");
+        for (size_t i = 0; i < num_benchmarks; i++) {
+            printf("%s%s", i ? "|" : "", benchmarks[i].name);
+        }
+        printf("]\n");
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
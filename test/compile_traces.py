@@ -0,0 +1,167 @@
+"""Compiles test/traces.json into a binary corpus for the trace runner.
+
+    $ python3 test/compile_traces.py test/traces.json test/traces.bin
+
+The corpus is read with mmap (see test/trace_corpus.h for the layout), so
+runners can jump straight to any test without parsing the rest. Inputs are
+packed 2 bits per step the way pack_inputs() packs them, and expected boards
+are run-length encoded, with `?` runs acting as the wildcard mask.
+"""
+
+import json
+import struct
+import sys
+
+MAGIC = b"SNKTRACE"
+VERSION = 1
+
+# record flags; keep in sync with test/trace_corpus.h
+FLAG_GROWS = 1
+FLAG_BOARD = 2
+FLAG_NAME = 4
+FLAG_HASH = 8
+FLAG_ERROR = 16
+
+# enum board_init_status
+BOARD_ERRORS = {"INCORRECT_DIMENSIONS": 1, "WRONG_SNAKE_NUM": 2, "BAD_CHAR": 3}
+
+# enum direction; every game starts out moving right
+DIRECTIONS = {"U": 0, "D": 1, "L": 2, "R": 3}
+START_DIR = 3
+
+HEADER = struct.Struct("<8sIIIIQ")
+RECORD = struct.Struct("<IIIIiiIIIIQIIIIII")
+
+
+def varint(n):
+    out = bytearray()
+    while n >= 0x80:
+        out.append((n & 0x7F) | 0x80)
+        n >>= 7
+    out.append(n)
+    return out
+
+
+def pack_inputs(keys):
+    """Packs key inputs 2 bits per step, as the direction moved in"""
+    packed = bytearray((len(keys) + 3) // 4)
+    direction = START_DIR
+    for i, key in enumerate(keys):
+        if key != "N":
+            if key not in DIRECTIONS:
+                raise ValueError(f"invalid input character {key!r}")
+            direction = DIRECTIONS[key]
+        packed[i >> 2] |= direction << ((i & 3) * 2)
+    return packed
+
+
+def encode_cells(cells):
+    """Run-length encodes a board's cell letters as (letter, varint) pairs"""
+    out = bytearray()
+    i = 0
+    while i < len(cells):
+        run = 1
+        while i + run < len(cells) and cells[i + run] == cells[i]:
+            run += 1
+        out.append(ord(cells[i]))
+        out += varint(run)
+        i += run
+    return out
+
+
+def align(buf, n=8):
+    buf += bytes(-len(buf) % n)
+
+
+def compile_trace(number, trace):
+    output = trace["output"]
+    flags = 0
+    if int(trace["snake_grows"]):
+        flags |= FLAG_GROWS
+    board = trace.get("board")
+    if board is not None:
+        flags |= FLAG_BOARD
+    name = trace.get("name")
+    if name is not None:
+        flags |= FLAG_NAME
+    if "hash" in output:
+        flags |= FLAG_HASH
+    if "board_error" in output:
+        flags |= FLAG_ERROR
+
+    width = output.get("width", 0)
+    height = output.get("height", 0)
+    cells = "".join(output.get("cells", []))
+    if cells and len(cells) != width * height:
+        raise ValueError(f"test{number:03d}: cells is not width * height")
+
+    keys = trace["key_input"]
+    board_bytes = (board or "").encode() + b"\0"
+    name_bytes = (name or "").encode() + b"\0"
+    expected_name = output.get("name", "").encode() + b"\0"
+    description = trace.get("description", "").encode() + b"\0"
+    expected = encode_cells(cells)
+
+    record = bytearray(
+        RECORD.pack(
+            number,
+            flags,
+            int(trace["seed"]),
+            len(keys),
+            output.get("game_over", 0),
+            output.get("score", 0),
+            width,
+            height,
+            BOARD_ERRORS.get(output.get("board_error"), 0),
+            output.get("name_len", 0),
+            int(output.get("hash", "0"), 16),
+            len(board_bytes),
+            len(name_bytes),
+            len(expected_name),
+            len(description),
+            len(expected),
+            0,
+        )
+    )
+    record += board_bytes
+    record += name_bytes
+    record += expected_name
+    record += description
+    record += pack_inputs(keys)
+    record += expected
+    align(record)
+    return record
+
+
+def main():
+    if len(sys.argv) != 3:
+        print("Usage: python3 compile_traces.py <traces.json> <corpus>")
+        sys.exit(1)
+    with open(sys.argv[1], "r") as trace_file:
+        traces = json.loads(trace_file.read())
+
+    # slot n of the index holds test n, so lookups are a single load
+    numbers = {}
+    for test_name in traces:
+        if not test_name.startswith("test"):
+            raise ValueError(f"unexpected test name {test_name!r}")
+        numbers[int(test_name[4:])] = test_name
+    num_slots = max(numbers, default=0) + 1
+
+    index_offset = HEADER.size
+    body = bytearray()
+    body_start = index_offset + 8 * num_slots
+    index = [0] * num_slots
+    for number in sorted(numbers):
+        index[number] = body_start + len(body)
+        body += compile_trace(number, traces[numbers[number]])
+
+    with open(sys.argv[2], "wb") as out:
+        out.write(
+            HEADER.pack(MAGIC, VERSION, num_slots, len(numbers), 0, index_offset)
+        )
+        out.write(struct.pack(f"<{num_slots}Q", *index))
+        out.write(body)
+
+
+main()
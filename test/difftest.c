@@ -0,0 +1,1296 @@
+// Differential tester: checks that every engine path behaves exactly like
+// the original engine on random games. The original, as it was before any
+// optimization, is frozen in test/reference.c.
+//
+// Each case is a random board string (sometimes deliberately broken), a
+// food seed, a growth setting and a random input sequence. Decoding is
+// compared between the reference, decompress_board_str(), the parallel and
+// tiled decoders and the board cache. Play is compared tick by tick, through
+// the Zobrist hash of the whole state, between the reference and update(),
+// the specialized kernels, single-step and whole-trace update_batch(), games
+// started from the board cache, tiled boards and a one-snake multi_game_t.
+// A one-game batch_env_t must match too, report the reward and done flag of
+// each step, and reset itself when the game ends, all without touching the
+// caller's Zobrist hash. Paths that keep the hash up to date as they play
+// are rehashed from scratch at the end of each case and where they diverge,
+// so a stale hash can't hide a wrong board. Each case is also played with
+// several food items, alone and with food-seeking bots, checking after every
+// tick that the food index matches the board.
+//
+// First, fixed two-snake games check the multi_step() collision rules that
+// one snake never meets: heads meeting or swapping cells, a head following a
+// tail, two heads on one food, and reusing a dead snake's id. Then random
+// operations are played on the unrolled list, with and without its hash
+// index, and the plain linked list side by side, which must always hold the
+// same payloads in the same order and agree on which values they contain.
+//
+// One worker process runs per core until the time limit or the first
+// divergence. A divergence is shrunk to a minimal input sequence and written
+// out as a test/traces.json entry whose expected output is the reference
+// behaviour.
+//
+//    $ make difftest ASAN=0 && ./difftest [SECONDS] [SEED]
+
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/arena.h"
+#include "../src/batch_env.h"
+#include "../src/board_cache.h"
+#include "../src/common.h"
+#include "../src/food_index.h"
+#include "../src/game.h"
+#include "../src/game_setup.h"
+#include "../src/linked_list.h"
+#include "../src/multi_snake.h"
+#include "../src/parallel_decode.h"
+#include "../src/snake_body.h"
+#include "../src/tiled_board.h"
+#include "../src/zobrist.h"
+#include "reference.h"
+
+#define MAX_INPUTS 400
+#define MAX_BOARD_STR 8192
+#define REPRO_FILE "difftest-repro.json"
+#define ULIST_OPS 200000  // random operations in check_ulist()
+
+// A generated test case.
+typedef struct test_case {
+    char board[MAX_BOARD_STR];
+    unsigned seed;
+    int grows;
+    char inputs[MAX_INPUTS + 1];  // 'U', 'D', 'L', 'R' or 'N' per tick
+    size_t num_inputs;
+} test_case_t;
+
+// Shared between the workers.
+typedef struct shared {
+    uint64_t cases;
+    uint64_t ticks;
+    int stop;
+} shared_t;
+
+// Ways of playing a game that must agree with the reference.
+enum play_path {
+    PATH_UPDATE,     // initialize_game(), then update()
+    PATH_KERNEL,     // select_update() kernels
+    PATH_BATCH_ONE,  // update_batch() one step at a time
+    PATH_CACHE,      // board_cache_initialize_game(), then update()
+    PATH_BATCH_ENV,  // a one-game batch_env_t
+    PATH_TILED,      // tiled_initialize_game(), then tiled_update()
+    PATH_MULTI,      // multi_init() with just the board's snake
+    NUM_PLAY_PATHS
+};
+static const char* path_names[NUM_PLAY_PATHS] = {
+    "update", "kernel", "batch-step", "cache", "batch-env", "tiled", "multi"};
+
+static board_cache_t g_cache;
+
+// Set when a path's incremental hash no longer matches its board hashed
+// from scratch. Compared alone, a stale hash could hide a wrong board, so
+// each case ends, and each divergence is looked at, with a full hash.
+static int g_stale_hash;
+
+/* xorshift64*, for generating cases independently of the game's rand().
+ */
+static uint64_t next_rand(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 2685821657736338717ull;
+}
+
+static size_t rand_below(uint64_t* state, size_t n) {
+    return (size_t)(next_rand(state) % n);
+}
+
+/* Writes a random walled board as a board string into `out`. Returns the
+   number of cells the snake could grow into.
+*/
+static size_t gen_board(uint64_t* rng, char* out) {
+    size_t height = 3 + rand_below(rng, 20);
+    size_t width = 3 + rand_below(rng, 30);
+    char grid[32][40];
+    size_t free_cells = 0;
+    for (size_t row = 0; row < height; row++) {
+        for (size_t col = 0; col < width; col++) {
+            size_t roll = rand_below(rng, 100);
+            if (row == 0 || col == 0 || row == height - 1 || col == width - 1 ||
+                roll < 8) {
+                grid[row][col] = 'W';
+            } else {
+                grid[row][col] = roll < 25 ? 'G' : 'E';
+                free_cells++;
+            }
+        }
+    }
+    size_t snake_row = 1 + rand_below(rng, height - 2);
+    size_t snake_col = 1 + rand_below(rng, width - 2);
+    free_cells -= grid[snake_row][snake_col] != 'W';
+    grid[snake_row][snake_col] = 'S';
+
+    char* p = out + sprintf(out, "B%zux%zu", height, width);
+    for (size_t row = 0; row < height; row++) {
+        *p++ = '|';
+        for (size_t col = 0; col < width;) {
+            size_t run = 1;
+            while (col + run < width && grid[row][col + run] == grid[row][col]) {
+                run++;
+            }
+            p += sprintf(p, "%c%zu", grid[row][col], run);
+            col += run;
+        }
+    }
+    return free_cells;
+}
+
+/* Breaks a board string in one of several ways: wrong dimensions, a bad
+   character, no snake, extra snakes, or a random byte.
+*/
+static void break_board(uint64_t* rng, char* board) {
+    size_t len = strlen(board);
+    size_t at = 1 + rand_below(rng, len - 1);
+    switch (rand_below(rng, 6)) {
+        case 0: {  // different dimensions
+            char rest[MAX_BOARD_STR];
+            unsigned height, width;
+            char* bar = strchr(board, '|');
+            sscanf(board, "B%ux%u", &height, &width);
+            snprintf(rest, sizeof(rest), "%s", bar);
+            height += rand_below(rng, 2) ? 1 : -1;
+            width += rand_below(rng, 3) - 1;
+            int header = sprintf(board, "B%ux%u", height, width);
+            memcpy(board + header, rest, strlen(rest) + 1);
+            break;
+        }
+        case 1:  // a letter that isn't a cell type
+            board[at] = "QZexw"[rand_below(rng, 5)];
+            break;
+        case 2: {  // no snake
+            char* snake = strchr(board, 'S');
+            *snake = 'E';
+            break;
+        }
+        case 3: {  // a second snake
+            char* run = strchr(board + at, 'E');
+            if (run == NULL) {
+                run = strchr(board, 'E');
+            }
+            if (run != NULL) {
+                *run = 'S';
+            }
+            break;
+        }
+        case 4:  // drop a row
+            board[strrchr(board, '|') - board] = '\0';
+            break;
+        default:
+            board[at] = (char)(' ' + rand_below(rng, 95));
+            break;
+    }
+}
+
+/* Generates a random case. */
+static void gen_case(uint64_t* rng, test_case_t* tc) {
+    size_t free_cells = gen_board(rng, tc->board);
+    int broken = rand_below(rng, 5) == 0;
+    if (broken) {
+        break_board(rng, tc->board);
+    }
+    tc->seed = (unsigned)next_rand(rng);
+    tc->grows = (int)rand_below(rng, 2);
+
+    // a growing snake must never fill the board, or placing food would
+    // never finish
+    size_t max_inputs = MAX_INPUTS;
+    if (tc->grows && free_cells / 2 < max_inputs) {
+        max_inputs = free_cells / 2;
+    }
+    tc->num_inputs = broken ? 0 : rand_below(rng, max_inputs + 1);
+    for (size_t i = 0; i < tc->num_inputs; i++) {
+        // mostly keep going, so games last a while
+        tc->inputs[i] = rand_below(rng, 3) ? 'N' : "UDLR"[rand_below(rng, 4)];
+    }
+    tc->inputs[tc->num_inputs] = '\0';
+}
+
+static enum input_key to_input(char c) {
+    switch (c) {
+        case 'U':
+            return INPUT_UP;
+        case 'D':
+            return INPUT_DOWN;
+        case 'L':
+            return INPUT_LEFT;
+        case 'R':
+            return INPUT_RIGHT;
+    }
+    return INPUT_NONE;
+}
+
+/* Frees everything a game allocated. */
+static void end_case(snake_t* snake_p) {
+    g_zobrist = NULL;
+    arena_reset(g_arena);
+    snake_body_init(&snake_p->snake_pos);
+}
+
+/* The state word compared after every tick: the Zobrist hash of the board,
+   head, direction and score, plus the game-over flag.
+*/
+static uint64_t state_word(zobrist_t* zobrist) {
+    return zobrist->hash ^ (g_game_over ? 0x8000000000000001ull : 0);
+}
+
+/* state_word() for a reference game, hashed from scratch. */
+static uint64_t ref_state_word(int* cells, size_t width, size_t height,
+                               ref_snake_t* snake_p) {
+    uint64_t cells_hash = 0;
+    for (size_t i = 0; i < width * height; i++) {
+        cells_hash ^= zobrist_cell_key(i, cells[i]);
+    }
+    zobrist_t zobrist;
+    zobrist_start(&zobrist, cells_hash, width, ref_snake_head(snake_p),
+                  snake_p->snake_dir, g_score);
+    return state_word(&zobrist);
+}
+
+/* Returns 1 if `input` would turn the reference snake into its own body
+   (other than the tail, which moves away). The reference lets the snake
+   overlap itself there; multi_step() kills it.
+*/
+static int ref_bites_itself(int* cells, size_t width, ref_snake_t* snake_p,
+                            enum input_key input) {
+    static const enum direction turns[] = {
+        [INPUT_UP] = UP, [INPUT_DOWN] = DOWN, [INPUT_LEFT] = LEFT,
+        [INPUT_RIGHT] = RIGHT};
+    enum direction dir =
+        input == INPUT_NONE ? snake_p->snake_dir : turns[input];
+    int head = ref_snake_head(snake_p);
+    int target = dir == UP     ? head - (int)width
+                 : dir == DOWN ? head + (int)width
+                 : dir == LEFT ? head - 1
+                               : head + 1;
+    return (cells[target] & FLAG_SNAKE) && target != ref_snake_tail(snake_p);
+}
+
+/* Decodes the board every way we can. Returns 1 if the decoders agree
+   (writing the reference status to *status_p), 0 if they don't.
+*/
+static int check_decode(test_case_t* tc, enum board_init_status* status_p,
+                        char* why) {
+    char copy[MAX_BOARD_STR];
+    snprintf(copy, sizeof(copy), "%s", tc->board);
+    int* ref_cells;
+    size_t width;
+    size_t height;
+    ref_snake_t ref_snake;
+    enum board_init_status status =
+        ref_decompress_board_str(&ref_cells, &width, &height, &ref_snake, copy);
+    *status_p = status;
+
+    snprintf(copy, sizeof(copy), "%s", tc->board);
+    int* cells = NULL;
+    size_t dense_width = 0;
+    size_t dense_height = 0;
+    snake_t snake;
+    snake_body_init(&snake.snake_pos);
+    enum board_init_status dense_status = decompress_board_str(
+        &cells, &dense_width, &dense_height, &snake, copy);
+
+    tiled_board_t tiled;
+    snake_t tiled_snake;
+    snake_body_init(&tiled_snake.snake_pos);
+    enum board_init_status tiled_status =
+        tiled_decompress_board_str(&tiled, &tiled_snake, tc->board);
+
+    // several threads even on small boards, so chunk boundaries are tested
+    int* par_cells = NULL;
+    size_t par_width = 0;
+    size_t par_height = 0;
+    snake_t par_snake;
+    enum board_init_status par_status = parallel_decompress_board_str(
+        &par_cells, &par_width, &par_height, &par_snake, tc->board, 4);
+
+    const board_proto_t* proto = NULL;
+    enum board_init_status cache_status =
+        board_cache_lookup(&g_cache, tc->board, &proto);
+
+    int agree = 1;
+    if (dense_status != status || tiled_status != status ||
+        cache_status != status || par_status != status) {
+        sprintf(why,
+                "decode status: reference %d, decompress_board_str %d, "
+                "tiled %d, cache %d, parallel %d",
+                status, dense_status, tiled_status, cache_status, par_status);
+        agree = 0;
+    } else if (status == INIT_SUCCESS) {
+        int ref_start = ref_snake_head(&ref_snake);
+        size_t start = snake.snake_pos.head;
+        size_t tiled_start = tiled_snake.snake_pos.head;
+        if (dense_width != width || dense_height != height ||
+            cell_row(start, width) * width + cell_col(start, width) !=
+                (size_t)ref_start ||
+            tiled.width != width || tiled.height != height ||
+            proto->width != width || proto->height != height ||
+            par_width != width || par_height != height ||
+            par_snake.snake_pos.head != start ||
+            tiled_start != cell_row(start, width) * width +
+                               cell_col(start, width) ||
+            (size_t)proto->snake_start != start) {
+            sprintf(why, "decoded dimensions or snake differ");
+            agree = 0;
+        }
+        for (size_t row = 0; agree && row < height; row++) {
+            for (size_t col = 0; col < width; col++) {
+                size_t pos = cell_index(row, col, width);
+                int cell = ref_cells[row * width + col];
+                if (cells[pos] != cell || tiled_get(&tiled, row, col) != cell ||
+                    proto->cells[pos] != cell || par_cells[pos] != cell) {
+                    sprintf(why, "decoded cell (%zu, %zu) differs", row, col);
+                    agree = 0;
+                    break;
+                }
+            }
+        }
+    }
+    tiled_teardown(&tiled, &tiled_snake);
+    ref_teardown(ref_cells, &ref_snake);
+    end_case(&snake);
+    return agree;
+}
+
+/* Plays the case's first `num_inputs` inputs on the reference, filling
+   words[0..num_inputs] with the state after each tick (words[0] is the
+   start) and, if `scores` isn't NULL, scores[] with the score after each
+   tick, *over_p with the tick the game ended on and *bite_p with the first
+   tick the snake ran into its own body (-1 if it didn't). The final board
+   is left in *cells_p etc. for the caller, who must call ref_teardown().
+*/
+static void play_reference(test_case_t* tc, size_t num_inputs, uint64_t* words,
+                           int* scores, long* over_p, long* bite_p,
+                           int** cells_p, size_t* width_p, size_t* height_p,
+                           ref_snake_t* snake_p) {
+    char copy[MAX_BOARD_STR];
+    snprintf(copy, sizeof(copy), "%s", tc->board);
+    set_seed(tc->seed);
+    ref_initialize_game(cells_p, width_p, height_p, snake_p, copy);
+    words[0] = ref_state_word(*cells_p, *width_p, *height_p, snake_p);
+    long over = -1;
+    long bite = -1;
+    if (scores != NULL) {
+        scores[0] = g_score;
+    }
+    for (size_t i = 0; i < num_inputs; i++) {
+        enum input_key input = to_input(tc->inputs[i]);
+        if (bite < 0 && !g_game_over &&
+            ref_bites_itself(*cells_p, *width_p, snake_p, input)) {
+            bite = (long)i + 1;
+        }
+        ref_update(*cells_p, *width_p, *height_p, snake_p, input, tc->grows);
+        words[i + 1] = ref_state_word(*cells_p, *width_p, *height_p, snake_p);
+        if (scores != NULL) {
+            scores[i + 1] = g_score;
+        }
+        if (g_game_over && over < 0) {
+            over = (long)i + 1;
+        }
+    }
+    if (over_p != NULL) {
+        *over_p = over;
+    }
+    if (bite_p != NULL) {
+        *bite_p = bite;
+    }
+}
+
+/* Plays the case's first `num_inputs` inputs along `path`. Returns the
+   first tick whose state differs from `words` (0 for the starting state),
+   or -1 if every tick matched.
+*/
+static long play_path(test_case_t* tc, size_t num_inputs, enum play_path path,
+                      const uint64_t* words) {
+    char copy[MAX_BOARD_STR];
+    snprintf(copy, sizeof(copy), "%s", tc->board);
+    int* cells;
+    size_t width;
+    size_t height;
+    snake_t snake;
+    zobrist_t zobrist;
+    set_seed(tc->seed);
+    if (path == PATH_CACHE) {
+        board_cache_initialize_game(&g_cache, &cells, &width, &height, &snake,
+                                    copy);
+    } else {
+        initialize_game(&cells, &width, &height, &snake, copy);
+    }
+    zobrist_init(&zobrist, cells, width, height, &snake, g_score);
+    g_zobrist = &zobrist;
+
+    long diverged = state_word(&zobrist) == words[0] ? -1 : 0;
+    update_fn step = select_update(cells, width, height, tc->grows);
+    for (size_t i = 0; i < num_inputs && diverged < 0; i++) {
+        enum input_key input = to_input(tc->inputs[i]);
+        if (path == PATH_BATCH_ONE) {
+            unsigned char packed;
+            pack_inputs(&input, 1, snake.snake_dir, &packed);
+            update_batch(cells, width, height, &snake, &packed, 1, tc->grows);
+        } else if (path == PATH_KERNEL) {
+            step(cells, width, height, &snake, input, tc->grows);
+        } else {
+            update(cells, width, height, &snake, input, tc->grows);
+        }
+        if (state_word(&zobrist) != words[i + 1]) {
+            diverged = (long)i + 1;
+        }
+    }
+    if (zobrist.hash !=
+        zobrist_compute(cells, width, height, &snake, g_score)) {
+        g_stale_hash = 1;
+        diverged = diverged < 0 ? (long)num_inputs : diverged;
+    }
+    end_case(&snake);
+    return diverged;
+}
+
+/* Plays the case's first `num_inputs` inputs on a tiled board. Returns the
+   first tick whose state differs from `words`, or -1 if every tick matched.
+*/
+static long play_tiled(test_case_t* tc, size_t num_inputs,
+                       const uint64_t* words) {
+    char copy[MAX_BOARD_STR];
+    snprintf(copy, sizeof(copy), "%s", tc->board);
+    tiled_board_t board;
+    snake_t snake;
+    zobrist_t zobrist;
+    set_seed(tc->seed);
+    tiled_initialize_game(&board, &snake, copy);
+    tiled_zobrist_init(&zobrist, &board, &snake, g_score);
+    g_zobrist = &zobrist;
+
+    long diverged = state_word(&zobrist) == words[0] ? -1 : 0;
+    for (size_t i = 0; i < num_inputs && diverged < 0; i++) {
+        tiled_update(&board, &snake, to_input(tc->inputs[i]), tc->grows);
+        if (state_word(&zobrist) != words[i + 1]) {
+            diverged = (long)i + 1;
+        }
+    }
+    g_zobrist = NULL;
+    zobrist_t full;
+    tiled_zobrist_init(&full, &board, &snake, g_score);
+    if (zobrist.hash != full.hash) {
+        g_stale_hash = 1;
+        diverged = diverged < 0 ? (long)num_inputs : diverged;
+    }
+    tiled_teardown(&board, &snake);
+    return diverged;
+}
+
+/* Plays the case as a multi-snake game holding only the board's snake,
+   which follows different rules once the snake runs into itself or a wall:
+   the reference lets it overlap itself or stops, while multi_step() kills
+   it and takes it off the board. So the states must agree until then, and
+   on that tick snake 0 must die. Returns the first tick that differs, or
+   -1 if none did.
+*/
+static long play_multi(test_case_t* tc, size_t num_inputs,
+                       const uint64_t* words, long over, long bite) {
+    multi_game_t game;
+    set_seed(tc->seed);
+    multi_init(&game, tc->board, 1, tc->grows);
+    multi_snake_t* ms = &game.snakes[0];
+    long end = bite >= 0 && (over < 0 || bite < over) ? bite : over;
+
+    long diverged = zobrist_compute(game.cells, game.width, game.height,
+                                    &ms->snake, ms->score) == words[0]
+                        ? -1
+                        : 0;
+    for (size_t i = 0; i < num_inputs && diverged < 0; i++) {
+        long tick = (long)i + 1;
+        enum input_key input = to_input(tc->inputs[i]);
+        multi_step(&game, &input);
+        if (tick == end) {
+            diverged = ms->alive ? tick : -1;
+            break;
+        }
+        if (!ms->alive || zobrist_compute(game.cells, game.width, game.height,
+                                          &ms->snake, ms->score) !=
+                              words[tick]) {
+            diverged = tick;
+        }
+    }
+    multi_teardown(&game);
+    return diverged;
+}
+
+/* Plays the case in a one-game batch_env_t. Until the game ends every
+   step must reach the reference's state and reward. On the reference's
+   last tick the step must report done and that tick's reward, and the game
+   must have restarted from the board's starting snake. A Zobrist hash left
+   active by the caller must not see any of it. Returns the first tick that
+   differs, or -1 if none did.
+*/
+static long play_batch_env(test_case_t* tc, size_t num_inputs,
+                           const uint64_t* words, const int* scores,
+                           long over) {
+    // the caller's game, which the batch must leave alone
+    zobrist_t caller;
+    memset(&caller, 0, sizeof(caller));
+    caller.hash = 0x1234;
+    g_zobrist = &caller;
+
+    batch_env_t env;
+    set_seed(tc->seed);
+    batch_env_init(&env, 1, tc->board, tc->grows);
+    size_t start = (size_t)env.proto->snake_start;
+    snake_t* snake = &env.snakes[0];
+    int* cells = batch_env_cells(&env, 0);
+
+    long diverged =
+        zobrist_compute(cells, env.width, env.height, snake, 0) == words[0]
+            ? -1
+            : 0;
+    for (size_t i = 0; i < num_inputs && diverged < 0; i++) {
+        long tick = (long)i + 1;
+        enum input_key input = to_input(tc->inputs[i]);
+        int reward;
+        batch_env_step(&env, &input, &reward);
+        if (reward != scores[tick] - scores[tick - 1] ||
+            env.done[0] != (tick == over)) {
+            diverged = tick;
+        } else if (env.done[0]) {
+            if (env.scores[0] != 0 || snake->snake_pos.length != 1 ||
+                snake->snake_pos.head != start || snake->snake_dir != RIGHT) {
+                diverged = tick;
+            }
+            break;
+        } else if (zobrist_compute(cells, env.width, env.height, snake,
+                                   env.scores[0]) != words[tick]) {
+            diverged = tick;
+        }
+    }
+    if (caller.hash != 0x1234 && diverged < 0) {
+        diverged = 0;
+    }
+    batch_env_teardown(&env);
+    g_zobrist = NULL;
+    return diverged;
+}
+
+/* Plays the whole case in one update_batch() call. Returns 1 if it ends in
+   the reference's final state.
+*/
+static int play_whole_batch(test_case_t* tc, const uint64_t* words) {
+    char copy[MAX_BOARD_STR];
+    snprintf(copy, sizeof(copy), "%s", tc->board);
+    int* cells;
+    size_t width;
+    size_t height;
+    snake_t snake;
+    zobrist_t zobrist;
+    set_seed(tc->seed);
+    initialize_game(&cells, &width, &height, &snake, copy);
+    zobrist_init(&zobrist, cells, width, height, &snake, g_score);
+    g_zobrist = &zobrist;
+
+    enum input_key inputs[MAX_INPUTS];
+    unsigned char packed[MAX_INPUTS / 4 + 1];
+    for (size_t i = 0; i < tc->num_inputs; i++) {
+        inputs[i] = to_input(tc->inputs[i]);
+    }
+    pack_inputs(inputs, tc->num_inputs, snake.snake_dir, packed);
+    update_batch(cells, width, height, &snake, packed, tc->num_inputs,
+                 tc->grows);
+    // update() ignores input once the game is over, so the last word is
+    // where update_batch() must end up even if it stopped early
+    int same = state_word(&zobrist) == words[tc->num_inputs];
+    if (zobrist.hash !=
+        zobrist_compute(cells, width, height, &snake, g_score)) {
+        g_stale_hash = 1;
+        same = 0;
+    }
+    end_case(&snake);
+    return same;
+}
+
+/* Returns the Manhattan distance between cell positions `a` and `b`. */
+static size_t cell_distance(size_t a, size_t b, size_t width) {
+    size_t row_a = cell_row(a, width);
+    size_t row_b = cell_row(b, width);
+    size_t col_a = cell_col(a, width);
+    size_t col_b = cell_col(b, width);
+    return (row_a > row_b ? row_a - row_b : row_b - row_a) +
+           (col_a > col_b ? col_a - col_b : col_b - col_a);
+}
+
+/* Returns 1 if g_food_index holds exactly the food on the board (each food
+   cell once, and nothing else), and finds the food nearest `pos` at the
+   distance a scan of the board does.
+*/
+static int food_index_matches(int* cells, size_t width, size_t height,
+                              size_t pos) {
+    size_t food = 0;
+    size_t best = SIZE_MAX;
+    for (size_t row = 0; row < height; row++) {
+        for (size_t col = 0; col < width; col++) {
+            size_t at = cell_index(row, col, width);
+            if (!(cells[at] & FLAG_FOOD)) {
+                continue;
+            }
+            if (food_index_count_in(g_food_index, row, col, row, col) != 1) {
+                return 0;
+            }
+            size_t dist = cell_distance(at, pos, width);
+            best = dist < best ? dist : best;
+            food++;
+        }
+    }
+    size_t nearest;
+    if (g_food_index->count != food ||
+        food_index_nearest(g_food_index, pos, &nearest) != (food > 0)) {
+        return 0;
+    }
+    return food == 0 || cell_distance(nearest, pos, width) == best;
+}
+
+/* Plays the case with 2 to 4 food items, which initialize_game() and
+   multi_init() index, first with update() and then as a multi-snake game
+   with two food-seeking bots added. Returns the first tick where the index
+   doesn't match the board, or -1 if it always did.
+*/
+static long check_food_index(test_case_t* tc, size_t num_inputs) {
+    char copy[MAX_BOARD_STR];
+    snprintf(copy, sizeof(copy), "%s", tc->board);
+    int* cells;
+    size_t width;
+    size_t height;
+    snake_t snake;
+    g_food_count = 2 + (int)(tc->seed % 3);
+    set_seed(tc->seed);
+    initialize_game(&cells, &width, &height, &snake, copy);
+
+    // a growing snake that fills the board would leave nowhere for food
+    size_t ticks = num_inputs;
+    if (tc->grows) {
+        size_t free_cells = count_free_cells(cells, width, height, ticks + 1);
+        ticks = free_cells > ticks ? ticks : free_cells ? free_cells - 1 : 0;
+    }
+    long failed = g_food_index != NULL &&
+                          food_index_matches(cells, width, height,
+                                             snake.snake_pos.head)
+                      ? -1
+                      : 0;
+    for (size_t i = 0; i < ticks && failed < 0; i++) {
+        update(cells, width, height, &snake, to_input(tc->inputs[i]),
+               tc->grows);
+        if (!food_index_matches(cells, width, height, snake.snake_pos.head)) {
+            failed = (long)i + 1;
+        }
+    }
+    teardown(cells, &snake);
+
+    multi_game_t game;
+    if (failed < 0 && multi_init(&game, tc->board, 3, 0) == INIT_SUCCESS) {
+        multi_spawn(&game);
+        multi_spawn(&game);
+        size_t corner = cell_index(0, 0, game.width);
+        enum input_key inputs[3];
+        for (size_t i = 0; i < num_inputs && failed < 0; i++) {
+            inputs[0] = to_input(tc->inputs[i]);
+            for (size_t id = 1; id < game.num_snakes; id++) {
+                inputs[id] = game.snakes[id].alive ? multi_bot_input(&game, id)
+                                                   : INPUT_NONE;
+            }
+            multi_step(&game, inputs);
+            if (!food_index_matches(game.cells, game.width, game.height,
+                                    corner)) {
+                failed = (long)i + 1;
+            }
+        }
+        multi_teardown(&game);
+    }
+    // back to one item and no index for the other paths
+    g_food_count = 1;
+    food_index_select();
+    return failed;
+}
+
+/* Checks one case. Returns 1 if every path agrees; otherwise describes the
+   divergence in `why` and sets *path_p to the play path at fault (or -1 for
+   decoding or the whole-trace batch).
+*/
+static int check_case(test_case_t* tc, size_t num_inputs, int* path_p,
+                      long* tick_p, char* why) {
+    enum board_init_status status;
+    *path_p = -1;
+    *tick_p = -1;
+    g_stale_hash = 0;
+    if (!check_decode(tc, &status, why)) {
+        return 0;
+    }
+    if (status != INIT_SUCCESS) {
+        return 1;
+    }
+
+    uint64_t words[MAX_INPUTS + 1];
+    int scores[MAX_INPUTS + 1];
+    long over;
+    long bite;
+    int* cells;
+    size_t width;
+    size_t height;
+    ref_snake_t snake;
+    play_reference(tc, num_inputs, words, scores, &over, &bite, &cells, &width,
+                   &height, &snake);
+    ref_teardown(cells, &snake);
+
+    for (int path = 0; path < NUM_PLAY_PATHS; path++) {
+        long tick;
+        if (path == PATH_BATCH_ENV) {
+            tick = play_batch_env(tc, num_inputs, words, scores, over);
+        } else if (path == PATH_TILED) {
+            tick = play_tiled(tc, num_inputs, words);
+        } else if (path == PATH_MULTI) {
+            tick = play_multi(tc, num_inputs, words, over, bite);
+        } else {
+            tick = play_path(tc, num_inputs, path, words);
+        }
+        if (tick >= 0) {
+            *path_p = path;
+            *tick_p = tick;
+            sprintf(why, "%s path diverges from the reference at tick %ld%s",
+                    path_names[path], tick,
+                    g_stale_hash ? ", and its incremental hash is stale" : "");
+            return 0;
+        }
+    }
+    if (num_inputs == tc->num_inputs && !play_whole_batch(tc, words)) {
+        sprintf(why, "whole-trace update_batch() ends in a different state%s",
+                g_stale_hash ? ", and its incremental hash is stale" : "");
+        return 0;
+    }
+    *tick_p = check_food_index(tc, num_inputs);
+    if (*tick_p >= 0) {
+        sprintf(why, "food index disagrees with the board at tick %ld",
+                *tick_p);
+        return 0;
+    }
+    return 1;
+}
+
+/* Shrinks a failing case's inputs: cut everything after the divergence,
+   then drop or blank out inputs one at a time while it still fails.
+*/
+static void minimize(test_case_t* tc, long tick) {
+    char why[256];
+    int path;
+    long new_tick;
+    if (tick >= 0) {
+        tc->num_inputs = (size_t)tick;
+        tc->inputs[tc->num_inputs] = '\0';
+    }
+    int changed = 1;
+    while (changed) {
+        changed = 0;
+        for (size_t i = 0; i < tc->num_inputs; i++) {
+            test_case_t trial = *tc;
+            memmove(&trial.inputs[i], &trial.inputs[i + 1],
+                    trial.num_inputs - i);
+            trial.num_inputs--;
+            if (!check_case(&trial, trial.num_inputs, &path, &new_tick, why)) {
+                *tc = trial;
+                changed = 1;
+                i--;
+                continue;
+            }
+            if (tc->inputs[i] != 'N') {
+                trial = *tc;
+                trial.inputs[i] = 'N';
+                if (!check_case(&trial, trial.num_inputs, &path, &new_tick,
+                                why)) {
+                    *tc = trial;
+                    changed = 1;
+                }
+            }
+        }
+    }
+}
+
+/* Returns the autograder's letter for a cell. */
+static char cell_letter(int cell) {
+    if ((cell & FLAG_GRASS) && (cell & FLAG_SNAKE)) {
+        return 's';
+    } else if ((cell & FLAG_GRASS) && (cell & FLAG_FOOD)) {
+        return 'o';
+    } else if (cell & FLAG_GRASS) {
+        return 'G';
+    } else if (cell == PLAIN_CELL) {
+        return '.';
+    } else if (cell & FLAG_SNAKE) {
+        return 'S';
+    } else if (cell & FLAG_WALL) {
+        return 'X';
+    } else if (cell & FLAG_FOOD) {
+        return 'O';
+    }
+    return '?';
+}
+
+/* Writes a failing case as a traces.json entry whose expected output is
+   what the reference path does.
+*/
+static void write_repro(test_case_t* tc, const char* why) {
+    FILE* out = fopen(REPRO_FILE, "w");
+    if (out == NULL) {
+        out = stderr;
+    }
+    fprintf(out,
+            "  \"testXXX\": {\n"
+            "    \"description\": \"difftest: %s\",\n"
+            "    \"board\": \"%s\",\n"
+            "    \"seed\": \"%u\",\n"
+            "    \"snake_grows\": \"%d\",\n"
+            "    \"key_input\": \"%s\",\n"
+            "    \"output\": {\n",
+            why, tc->board, tc->seed, tc->grows, tc->inputs);
+
+    enum board_init_status status;
+    char ignored[256];
+    check_decode(tc, &status, ignored);
+    static const char* errors[] = {"", "INCORRECT_DIMENSIONS",
+                                   "WRONG_SNAKE_NUM", "BAD_CHAR"};
+    if (status != INIT_SUCCESS) {
+        fprintf(out, "      \"board_error\": \"%s\"\n", errors[status]);
+    } else {
+        uint64_t words[MAX_INPUTS + 1];
+        int* cells;
+        size_t width;
+        size_t height;
+        ref_snake_t snake;
+        play_reference(tc, tc->num_inputs, words, NULL, NULL, NULL, &cells,
+                       &width, &height, &snake);
+        fprintf(out,
+                "      \"game_over\": %d,\n"
+                "      \"score\": %d,\n"
+                "      \"width\": %zu,\n"
+                "      \"height\": %zu,\n"
+                "      \"cells\": [\n",
+                g_game_over, g_score, width, height);
+        for (size_t row = 0; row < height; row++) {
+            fprintf(out, "        \"");
+            for (size_t col = 0; col < width; col++) {
+                fputc(cell_letter(cells[row * width + col]), out);
+            }
+            fprintf(out, "\"%s\n", row + 1 < height ? "," : "");
+        }
+        fprintf(out, "      ]\n");
+        ref_teardown(cells, &snake);
+    }
+    fprintf(out, "    }\n  }\n");
+    if (out != stderr) {
+        fclose(out);
+    }
+}
+
+// The board the multi_step() rule checks play on: snake 0 starts at (2, 1).
+#define RULES_BOARD "B5x10|W10|W1E8W1|W1S1E7W1|W1E8W1|W10"
+
+static int g_rules_failed;
+
+/* Reports a multi_step() rule that doesn't hold. */
+static void expect_rule(int holds, const char* rule) {
+    if (!holds) {
+        fprintf(stderr, "multi_step rule broken: %s\n", rule);
+        g_rules_failed = 1;
+    }
+}
+
+/* Starts a two-snake game on RULES_BOARD with no food on it. */
+static void rules_start(multi_game_t* game, int growing) {
+    char board[] = RULES_BOARD;
+    set_seed(1);
+    multi_init(game, board, 2, growing);
+    for (size_t row = 0; row < game->height; row++) {
+        for (size_t col = 0; col < game->width; col++) {
+            game->cells[cell_index(row, col, game->width)] &= ~FLAG_FOOD;
+        }
+    }
+}
+
+static size_t rules_at(multi_game_t* game, size_t row, size_t col) {
+    return cell_index(row, col, game->width);
+}
+
+/* Grows snake `id` by `steps` segments at its head, in direction `dir`,
+   and points it that way.
+*/
+static void rules_extend(multi_game_t* game, size_t id, enum direction dir,
+                         int steps) {
+    snake_t* snake_p = &game->snakes[id].snake;
+    for (int i = 0; i < steps; i++) {
+        size_t pos = cell_neighbour(game->cells, snake_p->snake_pos.head, dir,
+                                    game->width);
+        game->cells[pos] |= FLAG_SNAKE;
+        snake_body_push_head(&snake_p->snake_pos, dir, pos);
+    }
+    snake_p->snake_dir = dir;
+}
+
+/* Plays one tick with no turns. */
+static void rules_step(multi_game_t* game) {
+    enum input_key inputs[2] = {INPUT_NONE, INPUT_NONE};
+    multi_step(game, inputs);
+}
+
+static size_t rules_food(multi_game_t* game) {
+    size_t food = 0;
+    for (size_t row = 0; row < game->height; row++) {
+        for (size_t col = 0; col < game->width; col++) {
+            food += (game->cells[rules_at(game, row, col)] & FLAG_FOOD) != 0;
+        }
+    }
+    return food;
+}
+
+/* Plays fixed two-snake scenarios for each collision rule of multi_step()
+   that a one-snake game can't reach. Returns 1 if they all hold.
+*/
+static int check_multi_rules(void) {
+    multi_game_t game;
+    multi_snake_t* first;
+    multi_snake_t* second;
+
+    // head to head: the longer snake wins
+    rules_start(&game, 0);
+    rules_extend(&game, 0, RIGHT, 2);
+    expect_rule(multi_add_snake(&game, rules_at(&game, 2, 5), LEFT) == 1,
+                "a new snake gets the next id");
+    rules_step(&game);
+    first = &game.snakes[0];
+    second = &game.snakes[1];
+    expect_rule(first->alive && !second->alive && game.num_alive == 1 &&
+                    first->snake.snake_pos.head == rules_at(&game, 2, 4) &&
+                    game.cells[rules_at(&game, 2, 5)] == PLAIN_CELL,
+                "the longer snake wins head to head");
+    multi_teardown(&game);
+
+    // head to head: a tie kills both
+    rules_start(&game, 0);
+    multi_add_snake(&game, rules_at(&game, 2, 3), LEFT);
+    rules_step(&game);
+    expect_rule(!game.snakes[0].alive && !game.snakes[1].alive &&
+                    game.num_alive == 0 &&
+                    game.cells[rules_at(&game, 2, 1)] == PLAIN_CELL &&
+                    game.cells[rules_at(&game, 2, 2)] == PLAIN_CELL &&
+                    game.cells[rules_at(&game, 2, 3)] == PLAIN_CELL,
+                "tied heads both die and leave the board");
+    multi_teardown(&game);
+
+    // swapping cells is head to head too
+    rules_start(&game, 0);
+    multi_add_snake(&game, rules_at(&game, 2, 2), LEFT);
+    rules_step(&game);
+    expect_rule(!game.snakes[0].alive && !game.snakes[1].alive,
+                "tied snakes swapping cells both die");
+    multi_teardown(&game);
+
+    rules_start(&game, 0);
+    rules_extend(&game, 0, RIGHT, 1);
+    multi_add_snake(&game, rules_at(&game, 2, 3), LEFT);
+    rules_step(&game);
+    first = &game.snakes[0];
+    expect_rule(first->alive && !game.snakes[1].alive &&
+                    first->snake.snake_pos.head == rules_at(&game, 2, 3),
+                "the longer of two swapping snakes wins");
+    multi_teardown(&game);
+
+    // a head may follow another snake's tail, unless that snake grows
+    rules_start(&game, 0);
+    multi_add_snake(&game, rules_at(&game, 2, 2), RIGHT);
+    rules_extend(&game, 1, RIGHT, 2);
+    rules_step(&game);
+    first = &game.snakes[0];
+    second = &game.snakes[1];
+    expect_rule(first->alive && second->alive &&
+                    first->snake.snake_pos.head == rules_at(&game, 2, 2) &&
+                    second->snake.snake_pos.tail == rules_at(&game, 2, 3),
+                "a head follows a moving tail");
+    multi_teardown(&game);
+
+    rules_start(&game, 1);
+    multi_add_snake(&game, rules_at(&game, 2, 2), RIGHT);
+    rules_extend(&game, 1, RIGHT, 2);
+    game.cells[rules_at(&game, 2, 5)] |= FLAG_FOOD;
+    rules_step(&game);
+    second = &game.snakes[1];
+    expect_rule(!game.snakes[0].alive && second->alive &&
+                    second->score == 1 && second->snake.snake_pos.length == 4 &&
+                    second->snake.snake_pos.tail == rules_at(&game, 2, 2),
+                "a head dies on the tail of a snake that grows");
+    multi_teardown(&game);
+
+    // two heads on one food: the longer snake eats it
+    rules_start(&game, 0);
+    game.cells[rules_at(&game, 2, 2)] |= FLAG_FOOD;
+    multi_add_snake(&game, rules_at(&game, 2, 4), LEFT);
+    rules_extend(&game, 1, LEFT, 1);
+    rules_step(&game);
+    first = &game.snakes[0];
+    second = &game.snakes[1];
+    expect_rule(!first->alive && first->score == 0 && second->alive &&
+                    second->score == 1 &&
+                    game.cells[rules_at(&game, 2, 2)] == FLAG_SNAKE &&
+                    rules_food(&game) == 1,
+                "the longer of two heads on one food eats it");
+    multi_teardown(&game);
+
+    rules_start(&game, 0);
+    game.cells[rules_at(&game, 2, 2)] |= FLAG_FOOD;
+    multi_add_snake(&game, rules_at(&game, 2, 3), LEFT);
+    rules_step(&game);
+    expect_rule(game.num_alive == 0 && game.snakes[0].score == 0 &&
+                    game.snakes[1].score == 0 &&
+                    game.cells[rules_at(&game, 2, 2)] == FLAG_FOOD &&
+                    rules_food(&game) == 1,
+                "tied heads on one food both die and leave it");
+    multi_teardown(&game);
+
+    // a full game reuses a dead snake's id
+    rules_start(&game, 0);
+    multi_add_snake(&game, rules_at(&game, 1, 1), UP);
+    rules_step(&game);
+    expect_rule(game.snakes[0].alive && !game.snakes[1].alive &&
+                    game.cells[rules_at(&game, 1, 1)] == PLAIN_CELL,
+                "a snake that hits a wall dies and leaves the board");
+    expect_rule(multi_add_snake(&game, rules_at(&game, 2, 2), RIGHT) == -1,
+                "no snake is added on another");
+    expect_rule(multi_add_snake(&game, rules_at(&game, 3, 5), RIGHT) == 1,
+                "a full game reuses a dead snake's id");
+    second = &game.snakes[1];
+    expect_rule(second->alive && second->score == 0 &&
+                    second->snake.snake_pos.length == 1 &&
+                    second->snake.snake_pos.head == rules_at(&game, 3, 5) &&
+                    game.num_alive == 2,
+                "a reused id starts a fresh snake");
+    expect_rule(multi_add_snake(&game, rules_at(&game, 3, 7), RIGHT) == -1,
+                "a full game with no dead snakes takes no more");
+    multi_teardown(&game);
+
+    return !g_rules_failed;
+}
+
+/* Returns NULL if the unrolled list holds the same payloads as the plain
+   list, in the same order, and otherwise what differs.
+*/
+static const char* ulist_differs(node_t* plain, ulist_t* list) {
+    int len = length_list(plain);
+    if (ulist_length(list) != len) {
+        return "lengths differ";
+    }
+    if (len == 0) {
+        return ulist_get_first(list) == NULL && ulist_get_last(list) == NULL
+                   ? NULL
+                   : "an empty list has a first or last payload";
+    }
+    if (*(int*)ulist_get_first(list) != *(int*)get_first(plain) ||
+        *(int*)ulist_get_last(list) != *(int*)get_last(plain)) {
+        return "first or last payloads differ";
+    }
+    int i = 0;
+    for (node_t* node = plain; node != NULL; node = node->next, i++) {
+        if (*(int*)ulist_get(list, i) != *(int*)node->data) {
+            return "payloads differ";
+        }
+    }
+    return ulist_get(list, -1) == NULL && ulist_get(list, len) == NULL
+               ? NULL
+               : "an index out of range has a payload";
+}
+
+/* Returns 1 if the plain list holds `value`, by scanning it. */
+static int plain_contains(node_t* plain, int value) {
+    for (node_t* node = plain; node != NULL; node = node->next) {
+        if (*(int*)node->data == value) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Plays ULIST_OPS random inserts at either end, removals (first, last and
+   by value), reversals and lookups on an unrolled list and a plain linked
+   list, comparing them after each, along with ulist_contains() for a few
+   values against a scan. With `indexed` the unrolled list keeps its hash
+   index, and every value is different, since the index may remove any of
+   several equal payloads; without it, values repeat. Returns 1 if they
+   always agreed.
+*/
+static int check_ulist(uint64_t seed, int indexed) {
+    uint64_t rng = seed * 0x9e3779b97f4a7c15ull + 7;
+    node_t* plain = NULL;
+    ulist_t list;
+    ulist_init(&list);
+    if (indexed) {
+        list.elem_size = sizeof(int);
+        ulist_enable_index(&list);
+    }
+    const char* differs = NULL;
+    long op;
+    for (op = 0; op < ULIST_OPS && differs == NULL; op++) {
+        int value = indexed ? (int)op : (int)rand_below(&rng, 32);
+        size_t len = (size_t)length_list(plain);
+        // removals by value hit a held payload half the time
+        int target = len > 0 && rand_below(&rng, 2)
+                         ? *(int*)get(plain, (int)rand_below(&rng, len))
+                         : value;
+        // inserts win below 64 payloads, so the list spans a few nodes
+        if (rand_below(&rng, 128) >= len) {
+            if (rand_below(&rng, 2)) {
+                insert_first(&plain, &value, sizeof(int));
+                ulist_insert_first(&list, &value, sizeof(int));
+            } else {
+                insert_last(&plain, &value, sizeof(int));
+                ulist_insert_last(&list, &value, sizeof(int));
+            }
+            differs = ulist_differs(plain, &list);
+            continue;
+        }
+        switch (rand_below(&rng, 4)) {
+            case 0:
+                remove_first(&plain);
+                ulist_remove_first(&list);
+                break;
+            case 1:
+                remove_last(&plain);
+                ulist_remove_last(&list);
+                break;
+            case 2:
+                if (remove_element(&plain, &target, sizeof(int)) !=
+                    ulist_remove_element(&list, &target, sizeof(int))) {
+                    differs = "removing by value succeeds in only one";
+                }
+                break;
+            default:
+                reverse(&plain);
+                ulist_reverse(&list);
+                break;
+        }
+        if (differs == NULL) {
+            differs = ulist_differs(plain, &list);
+        }
+        int probes[] = {value, target, (int)rand_below(&rng, (size_t)op + 1)};
+        for (size_t i = 0; i < 3 && differs == NULL; i++) {
+            if (ulist_contains(&list, &probes[i], sizeof(int)) !=
+                plain_contains(plain, probes[i])) {
+                differs = "contains() differs from a scan";
+            }
+        }
+    }
+    while (plain != NULL) {
+        remove_first(&plain);
+    }
+    ulist_clear(&list);
+    if (differs != NULL) {
+        fprintf(stderr, "unrolled list%s broken: %s after %ld operations\n",
+                indexed ? " with index" : "", differs, op);
+        return 0;
+    }
+    return 1;
+}
+
+/* One worker: checks cases until told to stop. Returns 0 if all agreed. */
+static int run_worker(shared_t* shared, uint64_t seed, time_t deadline) {
+    arena_t arena;
+    arena_init(&arena, 1 << 16);
+    g_arena = &arena;
+    board_cache_init(&g_cache, 1 << 20);
+
+    uint64_t rng = seed * 0x9e3779b97f4a7c15ull + 1;
+    test_case_t tc;
+    char why[256];
+    int path;
+    long tick;
+    uint64_t cases = 0;
+    int failed = 0;
+    while (!__atomic_load_n(&shared->stop, __ATOMIC_RELAXED)) {
+        gen_case(&rng, &tc);
+        if (!check_case(&tc, tc.num_inputs, &path, &tick, why)) {
+            failed = 1;
+            if (__atomic_exchange_n(&shared->stop, 1, __ATOMIC_ACQ_REL)) {
+                break;  // another worker is already reporting
+            }
+            fprintf(stderr, "divergence: %s\n", why);
+            minimize(&tc, tick);
+            check_case(&tc, tc.num_inputs, &path, &tick, why);
+            write_repro(&tc, why);
+            fprintf(stderr, "minimized to %zu inputs; wrote %s\n",
+                    tc.num_inputs, REPRO_FILE);
+            break;
+        }
+        // every path replays every tick
+        __atomic_add_fetch(&shared->ticks,
+                           tc.num_inputs * (NUM_PLAY_PATHS + 4),
+                           __ATOMIC_RELAXED);
+        if (++cases % 64 == 0) {
+            __atomic_add_fetch(&shared->cases, 64, __ATOMIC_RELAXED);
+            if (time(NULL) >= deadline) {
+                break;
+            }
+        }
+    }
+    board_cache_free(&g_cache);
+    g_arena = NULL;
+    arena_destroy(&arena);
+    return failed;
+}
+
+int main(int argc, char** argv) {
+    int seconds = argc > 1 ? atoi(argv[1]) : 10;
+    uint64_t seed = argc > 2 ? strtoull(argv[2], NULL, 0) : (uint64_t)time(NULL);
+    long num_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    if (num_workers < 1) {
+        num_workers = 1;
+    }
+
+    if (!check_multi_rules() || !check_ulist(seed, 0) ||
+        !check_ulist(seed, 1)) {
+        return EXIT_FAILURE;
+    }
+
+    shared_t* shared = mmap(NULL, sizeof(shared_t), PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    memset(shared, 0, sizeof(*shared));
+    printf("difftest: %ld workers, %d s, seed %llu\n", num_workers, seconds,
+           (unsigned long long)seed);
+    fflush(stdout);
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    time_t deadline = time(NULL) + seconds;
+    for (long i = 0; i < num_workers; i++) {
+        if (fork() == 0) {
+            exit(run_worker(shared, seed + (uint64_t)i, deadline));
+        }
+    }
+    int failed = 0;
+    int status;
+    while (wait(&status) > 0) {
+        failed |= !WIFEXITED(status) || WEXITSTATUS(status) != 0;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    double elapsed =
+        (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+
+    printf("%llu cases, %llu ticks compared (%.1fM ticks/s): %s\n",
+           (unsigned long long)shared->cases,
+           (unsigned long long)shared->ticks, shared->ticks / elapsed / 1e6,
+           failed ? "DIVERGED" : "all paths agree");
+    return failed ? EXIT_FAILURE : EXIT_SUCCESS;
+}
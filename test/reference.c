@@ -0,0 +1,437 @@
+// A frozen copy of update(), place_food() and decompress_board_str() (with
+// the parts of initialize_game() and the linked list they use) from the
+// first commit, before any optimization. Keep it that way: difftest checks
+// every engine path against it.
+//
+// The only changes are the ref_ prefix and the fixes below, each marked
+// "reference change". They make broken board strings fail cleanly, as
+// decompress_board_str() now does, instead of reading or writing out of
+// bounds, and let a full board start, as initialize_game() now does. Boards
+// that worked before play exactly as they did.
+//  - rows are sized to the string instead of a fixed 2048
+//  - missing dimensions read as 0, and header tokens past the third are
+//    ignored
+//  - cells are only allocated for boards whose row count matches their
+//    height
+//  - a run before any cell letter is INIT_ERR_BAD_CHAR
+//  - runs past either end of a row are clamped to the row before the width
+//    check rejects the board
+//  - a board with no empty or grass cell gets no food, where the original
+//    looped forever
+
+#include "reference.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+/* Returns the value of the head of the list. */
+static void* ref_get_first(ref_node_t* head_list) {
+    if (head_list == NULL) {
+        return NULL;
+    }
+    return head_list->data;
+}
+
+/* Returns the value of the last element of the list. */
+static void* ref_get_last(ref_node_t* head_list) {
+    if (!head_list) {
+        return NULL;
+    }
+    ref_node_t* curr = head_list;
+    while (curr->next) {
+        curr = curr->next;
+    }
+    return curr->data;
+}
+
+/* Inserts a copy of `size` bytes at `to_add` at the front of the list. */
+static void ref_insert_first(ref_node_t** head_list, void* to_add,
+                             size_t size) {
+    if (!to_add) {
+        return;
+    }
+    ref_node_t* new_element = (ref_node_t*)malloc(sizeof(ref_node_t));
+    void* new_data = malloc(size);
+    memcpy(new_data, to_add, size);
+    new_element->data = new_data;
+
+    if (!(*head_list)) {
+        *head_list = new_element;
+        new_element->prev = NULL;
+        new_element->next = NULL;
+        return;
+    }
+    ref_node_t* curr = *head_list;
+    *head_list = new_element;
+    curr->prev = new_element;
+    new_element->next = curr;
+    new_element->prev = NULL;
+}
+
+/* Inserts a copy of `size` bytes at `to_add` at the end of the list. */
+static void ref_insert_last(ref_node_t** head_list, void* to_add,
+                            size_t size) {
+    if (!to_add) {
+        return;
+    }
+    ref_node_t* new_element = (ref_node_t*)malloc(sizeof(ref_node_t));
+    void* new_data = malloc(size);
+    memcpy(new_data, to_add, size);
+    new_element->data = new_data;
+
+    if (!(*head_list)) {  // means the list is empty
+        *head_list = new_element;
+        new_element->prev = NULL;
+        new_element->next = NULL;
+        return;
+    }
+
+    ref_node_t* curr = *head_list;
+    while (curr->next) {
+        curr = curr->next;
+    }
+
+    curr->next = new_element;
+    new_element->prev = curr;
+    new_element->next = NULL;
+}
+
+/* Removes the last element of the list. */
+static void ref_remove_last(ref_node_t** head_list) {
+    if (!(*head_list)) {
+        return;
+    }
+    ref_node_t* curr = *head_list;
+    if (!((*head_list)->next)) {
+        free(curr->data);
+        free(curr);
+        *head_list = NULL;
+        return;
+    }
+
+    while (curr->next) {
+        curr = curr->next;
+    }
+    curr->prev->next = NULL;
+
+    free(curr->data);
+    free(curr);
+}
+
+/** The original update(). */
+void ref_update(int* cells, size_t width, size_t height, ref_snake_t* snake_p,
+                enum input_key input, int growing) {
+    // if game is over, do not update
+    if (g_game_over == 1) {
+        return;
+    }
+    // current pos of snake head
+    int* old_p = (int*)(ref_get_first(snake_p->snake_pos));
+    int old_pos = *old_p;
+
+    // set new snake dir based on key input
+    switch (input) {
+        case INPUT_NONE:
+            break;
+        case INPUT_RIGHT:
+            snake_p->snake_dir = RIGHT;
+            break;
+        case INPUT_LEFT:
+            snake_p->snake_dir = LEFT;
+            break;
+        case INPUT_UP:
+            snake_p->snake_dir = UP;
+            break;
+        case INPUT_DOWN:
+            snake_p->snake_dir = DOWN;
+            break;
+    }
+
+    // find new pos based on new dir
+    int new_pos = 0;
+    switch (snake_p->snake_dir) {
+        case UP:
+            new_pos = old_pos - width;
+            break;
+        case DOWN:
+            new_pos = old_pos + width;
+            break;
+        case RIGHT:
+            new_pos = old_pos + 1;
+            break;
+        case LEFT:
+            new_pos = old_pos - 1;
+            break;
+    }
+
+    // if snake head collides with wall, end game, exit
+    if (cells[new_pos] == FLAG_WALL) {
+        g_game_over = 1;
+        return;
+    }
+
+    // find the current end of the snake and remove from its current cell
+    int* end_snake = (int*)ref_get_last(snake_p->snake_pos);
+    int end_snake_pos = *end_snake;
+    cells[end_snake_pos] = cells[end_snake_pos] ^ FLAG_SNAKE;
+
+    // update cells with new snake head pos
+    cells[new_pos] = cells[new_pos] | FLAG_SNAKE;
+
+    // update snake_pos linked list
+    ref_remove_last(&(snake_p->snake_pos));
+    ref_insert_first(&(snake_p->snake_pos), &new_pos, sizeof(int));
+
+    // handle colliding with food cells
+    if (cells[new_pos] == (FLAG_FOOD | FLAG_SNAKE) ||
+        cells[new_pos] == (FLAG_FOOD | FLAG_GRASS | FLAG_SNAKE)) {
+        cells[new_pos] = cells[new_pos] ^ FLAG_FOOD;
+        g_score += 1;
+
+        // re insert removed snake cell if snake is set to grow
+        if (growing == 1) {
+            int new_end_pos = end_snake_pos;
+            cells[new_end_pos] = cells[new_end_pos] | FLAG_SNAKE;
+            ref_insert_last(&(snake_p->snake_pos), &new_end_pos, sizeof(int));
+        }
+        ref_place_food(cells, width, height);
+    }
+}
+
+/** The original place_food(). */
+void ref_place_food(int* cells, size_t width, size_t height) {
+    unsigned food_index = generate_index(width * height);
+    // check that the cell is empty or only contains grass
+    if ((*(cells + food_index) == PLAIN_CELL) ||
+        (*(cells + food_index) == FLAG_GRASS)) {
+        *(cells + food_index) |= FLAG_FOOD;
+    } else {
+        ref_place_food(cells, width, height);
+    }
+}
+
+/* Splits `string` at `delim` into `tokens`. Returns the number of tokens
+   minus one, which is the number of rows after the dimensions.
+*/
+static int ref_parse(char* string, char** tokens, char* delim) {
+    char* token = strtok(string, delim);
+    // board string is invalid
+    if (token == NULL) {
+        return 1;
+    }
+
+    int row_index = 0;
+    // fill tokens
+    while (token != NULL) {
+        tokens[row_index] = token;
+        token = strtok(NULL, delim);
+        row_index++;
+    }
+    // number of rows (not including dimensions token)
+    return row_index - 1;
+}
+
+/* Returns the flag for a cell letter, or -1 if it isn't one. */
+static int ref_check_row_char(char c) {
+    int flag = -1;
+    switch (c) {
+        case 'E':
+            flag = PLAIN_CELL;
+            break;
+        case 'W':
+            flag = FLAG_WALL;
+            break;
+        case 'G':
+            flag = FLAG_GRASS;
+            break;
+        case 'S':
+            flag = FLAG_SNAKE;
+            break;
+    }
+    return flag;
+}
+
+static int ref_cells_pos(int row_num, int col_num, int width) {
+    return ((row_num * width) + col_num);
+}
+
+static int ref_is_a_num(char c) { return c >= '0' && c <= '9'; }
+
+static int ref_is_a_let(char c) {
+    return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z');
+}
+
+static void ref_fill_cells(int** cells_p, int start_pos, int num_cells,
+                           int flag) {
+    int* cells = *cells_p;
+    for (int i = 0; i < num_cells; i++) {
+        cells[start_pos + i] = flag;
+    }
+}
+
+/* The original decompress_board_str(), given room for the row tokens. */
+static enum board_init_status decompress_rows(int** cells_p, size_t* width_p,
+                                              size_t* height_p,
+                                              ref_snake_t* snake_p,
+                                              char* compressed, char** rows) {
+    // reference change: missing dimensions read as 0
+    char* dimensions[3] = {NULL, NULL, NULL};
+    char* delim1 = "|";
+    char* delim2 = "Bx";
+    size_t num_rows = ref_parse(compressed, rows, delim1);
+    // reference change: only the first three header tokens are kept
+    char* token = rows[0] != NULL ? strtok(rows[0], delim2) : NULL;
+    for (int i = 0; i < 3 && token != NULL; i++) {
+        dimensions[i] = token;
+        token = strtok(NULL, delim2);
+    }
+    *height_p = dimensions[0] ? atoi(dimensions[0]) : 0;
+    *width_p = dimensions[1] ? atoi(dimensions[1]) : 0;
+
+    // reference change: no cells for a board that fails the check below
+    size_t num_cells = num_rows == *height_p && (int)*width_p >= 0
+                           ? *height_p * *width_p
+                           : 0;
+    int* cells = malloc(num_cells * sizeof(int));
+    *cells_p = cells;
+    int curr_flag = -1;
+    int check_snake = 0;
+
+    // dimension check
+    if (num_rows != *height_p) {
+        return INIT_ERR_INCORRECT_DIMENSIONS;
+    }
+
+    int row_index = 0;
+    // iterate through each row string stored in rows
+    for (int i = 1; i < (int)num_rows + 1; i++) {
+        char* row = rows[i];
+        int col_index = 0;
+
+        // iterate through each char in a row
+        for (int j = 0; j < (int)strlen(row); j++) {
+            char* c = row + j;
+
+            if (ref_is_a_let(*c) == 1) {
+                curr_flag = ref_check_row_char(*c);
+                // checking for valid letter input
+                if (curr_flag == -1) {
+                    return INIT_ERR_BAD_CHAR;
+                }
+
+            }
+            // increase index to keep numbers together
+            else if (ref_is_a_num(*c) == 1) {
+                if (j + 1 < (int)strlen(row)) {
+                    char* next = row + j + 1;
+                    while (j < (int)strlen(row) && ref_is_a_num(*next) == 1) {
+                        j++;
+                        next++;
+                    }
+                }
+                // reference change: a run with no cell type
+                if (curr_flag == -1) {
+                    return INIT_ERR_BAD_CHAR;
+                }
+                // num cells to mark with current flag
+                int num_cells_run = atoi(c);
+                int start_pos = ref_cells_pos(row_index, col_index, *width_p);
+
+                // check that only one snake cell is added
+                if (curr_flag == FLAG_SNAKE) {
+                    check_snake += num_cells_run;
+                    if (check_snake != 1) {
+                        return INIT_ERR_WRONG_SNAKE_NUM;
+                    }
+                    // initialize snake data
+                    snake_p->snake_pos = NULL;
+                    ref_insert_first(&snake_p->snake_pos, &start_pos,
+                                     sizeof(int));
+                }
+                // reference change: stay inside the row
+                int room = (int)*width_p - col_index;
+                int first = col_index < 0 ? -col_index : 0;
+                int count = num_cells_run < room ? num_cells_run : room;
+                if (count > first) {
+                    ref_fill_cells(cells_p, start_pos + first,
+                                   count - first, curr_flag);
+                }
+                col_index += num_cells_run;
+            }
+        }
+        // check at the end of every row string for correct num of columns
+        if (col_index != (int)*width_p) {
+            return INIT_ERR_INCORRECT_DIMENSIONS;
+        }
+        row_index++;
+    }
+    // check if there was no snake inputted
+    if (check_snake != 1) {
+        return INIT_ERR_WRONG_SNAKE_NUM;
+    }
+    return INIT_SUCCESS;
+}
+
+/** The original decompress_board_str(), which modifies `compressed`.
+ * Whatever the status, the caller must call ref_teardown().
+ */
+enum board_init_status ref_decompress_board_str(int** cells_p, size_t* width_p,
+                                                size_t* height_p,
+                                                ref_snake_t* snake_p,
+                                                char* compressed) {
+    snake_p->snake_pos = NULL;
+    // reference change: one row slot per `|`, plus the header and the end
+    size_t max_tokens = 2;
+    for (char* p = compressed; *p != '\0'; p++) {
+        max_tokens += *p == '|';
+    }
+    char** rows = calloc(max_tokens, sizeof(char*));
+    enum board_init_status status = decompress_rows(
+        cells_p, width_p, height_p, snake_p, compressed, rows);
+    free(rows);
+    return status;
+}
+
+/** The original initialize_game() for a board string, which is modified.
+ * Whatever the status, the caller must call ref_teardown().
+ */
+enum board_init_status ref_initialize_game(int** cells_p, size_t* width_p,
+                                           size_t* height_p,
+                                           ref_snake_t* snake_p,
+                                           char* board_rep) {
+    enum board_init_status status = ref_decompress_board_str(
+        cells_p, width_p, height_p, snake_p, board_rep);
+    // continue setup if custom board is valid
+    if (status == INIT_SUCCESS) {
+        // reference change: no food on a board with no room for it
+        int room = 0;
+        for (size_t i = 0; i < *width_p * *height_p; i++) {
+            room |= (*cells_p)[i] == PLAIN_CELL || (*cells_p)[i] == FLAG_GRASS;
+        }
+        if (room) {
+            ref_place_food(*cells_p, *width_p, *height_p);
+        }
+        g_game_over = 0;
+        g_score = 0;
+        snake_p->snake_dir = RIGHT;
+    }
+    return status;
+}
+
+/** Returns the row-major position of the snake's head. */
+int ref_snake_head(ref_snake_t* snake_p) {
+    return *(int*)ref_get_first(snake_p->snake_pos);
+}
+
+/** Returns the row-major position of the snake's tail. */
+int ref_snake_tail(ref_snake_t* snake_p) {
+    return *(int*)ref_get_last(snake_p->snake_pos);
+}
+
+/** Frees a reference game's board and snake. */
+void ref_teardown(int* cells, ref_snake_t* snake_p) {
+    free(cells);
+    while (snake_p->snake_pos != NULL) {
+        ref_remove_last(&snake_p->snake_pos);
+    }
+}
@@ -0,0 +1,43 @@
+#ifndef REFERENCE_H
+#define REFERENCE_H
+
+// The engine as it was before any optimization (the first commit), frozen
+// as difftest's reference. Nothing here shares code with src/ except the
+// game globals, the flags and the random number generator, so a bug in any
+// shared helper shows up as a divergence instead of being copied into the
+// reference too.
+
+#include <stddef.h>
+
+#include "../src/common.h"
+#include "../src/game_setup.h"
+
+// The original doubly linked list of snake positions.
+typedef struct ref_node {
+    void* data;
+    struct ref_node* next;
+    struct ref_node* prev;
+} ref_node_t;
+
+// The original snake: a list of row-major positions, head first.
+typedef struct ref_snake {
+    enum direction snake_dir;
+    ref_node_t* snake_pos;
+} ref_snake_t;
+
+enum board_init_status ref_initialize_game(int** cells_p, size_t* width_p,
+                                           size_t* height_p,
+                                           ref_snake_t* snake_p,
+                                           char* board_rep);
+enum board_init_status ref_decompress_board_str(int** cells_p, size_t* width_p,
+                                                size_t* height_p,
+                                                ref_snake_t* snake_p,
+                                                char* compressed);
+void ref_update(int* cells, size_t width, size_t height, ref_snake_t* snake_p,
+                enum input_key input, int growing);
+void ref_place_food(int* cells, size_t width, size_t height);
+int ref_snake_head(ref_snake_t* snake_p);
+int ref_snake_tail(ref_snake_t* snake_p);
+void ref_teardown(int* cells, ref_snake_t* snake_p);
+
+#endif
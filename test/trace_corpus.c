@@ -0,0 +1,119 @@
+#include "trace_corpus.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/** Maps a corpus file. Only the header and index are checked here, so
+ * opening takes the same time however many tests the corpus holds.
+ *
+ * Returns 0 on success and -1 if the file can't be read or isn't a corpus.
+ */
+int trace_corpus_open(trace_corpus_t* corpus, const char* path) {
+    memset(corpus, 0, sizeof(*corpus));
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) || (size_t)st.st_size < sizeof(trace_header_t)) {
+        close(fd);
+        return -1;
+    }
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return -1;
+    }
+    corpus->data = data;
+    corpus->size = st.st_size;
+
+    const trace_header_t* header = data;
+    if (memcmp(header->magic, TRACE_MAGIC, sizeof(header->magic)) ||
+        header->version != TRACE_VERSION ||
+        header->index_offset > corpus->size ||
+        (corpus->size - header->index_offset) / sizeof(uint64_t) <
+            header->num_slots) {
+        trace_corpus_close(corpus);
+        return -1;
+    }
+    corpus->index = (const uint64_t*)(corpus->data + header->index_offset);
+    corpus->num_slots = header->num_slots;
+    corpus->num_tests = header->num_tests;
+    return 0;
+}
+
+/** Unmaps a corpus.
+ */
+void trace_corpus_close(trace_corpus_t* corpus) {
+    munmap((void*)corpus->data, corpus->size);
+    memset(corpus, 0, sizeof(*corpus));
+}
+
+/** Looks up test `number` in O(1).
+ *
+ * Returns 0 on success and -1 if there is no such test or its record runs
+ * past the end of the file.
+ */
+int trace_corpus_get(const trace_corpus_t* corpus, uint32_t number,
+                     trace_t* trace) {
+    if (number >= corpus->num_slots || corpus->index[number] == 0) {
+        return -1;
+    }
+    uint64_t offset = corpus->index[number];
+    if (offset > corpus->size ||
+        corpus->size - offset < sizeof(trace_record_t)) {
+        return -1;
+    }
+    const trace_record_t* record =
+        (const trace_record_t*)(corpus->data + offset);
+    uint64_t total = (uint64_t)record->board_bytes + record->name_bytes +
+                     record->expected_name_bytes + record->description_bytes +
+                     (record->num_inputs + 3) / 4 + record->expected_bytes;
+    if (corpus->size - offset - sizeof(trace_record_t) < total) {
+        return -1;
+    }
+
+    const char* p = (const char*)(record + 1);
+    trace->record = record;
+    trace->board = (record->flags & TRACE_BOARD) ? p : NULL;
+    p += record->board_bytes;
+    trace->name = p;
+    p += record->name_bytes;
+    trace->expected_name = p;
+    p += record->expected_name_bytes;
+    trace->description = p;
+    p += record->description_bytes;
+    trace->packed_inputs = (const unsigned char*)p;
+    trace->expected = trace->packed_inputs + (record->num_inputs + 3) / 4;
+    return 0;
+}
+
+/** Expands a test's expected cells into `cells`, one autograder letter per
+ * cell, row by row.
+ *
+ * Returns 0 on success and -1 if the runs don't add up to `num_cells`.
+ */
+int trace_expected_cells(const trace_t* trace, char* cells, size_t num_cells) {
+    const unsigned char* p = trace->expected;
+    const unsigned char* end = p + trace->record->expected_bytes;
+    size_t filled = 0;
+    while (p < end) {
+        char letter = (char)*p++;
+        size_t run = 0;
+        for (int shift = 0; p < end; shift += 7) {
+            run |= (size_t)(*p & 0x7f) << shift;
+            if (!(*p++ & 0x80)) {
+                break;
+            }
+        }
+        if (run > num_cells - filled) {
+            return -1;
+        }
+        memset(cells + filled, letter, run);
+        filled += run;
+    }
+    return filled == num_cells ? 0 : -1;
+}
@@ -0,0 +1,93 @@
+#ifndef TRACE_CORPUS_H
+#define TRACE_CORPUS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/** Binary trace corpus, written by test/compile_traces.py.
+ *
+ * Layout (little-endian, offsets from the start of the file):
+ *  - header: "SNKTRACE", version, number of index slots, number of tests,
+ *    reserved, offset of the index
+ *  - index: one 64-bit record offset per slot; slot n holds test n, and an
+ *    offset of 0 means there is no such test
+ *  - records, each 8-byte aligned: a trace_record_t, then the board string,
+ *    input name, expected name and description (each NUL-terminated), the
+ *    inputs packed as by pack_inputs(), and the expected cells as
+ *    (letter, varint run) pairs, where `?` matches any cell
+ */
+
+#define TRACE_MAGIC "SNKTRACE"
+#define TRACE_VERSION 1
+
+// trace_record_t flags
+#define TRACE_GROWS 1  // the snake grows on eating
+#define TRACE_BOARD 2  // the trace has a board string (else default board)
+#define TRACE_NAME 4   // the trace reads a player name
+#define TRACE_HASH 8   // the expected board is a Zobrist hash, not cells
+#define TRACE_ERROR 16 // the board string should fail to decode
+
+typedef struct trace_header {
+    char magic[8];
+    uint32_t version;
+    uint32_t num_slots;
+    uint32_t num_tests;
+    uint32_t reserved;
+    uint64_t index_offset;
+} trace_header_t;
+
+typedef struct trace_record {
+    uint32_t number;
+    uint32_t flags;
+    uint32_t seed;
+    uint32_t num_inputs;
+    int32_t game_over;
+    int32_t score;
+    uint32_t width;
+    uint32_t height;
+    uint32_t board_error;  // an enum board_init_status
+    uint32_t name_len;     // expected mbslen() of the name
+    uint64_t hash;
+    uint32_t board_bytes;  // each of these strings counts its NUL
+    uint32_t name_bytes;
+    uint32_t expected_name_bytes;
+    uint32_t description_bytes;
+    uint32_t expected_bytes;  // size of the RLE expected cells
+    uint32_t reserved;
+} trace_record_t;
+
+/** One test, pointing into the mapped corpus.
+ */
+typedef struct trace {
+    const trace_record_t* record;
+    const char* board;  // NULL for the default board
+    const char* name;
+    const char* expected_name;
+    const char* description;
+    const unsigned char* packed_inputs;
+    const unsigned char* expected;
+} trace_t;
+
+/** An open corpus.
+ * Fields:
+ *  - data: the mapped file
+ *  - size: bytes mapped
+ *  - index: record offsets, one per slot
+ *  - num_slots: number of index slots (one more than the highest test)
+ *  - num_tests: number of tests
+ */
+typedef struct trace_corpus {
+    const unsigned char* data;
+    size_t size;
+    const uint64_t* index;
+    uint32_t num_slots;
+    uint32_t num_tests;
+} trace_corpus_t;
+
+int trace_corpus_open(trace_corpus_t* corpus, const char* path);
+void trace_corpus_close(trace_corpus_t* corpus);
+int trace_corpus_get(const trace_corpus_t* corpus, uint32_t number,
+                     trace_t* trace);
+int trace_expected_cells(const trace_t* trace, char* cells, size_t num_cells);
+
+#endif
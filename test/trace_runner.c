@@ -0,0 +1,244 @@
+// Runs tests from a compiled trace corpus (see test/compile_traces.py) in
+// this process, instead of one autograder process per test.
+//
+//    $ make check-corpus
+//    $ ./trace-runner test/traces.bin [TEST_NUMBER...]
+//
+// With no test numbers, every test in the corpus is run.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "../src/arena.h"
+#include "../src/common.h"
+#include "../src/game.h"
+#include "../src/game_setup.h"
+#include "../src/mbstrings.h"
+#include "../src/zobrist.h"
+#include "trace_corpus.h"
+
+static const char* board_errors[] = {"success", "INCORRECT_DIMENSIONS",
+                                     "WRONG_SNAKE_NUM", "BAD_CHAR"};
+
+/* Returns the autograder's letter for a cell. */
+static char cell_letter(int cell) {
+    if ((cell & FLAG_GRASS) && (cell & FLAG_SNAKE)) {
+        return 's';
+    } else if ((cell & FLAG_GRASS) && (cell & FLAG_FOOD)) {
+        return 'o';
+    } else if (cell & FLAG_GRASS) {
+        return 'G';
+    } else if (cell == PLAIN_CELL) {
+        return '.';
+    } else if (cell & FLAG_SNAKE) {
+        return 'S';
+    } else if (cell & FLAG_WALL) {
+        return 'X';
+    } else if (cell & FLAG_FOOD) {
+        return 'O';
+    }
+    return '?';
+}
+
+/* Prints a mismatch the way autograder.py does. */
+static void mismatch_int(const char* what, long got, long expected) {
+    printf("%s mismatch:\n\tGot: %ld\n\tExpected: %ld\n", what, got,
+           expected);
+}
+
+/* Feeds `name` to read_name() through stdin and checks what it reads.
+   Returns 1 if the name and its length match.
+*/
+static int check_name(const trace_t* trace) {
+    int fds[2];
+    if (pipe(fds)) {
+        return 0;
+    }
+    dprintf(fds[1], "%s\n", trace->name);
+    close(fds[1]);
+    // read_name() prompts on stdout; keep that out of the report
+    fflush(stdout);
+    int saved_stdin = dup(0);
+    int saved_stdout = dup(1);
+    dup2(fds[0], 0);
+    close(fds[0]);
+    int null_fd = open("/dev/null", O_WRONLY);
+    dup2(null_fd, 1);
+    close(null_fd);
+
+    char name[1000] = {0};
+    read_name(name);
+    dup2(saved_stdin, 0);
+    dup2(saved_stdout, 1);
+    close(saved_stdin);
+    close(saved_stdout);
+
+    int ok = 1;
+    if (strcmp(name, trace->expected_name) != 0) {
+        printf("name mismatch:\n\tGot: %s\n\tExpected: %s\n", name,
+               trace->expected_name);
+        ok = 0;
+    }
+    size_t name_len = mbslen(name);
+    if (name_len != trace->record->name_len) {
+        mismatch_int("name_len", (long)name_len, trace->record->name_len);
+        ok = 0;
+    }
+    return ok;
+}
+
+/* Compares the final board against the expected cells, where `?` matches
+   anything. Returns 1 if they match.
+*/
+static int check_cells(const trace_t* trace, int* cells, size_t width,
+                       size_t height) {
+    size_t num_cells = width * height;
+    char* expected = malloc(num_cells + 1);
+    if (trace_expected_cells(trace, expected, num_cells)) {
+        printf("corrupt expected board\n");
+        free(expected);
+        return 0;
+    }
+    int ok = 1;
+    for (size_t row = 0; row < height; row++) {
+        for (size_t col = 0; col < width; col++) {
+            char want = expected[row * width + col];
+            char got = cell_letter(cells[cell_index(row, col, width)]);
+            if (want != '?' && want != got) {
+                printf("board mismatch at (%zu, %zu):\n\tGot: %c\n"
+                       "\tExpected: %c\n",
+                       row, col, got, want);
+                ok = 0;
+                row = height;
+                break;
+            }
+        }
+    }
+    free(expected);
+    return ok;
+}
+
+/* Runs one test. Returns 1 if it passes. */
+static int run_trace(const trace_t* trace) {
+    const trace_record_t* record = trace->record;
+    char* board = trace->board ? strdup(trace->board) : NULL;
+    int* cells = NULL;
+    size_t width = 0;
+    size_t height = 0;
+    snake_t snake;
+    zobrist_t hash;
+
+    set_seed(record->seed);
+    g_game_over = 0;
+    g_score = 0;
+    enum board_init_status status =
+        initialize_game(&cells, &width, &height, &snake, board);
+    free(board);
+
+    int ok = 1;
+    if (status != INIT_SUCCESS || (record->flags & TRACE_ERROR)) {
+        if (status != (enum board_init_status)record->board_error) {
+            printf("board error mismatch:\n\tGot: %s\n\tExpected: %s\n",
+                   board_errors[status], board_errors[record->board_error]);
+            ok = 0;
+        }
+        teardown(cells, &snake);
+        return ok;
+    }
+
+    if (record->flags & TRACE_HASH) {
+        zobrist_init(&hash, cells, width, height, &snake, g_score);
+        g_zobrist = &hash;
+    }
+    update_batch(cells, width, height, &snake, trace->packed_inputs,
+                 record->num_inputs, record->flags & TRACE_GROWS);
+    g_zobrist = NULL;
+
+    if (g_game_over != record->game_over) {
+        mismatch_int("game_over", g_game_over, record->game_over);
+        ok = 0;
+    }
+    if (g_score != record->score) {
+        mismatch_int("score", g_score, record->score);
+        ok = 0;
+    }
+    if (width != record->width || height != record->height) {
+        mismatch_int("width", (long)width, record->width);
+        mismatch_int("height", (long)height, record->height);
+        ok = 0;
+    } else if (record->flags & TRACE_HASH) {
+        if (hash.hash != record->hash) {
+            printf("hash mismatch:\n\tGot: %016llx\n\tExpected: %016llx\n",
+                   (unsigned long long)hash.hash,
+                   (unsigned long long)record->hash);
+            ok = 0;
+        }
+    } else {
+        ok = check_cells(trace, cells, width, height) && ok;
+    }
+    if (record->flags & TRACE_NAME) {
+        ok = check_name(trace) && ok;
+    }
+    teardown(cells, &snake);
+    return ok;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2) {
+        printf("Usage: trace-runner <corpus> [test_number...]\n");
+        exit(EXIT_FAILURE);
+    }
+
+    struct timespec start, loaded, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    trace_corpus_t corpus;
+    if (trace_corpus_open(&corpus, argv[1])) {
+        fprintf(stderr, "Error: could not open trace corpus %s\n", argv[1]);
+        exit(EXIT_FAILURE);
+    }
+    clock_gettime(CLOCK_MONOTONIC, &loaded);
+
+    arena_t arena;
+    arena_init(&arena, 1 << 16);
+    g_arena = &arena;
+
+    size_t passed = 0;
+    size_t failed = 0;
+    size_t count = argc > 2 ? (size_t)argc - 2 : corpus.num_slots;
+    for (size_t i = 0; i < count; i++) {
+        uint32_t number = argc > 2 ? (uint32_t)atoi(argv[i + 2]) : i;
+        trace_t trace;
+        if (trace_corpus_get(&corpus, number, &trace)) {
+            if (argc > 2) {
+                fprintf(stderr, "Error: could not find test test%03u\n",
+                        number);
+                exit(EXIT_FAILURE);
+            }
+            continue;
+        }
+        if (run_trace(&trace)) {
+            passed++;
+        } else {
+            printf("test%03u failed. Test purpose: %s\n\n", number,
+                   trace.description);
+            failed++;
+        }
+    }
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    g_arena = NULL;
+    arena_destroy(&arena);
+    trace_corpus_close(&corpus);
+
+    double load_ms = (loaded.tv_sec - start.tv_sec) * 1e3 +
+                     (loaded.tv_nsec - start.tv_nsec) / 1e6;
+    double run_ms = (end.tv_sec - loaded.tv_sec) * 1e3 +
+                    (end.tv_nsec - loaded.tv_nsec) / 1e6;
+    printf("PASSED: %zu | FAILED: %zu | loaded in %.3f ms, ran in %.1f ms\n",
+           passed, failed, load_ms, run_ms);
+    return EXIT_SUCCESS;
+}